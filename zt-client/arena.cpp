@@ -0,0 +1,67 @@
+#include "include/arena.hpp"
+#include "include/numa.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+static size_t roundUp(size_t v, size_t a) {
+    return (v + a - 1) / a * a;
+}
+
+BufferArena::BufferArena(size_t blockAlign, int numaNode) : node(numaNode) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    align = std::max(page, blockAlign);
+}
+
+BufferArena::~BufferArena() {
+    for (const Region& r : regions) {
+        if (r.huge) munmap(r.base, r.size);
+        else free(r.base);
+    }
+}
+
+bool BufferArena::addRegion(size_t minSize) {
+    size_t size = roundUp(std::max(minSize, HUGE_PAGE_SIZE), HUGE_PAGE_SIZE);
+
+    // Explicit huge pages only exist if the admin reserved some
+    // (vm.nr_hugepages); ENOMEM here is the normal case on a stock system.
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    if (p != MAP_FAILED) {
+        if (node >= 0) bindMemoryToNode(p, size, node);
+        regions.push_back({ static_cast<char*>(p), size, 0, true });
+        hugeRegions++;
+        return true;
+    }
+
+    if (posix_memalign(&p, std::max(align, HUGE_PAGE_SIZE), size) != 0) {
+        perror("posix_memalign");
+        return false;
+    }
+    madvise(p, size, MADV_HUGEPAGE);
+    if (node >= 0) bindMemoryToNode(p, size, node);
+    regions.push_back({ static_cast<char*>(p), size, 0, false });
+    return true;
+}
+
+char* BufferArena::allocate(size_t size) {
+    size = roundUp(size, align);
+
+    if (regions.empty() || regions.back().size - regions.back().used < size) {
+        if (!addRegion(size)) return nullptr;
+    }
+
+    Region& r = regions.back();
+    char* p = r.base + r.used;
+    r.used += size;
+    return p;
+}
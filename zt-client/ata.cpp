@@ -0,0 +1,474 @@
+#include "include/ata.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <scsi/sg.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+static constexpr uint8_t ATA_PASS_THROUGH_16 = 0x85;
+
+static constexpr uint8_t CMD_IDENTIFY = 0xEC;
+static constexpr uint8_t CMD_SECURITY_SET_PASSWORD = 0xF1;
+static constexpr uint8_t CMD_SECURITY_ERASE_PREPARE = 0xF3;
+static constexpr uint8_t CMD_SECURITY_ERASE_UNIT = 0xF4;
+static constexpr uint8_t CMD_SECURITY_DISABLE_PASSWORD = 0xF6;
+
+static constexpr uint8_t STATUS_ERR = 0x01;
+static constexpr unsigned DID_TIME_OUT = 0x03;
+
+static constexpr unsigned DEFAULT_ERASE_TIMEOUT = 12 * 3600;
+static constexpr const char* TEMP_PASSWORD = "wipe";
+
+const char* ataErrorKindName(AtaErrorKind k) {
+    switch (k) {
+        case AtaErrorKind::NONE:          return "ok";
+        case AtaErrorKind::OPEN:          return "cannot open device";
+        case AtaErrorKind::TRANSPORT:     return "pass-through failed";
+        case AtaErrorKind::TIMEOUT:       return "timed out";
+        case AtaErrorKind::ABORTED:       return "command aborted";
+        case AtaErrorKind::NOT_SUPPORTED: return "not supported";
+        case AtaErrorKind::FROZEN:        return "security frozen";
+        case AtaErrorKind::LOCKED:        return "security locked";
+        case AtaErrorKind::COUNT_EXPIRED: return "password attempts exhausted";
+        case AtaErrorKind::BAD_RESPONSE:  return "bad response";
+    }
+    return "unknown";
+}
+
+std::string AtaError::describe() const {
+    std::ostringstream s;
+    s << ataErrorKindName(kind);
+    if (command) s << " (command 0x" << std::hex << (unsigned)command;
+    if (status || error) s << ", status 0x" << std::hex << (unsigned)status
+                           << " error 0x" << (unsigned)error;
+    if (command) s << ")";
+    if (sysErrno) s << ": " << strerror(sysErrno);
+    if (!message.empty()) s << ": " << message;
+    return s.str();
+}
+
+static AtaError fail(AtaErrorKind kind, uint8_t command, const std::string& message = "") {
+    AtaError e;
+    e.kind = kind;
+    e.command = command;
+    e.message = message;
+    return e;
+}
+
+SgIoTransport::SgIoTransport(const std::string& devicePath) : path(devicePath) {
+    fd = open(devicePath.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd < 0) openErrno = errno;
+}
+
+SgIoTransport::~SgIoTransport() {
+    if (fd >= 0) close(fd);
+}
+
+// Status and error registers from the ATA Status Return sense descriptor
+// (descriptor format) or the information field (fixed format).
+static bool ataRegistersFromSense(const uint8_t* sense, size_t len,
+                                  uint8_t& status, uint8_t& error) {
+    if (len < 8) return false;
+    uint8_t code = sense[0] & 0x7f;
+    if (code == 0x72 || code == 0x73) {
+        size_t end = std::min<size_t>(len, 8 + sense[7]);
+        for (size_t i = 8; i + 1 < end; i += 2 + sense[i + 1]) {
+            if (sense[i] == 0x09 && i + 13 < end) {
+                error = sense[i + 3];
+                status = sense[i + 13];
+                return true;
+            }
+        }
+        return false;
+    }
+    if ((code == 0x70 || code == 0x71) && len >= 7) {
+        error = sense[3];
+        status = sense[4];
+        return true;
+    }
+    return false;
+}
+
+static uint8_t senseKey(const uint8_t* sense, size_t len) {
+    if (len < 3) return 0;
+    uint8_t code = sense[0] & 0x7f;
+    return (code == 0x72 || code == 0x73) ? sense[1] & 0x0f : sense[2] & 0x0f;
+}
+
+AtaError SgIoTransport::execute(const AtaCommand& cmd, uint8_t* data, size_t len) {
+    AtaError err;
+    err.command = cmd.command;
+    if (fd < 0) {
+        err.kind = AtaErrorKind::OPEN;
+        err.sysErrno = openErrno;
+        err.message = path;
+        return err;
+    }
+
+    bool ext = cmd.lba > 0x0fffffff || cmd.count > 0xff || cmd.feature > 0xff;
+    uint8_t proto = 3;
+    uint8_t flags = 0x20;               // CK_COND: return the registers
+    int dir = SG_DXFER_NONE;
+    if (cmd.protocol == AtaProtocol::PIO_IN) {
+        proto = 4;
+        flags = 0x0e;                   // T_DIR in, BYT_BLOK, length in COUNT
+        dir = SG_DXFER_FROM_DEV;
+    } else if (cmd.protocol == AtaProtocol::PIO_OUT) {
+        proto = 5;
+        flags = 0x06;
+        dir = SG_DXFER_TO_DEV;
+    }
+
+    uint8_t cdb[16] = {};
+    cdb[0] = ATA_PASS_THROUGH_16;
+    cdb[1] = (proto << 1) | (ext ? 1 : 0);
+    cdb[2] = flags;
+    cdb[3] = cmd.feature >> 8;
+    cdb[4] = cmd.feature;
+    cdb[5] = cmd.count >> 8;
+    cdb[6] = cmd.count;
+    cdb[7] = cmd.lba >> 24;
+    cdb[8] = cmd.lba;
+    cdb[9] = cmd.lba >> 32;
+    cdb[10] = cmd.lba >> 8;
+    cdb[11] = cmd.lba >> 40;
+    cdb[12] = cmd.lba >> 16;
+    cdb[13] = cmd.device | (ext ? 0 : (cmd.lba >> 24) & 0x0f);
+    cdb[14] = cmd.command;
+
+    uint8_t sense[64] = {};
+    sg_io_hdr_t hdr = {};
+    hdr.interface_id = 'S';
+    hdr.cmd_len = sizeof(cdb);
+    hdr.cmdp = cdb;
+    hdr.dxfer_direction = dir;
+    hdr.dxferp = data;
+    hdr.dxfer_len = dir == SG_DXFER_NONE ? 0 : len;
+    hdr.mx_sb_len = sizeof(sense);
+    hdr.sbp = sense;
+    // Milliseconds; erase timeouts run to days, so widen before scaling.
+    hdr.timeout = (unsigned)std::min<uint64_t>((uint64_t)cmd.timeoutSeconds * 1000, UINT_MAX);
+
+    if (ioctl(fd, SG_IO, &hdr) < 0) {
+        err.kind = AtaErrorKind::TRANSPORT;
+        err.sysErrno = errno;
+        return err;
+    }
+
+    if (hdr.host_status == DID_TIME_OUT) {
+        err.kind = AtaErrorKind::TIMEOUT;
+        err.message = "no completion after " + std::to_string(cmd.timeoutSeconds) + "s";
+        return err;
+    }
+    if (hdr.host_status != 0) {
+        err.kind = AtaErrorKind::TRANSPORT;
+        err.message = "host status " + std::to_string(hdr.host_status);
+        return err;
+    }
+
+    bool haveRegs = ataRegistersFromSense(sense, hdr.sb_len_wr, err.status, err.error);
+    uint8_t key = senseKey(sense, hdr.sb_len_wr);
+    // ILLEGAL REQUEST without registers: the bridge does not do SAT.
+    if (hdr.sb_len_wr > 0 && key == 0x05 && !haveRegs) {
+        err.kind = AtaErrorKind::TRANSPORT;
+        err.message = "ATA pass-through rejected";
+        return err;
+    }
+    if (haveRegs && (err.status & STATUS_ERR)) {
+        err.kind = AtaErrorKind::ABORTED;
+        return err;
+    }
+    // Any other sense apart from RECOVERED ERROR (CK_COND's "here are the
+    // registers") is a failure we cannot interpret.
+    if (!haveRegs && hdr.sb_len_wr > 0 && key != 0x00 && key != 0x01) {
+        err.kind = AtaErrorKind::BAD_RESPONSE;
+        err.message = "sense key " + std::to_string(key);
+        return err;
+    }
+    return err;
+}
+
+// IDENTIFY strings are byte-swapped within each word and space padded.
+static std::string identifyString(const std::array<uint16_t, 256>& w, int first, int last) {
+    std::string s;
+    for (int i = first; i <= last; i++) {
+        s += (char)(w[i] >> 8);
+        s += (char)(w[i] & 0xff);
+    }
+    s.erase(s.find_last_not_of(" \0", std::string::npos, 2) + 1);
+    s.erase(0, std::min(s.size(), s.find_first_not_of(' ')));
+    return s;
+}
+
+// Words 89/90: bit 15 selects the extended format (bits 14:0), otherwise
+// bits 7:0; either way in units of two minutes. The field's top value
+// means longer than the one below it.
+static unsigned eraseTime(uint16_t w, bool& openEnded) {
+    unsigned top = (w & 0x8000) ? 0x7fff : 0xff;
+    unsigned v = w & top;
+    openEnded = v == top;
+    return (openEnded ? v - 1 : v) * 2;
+}
+
+AtaIdentity parseIdentify(const std::array<uint16_t, 256>& w) {
+    AtaIdentity id;
+    id.serial = identifyString(w, 10, 19);
+    id.firmware = identifyString(w, 23, 26);
+    id.model = identifyString(w, 27, 46);
+
+    if (w[83] & (1 << 10)) {
+        id.sectors = (uint64_t)w[100] | (uint64_t)w[101] << 16 |
+                     (uint64_t)w[102] << 32 | (uint64_t)w[103] << 48;
+    } else {
+        id.sectors = (uint64_t)w[60] | (uint64_t)w[61] << 16;
+    }
+
+    uint16_t sec = w[128];
+    if (sec != 0xffff) {
+        id.securitySupported = sec & (1 << 0);
+        id.securityEnabled = sec & (1 << 1);
+        id.securityLocked = sec & (1 << 2);
+        id.securityFrozen = sec & (1 << 3);
+        id.securityCountExpired = sec & (1 << 4);
+        id.enhancedEraseSupported = sec & (1 << 5);
+    }
+    id.eraseMinutes = eraseTime(w[89], id.eraseOpenEnded);
+    id.enhancedEraseMinutes = eraseTime(w[90], id.enhancedEraseOpenEnded);
+    return id;
+}
+
+AtaError ataIdentify(AtaTransport& t, AtaIdentity& out) {
+    uint8_t buf[512] = {};
+    AtaCommand cmd;
+    cmd.command = CMD_IDENTIFY;
+    cmd.count = 1;
+    cmd.protocol = AtaProtocol::PIO_IN;
+    AtaError err = t.execute(cmd, buf, sizeof(buf));
+    if (!err.ok()) return err;
+
+    std::array<uint16_t, 256> words;
+    for (size_t i = 0; i < words.size(); i++) words[i] = buf[2 * i] | buf[2 * i + 1] << 8;
+    // Word 255 bits 7:0 = 0xA5 means bits 15:8 are a checksum over the block.
+    if ((words[255] & 0xff) == 0xa5) {
+        uint8_t sum = 0;
+        for (uint8_t b : buf) sum += b;
+        if (sum != 0) return fail(AtaErrorKind::BAD_RESPONSE, CMD_IDENTIFY, "checksum mismatch");
+    }
+    out = parseIdentify(words);
+    return err;
+}
+
+// Data block shared by the security commands: word 0 control bits, words
+// 1-16 the password, NUL padded.
+static void securityBlock(uint8_t* buf, const std::string& password, uint16_t control) {
+    memset(buf, 0, 512);
+    buf[0] = control & 0xff;
+    buf[1] = control >> 8;
+    memcpy(buf + 2, password.data(), std::min<size_t>(password.size(), 32));
+}
+
+static AtaError securityCommand(AtaTransport& t, uint8_t command, const std::string& password,
+                                uint16_t control, unsigned timeoutSeconds) {
+    uint8_t buf[512];
+    securityBlock(buf, password, control);
+    AtaCommand cmd;
+    cmd.command = command;
+    cmd.count = 1;
+    cmd.protocol = AtaProtocol::PIO_OUT;
+    cmd.timeoutSeconds = timeoutSeconds;
+    AtaError err = t.execute(cmd, buf, sizeof(buf));
+    memset(buf, 0, sizeof(buf));
+    return err;
+}
+
+AtaError ataSetPassword(AtaTransport& t, const std::string& password) {
+    // Control 0: user password, high security.
+    return securityCommand(t, CMD_SECURITY_SET_PASSWORD, password, 0, 15);
+}
+
+AtaError ataDisablePassword(AtaTransport& t, const std::string& password) {
+    return securityCommand(t, CMD_SECURITY_DISABLE_PASSWORD, password, 0, 15);
+}
+
+AtaError ataEraseUnit(AtaTransport& t, const std::string& password, bool enhanced,
+                      const AtaIdentity& id) {
+    AtaCommand prepare;
+    prepare.command = CMD_SECURITY_ERASE_PREPARE;
+    AtaError err = t.execute(prepare, nullptr, 0);
+    if (!err.ok()) return err;
+
+    unsigned minutes = enhanced ? id.enhancedEraseMinutes : id.eraseMinutes;
+    bool openEnded = enhanced ? id.enhancedEraseOpenEnded : id.eraseOpenEnded;
+    // Twice the estimate, or when it is only a lower bound, four times it
+    // and never less than the default.
+    uint64_t timeout = DEFAULT_ERASE_TIMEOUT;
+    if (openEnded) {
+        timeout = std::max<uint64_t>((uint64_t)minutes * 4 * 60, DEFAULT_ERASE_TIMEOUT);
+    } else if (minutes) {
+        timeout = std::max<uint64_t>((uint64_t)minutes * 2 * 60, 600);
+    }
+    // Control bit 1 selects the enhanced erase.
+    return securityCommand(t, CMD_SECURITY_ERASE_UNIT, password, enhanced ? 0x2 : 0x0,
+                           (unsigned)std::min<uint64_t>(timeout, UINT_MAX));
+}
+
+AtaError ataSecurityErase(AtaTransport& t, bool preferEnhanced, WipeProgress* progress,
+                          bool* enhancedUsed) {
+    AtaIdentity id;
+    AtaError err = ataIdentify(t, id);
+    if (!err.ok()) return err;
+
+    if (!id.securitySupported) {
+        return fail(AtaErrorKind::NOT_SUPPORTED, CMD_IDENTIFY, "no security feature set");
+    }
+    if (id.securityFrozen) {
+        return fail(AtaErrorKind::FROZEN, CMD_IDENTIFY,
+                    "suspend and resume the machine or re-plug the drive");
+    }
+    if (id.securityCountExpired) return fail(AtaErrorKind::COUNT_EXPIRED, CMD_IDENTIFY);
+    if (id.securityLocked || id.securityEnabled) {
+        return fail(AtaErrorKind::LOCKED, CMD_IDENTIFY, "a user password is already set");
+    }
+
+    bool enhanced = preferEnhanced && id.enhancedEraseSupported;
+    if (enhancedUsed) *enhancedUsed = enhanced;
+    unsigned minutes = enhanced ? id.enhancedEraseMinutes : id.eraseMinutes;
+    bool openEnded = enhanced ? id.enhancedEraseOpenEnded : id.eraseOpenEnded;
+    std::cout << "ATA " << (enhanced ? "enhanced " : "") << "security erase of " << id.model
+              << " (" << id.serial << "), drive estimate "
+              << (minutes ? std::to_string(minutes) + (openEnded ? "+" : "") + " min"
+                          : std::string("unknown")) << "\n";
+
+    err = ataSetPassword(t, TEMP_PASSWORD);
+    if (!err.ok()) return err;
+
+    // The erase is one blocking command; advance progress by the clock
+    // against the drive's estimate, stopping just short of the end.
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool done = false;
+    std::thread ticker;
+    if (progress) {
+        uint64_t total = (uint64_t)minutes * 60;
+        progress->start(WipePhase::ERASING, total);
+        ticker = std::thread([&] {
+            auto start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(mtx);
+            while (!cv.wait_for(lock, std::chrono::seconds(1), [&] { return done; })) {
+                uint64_t s = std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                progress->set(total ? std::min(s, total - 1) : s);
+            }
+        });
+    }
+
+    err = ataEraseUnit(t, TEMP_PASSWORD, enhanced, id);
+
+    if (ticker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            done = true;
+        }
+        cv.notify_all();
+        ticker.join();
+    }
+
+    // A successful erase clears the password itself. After a failure, or
+    // a drive that kept it anyway, take it off so the disk is not left
+    // locked to a password only this tool knows.
+    AtaIdentity after;
+    bool stillSet = !err.ok() || !ataIdentify(t, after).ok() || after.securityEnabled;
+    if (stillSet) {
+        AtaError d = ataDisablePassword(t, TEMP_PASSWORD);
+        if (!d.ok()) {
+            std::cerr << "Could not remove temporary ATA password \"" << TEMP_PASSWORD
+                      << "\": " << d.describe() << "\n";
+        }
+    }
+    if (err.ok() && progress) progress->set((uint64_t)minutes * 60);
+    return err;
+}
+
+static void putString(uint16_t* w, int first, int last, const std::string& s) {
+    std::string padded = s;
+    padded.resize((last - first + 1) * 2, ' ');
+    for (int i = first; i <= last; i++) {
+        w[i] = (uint8_t)padded[2 * (i - first)] << 8 | (uint8_t)padded[2 * (i - first) + 1];
+    }
+}
+
+AtaError MockAtaDrive::execute(const AtaCommand& cmd, uint8_t* data, size_t len) {
+    log.push_back(cmd.command);
+    // What a drive reports for a rejected command: ERR + DRDY + DSC, ABRT.
+    auto aborted = [&] {
+        AtaError e = fail(AtaErrorKind::ABORTED, cmd.command);
+        e.status = 0x51;
+        e.error = 0x04;
+        return e;
+    };
+    if (cmd.command == failCommand) return aborted();
+    auto sentPassword = [&] {
+        std::string p((const char*)data + 2, 32);
+        return p.substr(0, p.find('\0'));
+    };
+    bool needsData = cmd.protocol != AtaProtocol::NON_DATA;
+    if (needsData && (!data || len < 512)) return fail(AtaErrorKind::TRANSPORT, cmd.command);
+
+    switch (cmd.command) {
+        case CMD_IDENTIFY: {
+            uint16_t w[256] = {};
+            putString(w, 10, 19, identity.serial);
+            putString(w, 23, 26, identity.firmware);
+            putString(w, 27, 46, identity.model);
+            w[83] = 1 << 10;
+            for (int i = 0; i < 4; i++) w[100 + i] = identity.sectors >> (16 * i);
+            w[89] = identity.eraseOpenEnded ? 0xff : std::min(identity.eraseMinutes / 2, 0xfeu);
+            w[90] = identity.enhancedEraseOpenEnded ? 0xff
+                                                    : std::min(identity.enhancedEraseMinutes / 2, 0xfeu);
+            w[128] = (identity.securitySupported ? 1 << 0 : 0) |
+                     (!password.empty() ? 1 << 1 : 0) |
+                     (identity.securityLocked ? 1 << 2 : 0) |
+                     (identity.securityFrozen ? 1 << 3 : 0) |
+                     (identity.securityCountExpired ? 1 << 4 : 0) |
+                     (identity.enhancedEraseSupported ? 1 << 5 : 0);
+            for (int i = 0; i < 256; i++) {
+                data[2 * i] = w[i] & 0xff;
+                data[2 * i + 1] = w[i] >> 8;
+            }
+            return {};
+        }
+        case CMD_SECURITY_SET_PASSWORD:
+            if (!identity.securitySupported || identity.securityFrozen || !password.empty()) {
+                return aborted();
+            }
+            password = sentPassword();
+            return {};
+        case CMD_SECURITY_ERASE_PREPARE:
+            prepared = true;
+            return {};
+        case CMD_SECURITY_ERASE_UNIT: {
+            bool ok = prepared && !password.empty() && sentPassword() == password;
+            prepared = false;
+            if (!ok) return aborted();
+            erased = true;
+            eraseTimeout = cmd.timeoutSeconds;
+            erasedEnhanced = data[0] & 0x2;
+            password.clear();
+            return {};
+        }
+        case CMD_SECURITY_DISABLE_PASSWORD:
+            if (password.empty() || sentPassword() != password) return aborted();
+            password.clear();
+            return {};
+    }
+    return aborted();
+}
@@ -0,0 +1,101 @@
+#include "include/capcache.hpp"
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+static const int CACHE_VERSION = 1;
+
+CapabilityCache::CapabilityCache(const std::string& file_) : file(file_) {}
+
+void CapabilityCache::load() {
+    entries.clear();
+    dirty = false;
+
+    std::ifstream in(file);
+    if (!in.is_open()) return;
+
+    nlohmann::json j = nlohmann::json::parse(in, nullptr, false);
+    if (j.is_discarded() || j.value("version", 0) != CACHE_VERSION) {
+        std::cerr << "Ignoring unreadable capability cache " << file << "\n";
+        return;
+    }
+
+    try {
+        for (const auto& [id, e] : j.at("devices").items()) {
+            CachedCapabilities c;
+            c.firmware = e.at("firmware").get<std::string>();
+            c.firmwareErase = e.at("firmware_erase").get<bool>();
+            c.probedAt = e.value("probed_at", (uint64_t)0);
+            entries[id] = c;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring malformed capability cache " << file << ": " << e.what() << "\n";
+        entries.clear();
+    }
+}
+
+bool CapabilityCache::save() {
+    if (!dirty) return true;
+
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::path(file).parent_path();
+    if (!dir.empty()) {
+        std::filesystem::create_directories(dir, ec);
+        if (ec) {
+            std::cerr << "Cannot create " << dir << ": " << ec.message() << "\n";
+            return false;
+        }
+    }
+
+    nlohmann::json j;
+    j["version"] = CACHE_VERSION;
+    j["devices"] = nlohmann::json::object();
+    for (const auto& [id, c] : entries) {
+        j["devices"][id] = { {"firmware", c.firmware},
+                             {"firmware_erase", c.firmwareErase},
+                             {"probed_at", c.probedAt} };
+    }
+
+    // Rename over the old file so a concurrent scan never reads half of it.
+    // Losing the cache costs a re-probe, so there is no fsync.
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out.is_open()) {
+            perror(("open " + tmp).c_str());
+            return false;
+        }
+        out << j.dump();
+        if (!out.good()) {
+            std::cerr << "Failed to write " << tmp << "\n";
+            return false;
+        }
+    }
+    if (rename(tmp.c_str(), file.c_str()) < 0) {
+        perror("rename capability cache");
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+bool CapabilityCache::lookup(const std::string& identity, const std::string& firmware,
+                             CachedCapabilities& out) const {
+    auto it = entries.find(identity);
+    if (it == entries.end() || it->second.firmware != firmware) return false;
+    out = it->second;
+    return true;
+}
+
+void CapabilityCache::store(const std::string& identity, const std::string& firmware,
+                            bool firmwareErase) {
+    CachedCapabilities& c = entries[identity];
+    if (c.firmware == firmware && c.firmwareErase == firmwareErase && c.probedAt) return;
+    c.firmware = firmware;
+    c.firmwareErase = firmwareErase;
+    c.probedAt = time(nullptr);
+    dirty = true;
+}
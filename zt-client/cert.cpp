@@ -41,6 +41,57 @@ std::string generateCertificateJSON(const WipeResult& r) {
     j["end_time"] = r.end_time;
     j["tool_version"] = r.tool_version;
 
+    if (!r.erase_action.empty()) {
+        j["firmware_erase"] = {
+            {"action", r.erase_action},
+            {"duration_seconds", r.erase_seconds}
+        };
+        if (r.erase_status) j["firmware_erase"]["sanitize_status"] = r.erase_status;
+    }
+
+    if (!r.scheme.empty()) {
+        j["scheme"] = {
+            {"name", r.scheme},
+            {"passes", r.scheme_passes}
+        };
+    }
+
+    if (r.resume_count > 0) {
+        j["resumed"] = {
+            {"count", r.resume_count},
+            {"first_start_time", r.first_start_time}
+        };
+    }
+
+    if (!r.verify_mode.empty() && r.verify_mode != "none") {
+        j["verification"] = {
+            {"mode", r.verify_mode},
+            {"bytes_checked", r.verify_bytes},
+            {"mismatched_blocks", r.verify_mismatched_blocks}
+        };
+        if (r.verify_mode == "sampled") {
+            j["verification"]["sampling"] = {
+                {"prng", "mt19937_64"},
+                {"offset_rule", "region_start + (prng() % (slots + 1)) * align_bytes"},
+                {"align_bytes", r.verify_sample_align},
+                {"seed", r.verify_seed},
+                {"regions", r.verify_regions},
+                {"samples_per_region", r.verify_samples_per_region},
+                {"sample_bytes", r.verify_sample_bytes},
+                {"edge_bytes", r.verify_edge_bytes},
+                {"coverage", r.verify_coverage}
+            };
+        }
+        if (!r.verify_bad_lbas.empty()) {
+            nlohmann::json ranges = nlohmann::json::array();
+            for (const LbaRange& lr : r.verify_bad_lbas) {
+                ranges.push_back({lr.first, lr.count});
+            }
+            j["verification"]["mismatch_lba_ranges"] = ranges;
+            j["verification"]["mismatch_ranges_truncated"] = r.verify_bad_lbas_truncated;
+        }
+    }
+
     return j.dump(); // no pretty-printing
 }
 
@@ -0,0 +1,555 @@
+#include "include/cli.hpp"
+#include "include/cert.hpp"
+#include "include/daemon.hpp"
+#include "include/dev.hpp"
+#include "include/orchestrator.hpp"
+#include "include/sysfs.hpp"
+#include "include/wipe.hpp"
+#include "include/wire.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+static constexpr auto PROGRESS_INTERVAL = std::chrono::seconds(1);
+
+// Writes events to the real stdout, one line each, from any thread. In
+// JSON mode std::cout is pointed at stderr for the duration so the wipe
+// engine's own messages cannot interleave with the stream.
+class EventWriter {
+public:
+    explicit EventWriter(bool json_) : json(json_), out(std::cout.rdbuf()) {
+        if (json) std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    ~EventWriter() {
+        if (json) std::cout.rdbuf(out.rdbuf());
+    }
+
+    bool jsonMode() const { return json; }
+
+    void event(const nlohmann::json& j) {
+        std::lock_guard<std::mutex> lock(mtx);
+        out << j.dump() << std::endl;
+    }
+
+    void text(const std::string& line) {
+        std::lock_guard<std::mutex> lock(mtx);
+        out << line << std::endl;
+    }
+
+    // An "error" event, or a line on stderr in text mode.
+    void error(const std::string& device, const std::string& message) {
+        if (json) event({{"event", "error"}, {"device", device}, {"error", message}});
+        else std::cerr << device << ": " << message << std::endl;
+    }
+
+private:
+    bool json;
+    std::ostream out;
+    std::mutex mtx;
+};
+
+static void usage(const char* prog) {
+    std::cerr << "Usage:\n"
+              << "  " << prog << " list   [--json] [--refresh]\n"
+              << "  " << prog << " wipe   [--json] --yes [--method plain|encrypted|firmware|ata]\n"
+              << "                [--scheme SCHEME] [--verify none|sampled|full] [--jobs N]\n"
+              << "                [--timeout SECONDS] [--stall-timeout SECONDS] [--resume]\n"
+              << "                [--cert-dir DIR] [--daemon | --socket PATH] DEVICE...\n"
+              << "  " << prog << " verify [--json] CERTIFICATE...\n"
+              << "  " << prog << " daemon [--socket PATH] [--scheme SCHEME] [--verify MODE] [--jobs N]\n"
+              << "                [--timeout SECONDS] [--stall-timeout SECONDS] [--resume]\n"
+              << "  " << prog << " status [--json] [--socket PATH] [JOB]\n"
+              << "  " << prog << " cancel [--json] [--socket PATH] JOB\n";
+}
+
+bool isCliCommand(const char* arg) {
+    return !strcmp(arg, "list") || !strcmp(arg, "wipe") || !strcmp(arg, "verify") ||
+           !strcmp(arg, "daemon") || !strcmp(arg, "status") || !strcmp(arg, "cancel");
+}
+
+static int cmdList(EventWriter& w, const std::vector<std::string>& args) {
+    ScanOptions scan;
+    for (const std::string& a : args) {
+        if (a == "--refresh") scan.refresh = true;
+        else {
+            std::cerr << "list: unexpected argument " << a << "\n";
+            return 2;
+        }
+    }
+
+    for (const Device& dev : getDevices(scan)) {
+        if (w.jsonMode()) {
+            nlohmann::json j = deviceToJson(dev);
+            j["event"] = "device";
+            w.event(j);
+            continue;
+        }
+        std::string methods;
+        for (WipeMethod m : dev.supportedWipeMethods) {
+            methods += (methods.empty() ? "" : ",") + std::string(wipeMethodName(m));
+        }
+        w.text(dev.path + "  " + dev.type + "  " + std::to_string(dev.sizeBytes) + " bytes  " +
+               (dev.model.empty() ? "-" : dev.model) + "  [" + methods + "]" +
+               (dev.capabilitiesUnknown ? " (capabilities unknown)" : ""));
+    }
+    return 0;
+}
+
+// jobToJson() plus the event name.
+static nlohmann::json jobEvent(const char* event, const WipeJob& job) {
+    nlohmann::json j = jobToJson(job);
+    j["event"] = event;
+    return j;
+}
+
+// Writes the certificate exactly as generated; the chain holds its hash.
+static bool saveCertificate(const std::string& certDir, const std::string& devicePath,
+                            const std::string& certificate, std::string& file) {
+    nlohmann::json cert = nlohmann::json::parse(certificate, nullptr, false);
+    uint64_t endTime = cert.is_object() ? cert.value("end_time", (uint64_t)0) : 0;
+
+    std::error_code ec;
+    std::filesystem::create_directories(certDir, ec);
+    file = certDir + "/" + blockDeviceName(devicePath) + "-" + std::to_string(endTime) + ".json";
+    std::ofstream out(file, std::ios::trunc);
+    out << certificate;
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write " << file << "\n";
+        file.clear();
+        return false;
+    }
+    return true;
+}
+
+// `ev` is jobToJson() plus progressToJson().
+static void reportProgress(EventWriter& w, nlohmann::json ev) {
+    if (w.jsonMode()) {
+        ev["event"] = "progress";
+        w.event(ev);
+        return;
+    }
+    uint64_t total = ev.value("bytes_total", (uint64_t)0);
+    int pct = total ? (int)(ev.value("bytes_done", (uint64_t)0) * 100 / total) : 0;
+    w.text(ev.value("device", "") + ": " + ev.value("phase", "") + " " + std::to_string(pct) + "%");
+}
+
+// `job` is jobToJson() of a finished job; `certificate` is empty unless it
+// is DONE.
+// False when the wipe succeeded but its certificate could not be saved;
+// the device is then reported as failed, since there is no proof of it.
+static bool reportResult(EventWriter& w, nlohmann::json job, const std::string& certificate,
+                         const std::string& certDir) {
+    std::string device = job.value("device", "");
+    std::string certFile;
+    bool saved = true;
+    if (!certificate.empty() && !certDir.empty() &&
+        !saveCertificate(certDir, device, certificate, certFile)) {
+        std::string error = "certificate could not be written to " + certDir;
+        w.error(device, error);
+        job["state"] = "failed";
+        job["error"] = error;
+        saved = false;
+    }
+
+    if (!w.jsonMode()) {
+        std::string error = job.value("error", "");
+        w.text(device + ": " + job.value("state", "") + (error.empty() ? "" : " (" + error + ")") +
+               (certFile.empty() ? "" : ", certificate " + certFile));
+        return saved;
+    }
+    job["event"] = "result";
+    if (!certificate.empty()) job["certificate"] = nlohmann::json::parse(certificate, nullptr, false);
+    if (!certFile.empty()) job["certificate_file"] = certFile;
+    w.event(job);
+    return saved;
+}
+
+// Engine settings shared by `wipe` and `daemon`. Returns 1 if args[i]
+// (and its value) was consumed, 0 if it is not an engine option and -1
+// after reporting a bad value.
+static int parseEngineOption(const char* cmd, const std::vector<std::string>& args, size_t& i,
+                             WipeOptions& opts, WorkerLimits& limits, unsigned& jobs) {
+    const std::string& a = args[i];
+    if (a == "--resume") {
+        opts.resume = true;
+        return 1;
+    }
+    if (i + 1 >= args.size()) return 0;
+    if (a == "--scheme") {
+        opts.scheme = args[++i];
+    } else if (a == "--verify") {
+        const std::string& v = args[++i];
+        if (v == "none") opts.verify = VerifyMode::NONE;
+        else if (v == "sampled") opts.verify = VerifyMode::SAMPLED;
+        else if (v == "full") opts.verify = VerifyMode::FULL;
+        else {
+            std::cerr << cmd << ": unknown verify mode " << v << "\n";
+            return -1;
+        }
+    } else if (a == "--jobs") {
+        jobs = std::max(1, atoi(args[++i].c_str()));
+    } else if (a == "--timeout") {
+        limits.timeoutSeconds = std::max(0, atoi(args[++i].c_str()));
+    } else if (a == "--stall-timeout") {
+        limits.stallSeconds = std::max(0, atoi(args[++i].c_str()));
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static int wipeViaDaemon(EventWriter& w, const std::string& socketPath,
+                         const std::vector<std::string>& paths, WipeMethod method,
+                         const std::string& certDir) {
+    DaemonClient client;
+    if (!client.connect(socketPath)) return 1;
+
+    // Stream first so no state change of the new jobs is missed.
+    nlohmann::json reply;
+    nlohmann::json submit = { {"op", "submit"}, {"devices", paths}, {"method", wipeMethodName(method)} };
+    if (!client.call({{"op", "stream"}}, reply) || !client.call(submit, reply) ||
+        !reply.value("ok", false)) {
+        std::cerr << "wipe: daemon refused the request: " << reply.value("error", "connection lost") << "\n";
+        return 1;
+    }
+
+    bool anyFailed = false;
+    std::set<unsigned> ours;
+    for (const auto& j : reply["jobs"]) {
+        if (j.contains("job")) {
+            ours.insert(j["job"].get<unsigned>());
+            continue;
+        }
+        anyFailed = true;
+        w.error(j.value("device", ""), j.value("error", ""));
+    }
+
+    nlohmann::json ev;
+    while (!ours.empty() && client.next(ev)) {
+        if (!ev.contains("job") || !ours.count(ev["job"].get<unsigned>())) continue;
+        unsigned id = ev["job"].get<unsigned>();
+        std::string state = ev.value("state", "");
+        if (ev["event"] == "progress") {
+            reportProgress(w, ev);
+            continue;
+        }
+        if (state != "done" && state != "failed") {
+            if (w.jsonMode()) {
+                ev["event"] = "state";
+                w.event(ev);
+            }
+            continue;
+        }
+
+        ours.erase(id);
+        std::string certificate;
+        if (state == "done") {
+            nlohmann::json cert;
+            if (client.call({{"op", "certificate"}, {"job", id}}, cert) && cert.value("ok", false)) {
+                certificate = cert.value("certificate", "");
+            }
+            if (certificate.empty()) {
+                w.error(ev.value("device", ""), "could not fetch the certificate from the daemon");
+                anyFailed = true;
+            }
+        } else {
+            anyFailed = true;
+        }
+        ev.erase("event");
+        if (!reportResult(w, ev, certificate, certDir)) anyFailed = true;
+    }
+    if (!ours.empty()) {
+        std::cerr << "wipe: lost the daemon connection; its jobs keep running\n";
+        return 1;
+    }
+    return anyFailed ? 1 : 0;
+}
+
+static int cmdWipe(EventWriter& w, const std::vector<std::string>& args) {
+    WipeOptions opts;
+    WorkerLimits limits;
+    WipeMethod method = WipeMethod::PLAIN_OVERWRITE;
+    unsigned jobs = 8;
+    std::string certDir;
+    std::string socketPath;
+    bool engineOptions = false;
+    bool confirmed = false;
+    std::vector<std::string> paths;
+
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& a = args[i];
+        bool hasValue = i + 1 < args.size();
+        int engine = parseEngineOption("wipe", args, i, opts, limits, jobs);
+        if (engine < 0) return 2;
+        if (engine > 0) {
+            engineOptions = true;
+        } else if (a == "--yes") {
+            confirmed = true;
+        } else if (a == "--method" && hasValue) {
+            if (!parseWipeMethod(args[++i], method)) {
+                std::cerr << "wipe: unknown method " << args[i] << "\n";
+                return 2;
+            }
+        } else if (a == "--cert-dir" && hasValue) {
+            certDir = args[++i];
+        } else if (a == "--daemon") {
+            if (socketPath.empty()) socketPath = DaemonOptions().socketPath;
+        } else if (a == "--socket" && hasValue) {
+            socketPath = args[++i];
+        } else if (a.rfind("--", 0) == 0) {
+            std::cerr << "wipe: unknown option " << a << "\n";
+            return 2;
+        } else {
+            paths.push_back(a);
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "wipe: no devices given\n";
+        return 2;
+    }
+    if (!confirmed) {
+        std::cerr << "wipe: destroys all data on the listed devices; pass --yes to confirm\n";
+        return 2;
+    }
+    if (!socketPath.empty()) {
+        if (engineOptions) {
+            std::cerr << "wipe: --scheme, --verify, --jobs and timeouts are set when the daemon is started\n";
+            return 2;
+        }
+        return wipeViaDaemon(w, socketPath, paths, method, certDir);
+    }
+
+    // Refuse the whole batch up front rather than wiping part of it.
+    std::vector<Device> devices;
+    for (const std::string& path : paths) {
+        std::string name = blockDeviceName(path);
+        Device dev;
+        std::string error;
+        if (!getDevice(name, dev)) error = "not a wipeable block device";
+        else if (deviceInUse(name)) error = "device is in use (mounted, swap or held)";
+        if (!error.empty()) {
+            w.error(path, error);
+            return 1;
+        }
+        devices.push_back(dev);
+    }
+
+    std::atomic<bool> anyFailed{false};
+    {
+        WipeOrchestrator orchestrator(jobs, opts, QosOptions(), limits);
+        orchestrator.onJobUpdate([&](const WipeJob& job) {
+            bool finished = job.state == JobState::DONE || job.state == JobState::FAILED;
+            if (!finished) {
+                if (w.jsonMode()) w.event(jobEvent("state", job));
+                return;
+            }
+            if (job.state == JobState::FAILED) anyFailed = true;
+            if (!reportResult(w, jobToJson(job), job.state == JobState::DONE ? job.certificate : "",
+                              certDir)) {
+                anyFailed = true;
+            }
+        });
+
+        // One at a time so a refusal can be pinned on its device; the same
+        // disk given twice is refused the second time.
+        std::vector<unsigned> ids;
+        for (const Device& dev : devices) {
+            unsigned id = orchestrator.submit(dev, method);
+            if (id) {
+                ids.push_back(id);
+                continue;
+            }
+            anyFailed = true;
+            w.error(dev.path, "a wipe is already running on this device");
+        }
+
+        // Progress events until every job has finished.
+        for (;;) {
+            bool running = false;
+            for (unsigned id : ids) {
+                WipeJob job;
+                if (!orchestrator.job(id, job)) continue;
+                if (job.state == JobState::DONE || job.state == JobState::FAILED) continue;
+                running = true;
+
+                ProgressSnapshot snap;
+                if (job.state == JobState::QUEUED || !orchestrator.progress(id, snap)) continue;
+                nlohmann::json ev = jobToJson(job);
+                ev.update(progressToJson(snap));
+                reportProgress(w, ev);
+            }
+            if (!running) break;
+            std::this_thread::sleep_for(PROGRESS_INTERVAL);
+        }
+        orchestrator.waitIdle();
+    }
+    return anyFailed ? 1 : 0;
+}
+
+static WipeDaemon* runningDaemon = nullptr;
+
+static void stopDaemon(int) {
+    if (runningDaemon) runningDaemon->stop();
+}
+
+static int cmdDaemon(const std::vector<std::string>& args) {
+    DaemonOptions opts;
+    for (size_t i = 0; i < args.size(); i++) {
+        int engine = parseEngineOption("daemon", args, i, opts.wipe, opts.limits, opts.maxConcurrent);
+        if (engine < 0) return 2;
+        if (engine > 0) continue;
+        if (args[i] == "--socket" && i + 1 < args.size()) {
+            opts.socketPath = args[++i];
+        } else {
+            std::cerr << "daemon: unexpected argument " << args[i] << "\n";
+            return 2;
+        }
+    }
+
+    WipeDaemon daemon(opts);
+    runningDaemon = &daemon;
+    struct sigaction sa{};
+    sa.sa_handler = stopDaemon;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    bool ok = daemon.run();
+    runningDaemon = nullptr;
+    return ok ? 0 : 1;
+}
+
+// Splits off --socket; the default is the daemon's.
+static std::string takeSocketOption(std::vector<std::string>& args) {
+    std::string path = DaemonOptions().socketPath;
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        if (args[i] != "--socket") continue;
+        path = args[i + 1];
+        args.erase(args.begin() + i, args.begin() + i + 2);
+        break;
+    }
+    return path;
+}
+
+static int cmdStatus(EventWriter& w, std::vector<std::string> args) {
+    std::string socketPath = takeSocketOption(args);
+    nlohmann::json req = {{"op", "status"}};
+    if (args.size() == 1) {
+        req["job"] = (unsigned)atoi(args[0].c_str());
+    } else if (!args.empty()) {
+        std::cerr << "status: at most one job id\n";
+        return 2;
+    }
+
+    DaemonClient client;
+    nlohmann::json reply;
+    if (!client.connect(socketPath) || !client.call(req, reply)) return 1;
+    if (!reply.value("ok", false)) {
+        std::cerr << "status: " << reply.value("error", "") << "\n";
+        return 1;
+    }
+    for (nlohmann::json job : reply["jobs"]) {
+        if (w.jsonMode()) {
+            job["event"] = "job";
+            w.event(job);
+            continue;
+        }
+        std::string line = "job " + std::to_string(job.value("job", 0u)) + "  " +
+                           job.value("device", "") + "  " + job.value("method", "") + "  " +
+                           job.value("state", "");
+        if (job.contains("progress")) {
+            const auto& p = job["progress"];
+            uint64_t total = p.value("bytes_total", (uint64_t)0);
+            line += " " + std::to_string(total ? p.value("bytes_done", (uint64_t)0) * 100 / total : 0) + "%";
+        }
+        if (job.contains("error")) line += " (" + job.value("error", "") + ")";
+        w.text(line);
+    }
+    return 0;
+}
+
+static int cmdCancel(EventWriter& w, std::vector<std::string> args) {
+    std::string socketPath = takeSocketOption(args);
+    if (args.size() != 1) {
+        std::cerr << "cancel: expected one job id\n";
+        return 2;
+    }
+    unsigned id = (unsigned)atoi(args[0].c_str());
+
+    DaemonClient client;
+    nlohmann::json reply;
+    if (!client.connect(socketPath) || !client.call({{"op", "cancel"}, {"job", id}}, reply)) return 1;
+    bool ok = reply.value("ok", false);
+    if (w.jsonMode()) {
+        nlohmann::json j = { {"event", "cancel"}, {"job", id}, {"ok", ok} };
+        if (!ok) j["error"] = reply.value("error", "");
+        w.event(j);
+    } else if (!ok) {
+        std::cerr << "cancel: job " << id << ": " << reply.value("error", "") << "\n";
+    }
+    return ok ? 0 : 1;
+}
+
+static int cmdVerify(EventWriter& w, const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::cerr << "verify: no certificates given\n";
+        return 2;
+    }
+
+    bool anyFailed = false;
+    for (const std::string& file : args) {
+        VerificationResult r = verifyCertificateFromFile(file);
+        if (!r.verified) anyFailed = true;
+        if (w.jsonMode()) {
+            nlohmann::json j = { {"event", "verify"}, {"file", file}, {"verified", r.verified} };
+            if (r.verified) {
+                j["timestamp"] = r.timestamp;
+                j["wipe_method"] = r.wipeMethod;
+            } else {
+                j["error"] = r.errorMessage;
+            }
+            w.event(j);
+        } else {
+            w.text(file + ": " + (r.verified ? "verified" : "NOT verified (" + r.errorMessage + ")"));
+        }
+    }
+    return anyFailed ? 1 : 0;
+}
+
+int runCli(int argc, char* argv[]) {
+    std::string command = argv[1];
+    bool json = false;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--json") json = true;
+        else if (a == "--help" || a == "-h") {
+            usage(argv[0]);
+            return 0;
+        } else {
+            args.push_back(a);
+        }
+    }
+
+    EventWriter w(json);
+    int rc = 2;
+    if (command == "list") rc = cmdList(w, args);
+    else if (command == "wipe") rc = cmdWipe(w, args);
+    else if (command == "verify") rc = cmdVerify(w, args);
+    else if (command == "daemon") rc = cmdDaemon(args);
+    else if (command == "status") rc = cmdStatus(w, args);
+    else if (command == "cancel") rc = cmdCancel(w, args);
+    if (rc == 2) usage(argv[0]);
+    return rc;
+}
@@ -0,0 +1,354 @@
+#include "include/daemon.hpp"
+#include "include/sysfs.hpp"
+#include "include/wire.hpp"
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+static constexpr auto PROGRESS_INTERVAL = std::chrono::seconds(1);
+// A streaming client that stops reading is dropped instead of stalling
+// the job updates for everyone else.
+static constexpr int SEND_TIMEOUT_SECONDS = 2;
+
+static bool finished(JobState s) {
+    return s == JobState::DONE || s == JobState::FAILED;
+}
+
+WipeDaemon::Client::~Client() {
+    if (fd >= 0) close(fd);
+}
+
+WipeDaemon::WipeDaemon(DaemonOptions opts_)
+    : opts(std::move(opts_)), hotplug(registry),
+      orchestrator(opts.maxConcurrent, opts.wipe, opts.qos, opts.limits) {
+    orchestrator.onJobUpdate([this](const WipeJob& job) {
+        nlohmann::json ev = jobToJson(job);
+        ev["event"] = "job";
+        broadcast(ev);
+    });
+    registry.subscribe([this](DeviceChange change, const Device& dev) {
+        nlohmann::json ev = deviceToJson(dev);
+        ev["event"] = "device";
+        ev["change"] = deviceChangeName(change);
+        broadcast(ev);
+    });
+}
+
+WipeDaemon::~WipeDaemon() {
+    stop();
+    if (wakeFd >= 0) close(wakeFd);
+}
+
+void WipeDaemon::stop() {
+    if (wakeFd < 0) return;
+    uint64_t one = 1;
+    ssize_t n = write(wakeFd, &one, sizeof(one));
+    (void)n;
+}
+
+bool WipeDaemon::run() {
+    // Peers that hang up mid-write must not kill the daemon.
+    signal(SIGPIPE, SIG_IGN);
+
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::path(opts.socketPath).parent_path();
+    if (!dir.empty()) {
+        std::filesystem::create_directories(dir, ec);
+        chmod(dir.c_str(), 0700);
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (opts.socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << opts.socketPath << "\n";
+        return false;
+    }
+    strcpy(addr.sun_path, opts.socketPath.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        perror("socket");
+        return false;
+    }
+    unlink(opts.socketPath.c_str());    // stale socket from an unclean exit
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+        perror(("bind " + opts.socketPath).c_str());
+        close(listenFd);
+        return false;
+    }
+    chmod(opts.socketPath.c_str(), 0600);
+
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        perror("eventfd");
+        close(listenFd);
+        return false;
+    }
+
+    // Listen first, then scan: a drive that arrives during the scan is then
+    // either in the scan or in an event, never in neither.
+    if (!hotplug.start()) std::cerr << "Hotplug monitoring unavailable; device list is static\n";
+    registry.reset(getDevices());
+    std::thread ticker(&WipeDaemon::progressLoop, this);
+    std::cout << "Daemon listening on " << opts.socketPath << std::endl;
+
+    pollfd fds[2] = { {listenFd, POLLIN, 0}, {wakeFd, POLLIN, 0} };
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+
+        // Only root and the daemon's own user may drive wipes.
+        ucred cred{};
+        socklen_t len = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+            (cred.uid != 0 && cred.uid != geteuid())) {
+            close(fd);
+            continue;
+        }
+        timeval tv{ SEND_TIMEOUT_SECONDS, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        auto client = std::make_shared<Client>();
+        client->fd = fd;
+        {
+            std::lock_guard<std::mutex> lock(clientsMtx);
+            clients.insert(client);
+        }
+        std::thread(&WipeDaemon::serve, this, client).detach();
+    }
+
+    std::cout << "Daemon stopping" << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(stopMtx);
+        stopping = true;
+    }
+    stopCv.notify_all();
+    ticker.join();
+    hotplug.stop();
+
+    // Wake every client thread and wait for them to let go of `this`.
+    close(listenFd);
+    unlink(opts.socketPath.c_str());
+    std::unique_lock<std::mutex> lock(clientsMtx);
+    for (const auto& c : clients) shutdown(c->fd, SHUT_RDWR);
+    clientsCv.wait(lock, [this] { return clients.empty(); });
+    return true;
+}
+
+void WipeDaemon::serve(std::shared_ptr<Client> client) {
+    nlohmann::json req;
+    while (readFrame(client->fd, req)) {
+        nlohmann::json reply = req.is_object() ? handle(req, client)
+                                               : nlohmann::json{{"ok", false}, {"error", "request must be an object"}};
+        if (req.is_object() && req.contains("id")) reply["id"] = req["id"];
+        if (!send(*client, reply)) break;
+    }
+
+    shutdown(client->fd, SHUT_RDWR);
+    std::lock_guard<std::mutex> lock(clientsMtx);
+    clients.erase(client);
+    clientsCv.notify_all();
+}
+
+nlohmann::json WipeDaemon::handle(const nlohmann::json& req, const std::shared_ptr<Client>& client) {
+    std::string op;
+    try {
+        // Inside the try: {"op": 1} throws rather than taking the daemon down.
+        op = req.value("op", "");
+        if (op == "devices") {
+            nlohmann::json list = nlohmann::json::array();
+            for (const Device& dev : registry.snapshot()) list.push_back(deviceToJson(dev));
+            return {{"ok", true}, {"devices", list}};
+        }
+        if (op == "submit") return submit(req);
+        if (op == "status") return status(req);
+        if (op == "cancel") {
+            unsigned id = req.at("job").get<unsigned>();
+            if (!orchestrator.cancel(id)) return {{"ok", false}, {"error", "no such active job"}};
+            return {{"ok", true}};
+        }
+        if (op == "certificate") {
+            WipeJob job;
+            if (!orchestrator.job(req.at("job").get<unsigned>(), job)) {
+                return {{"ok", false}, {"error", "no such job"}};
+            }
+            if (job.state != JobState::DONE) return {{"ok", false}, {"error", "job has not finished"}};
+            // As a string: re-serialising would change the hash on the chain.
+            return {{"ok", true}, {"certificate", job.certificate}};
+        }
+        if (op == "stream") {
+            std::lock_guard<std::mutex> lock(client->writeMtx);
+            client->streaming = true;
+            return {{"ok", true}};
+        }
+    } catch (const std::exception& e) {
+        return {{"ok", false}, {"error", std::string("bad request: ") + e.what()}};
+    }
+    return {{"ok", false}, {"error", "unknown op '" + op + "'"}};
+}
+
+nlohmann::json WipeDaemon::submit(const nlohmann::json& req) {
+    WipeMethod method;
+    if (!parseWipeMethod(req.at("method").get<std::string>(), method)) {
+        return {{"ok", false}, {"error", "unknown method"}};
+    }
+
+    nlohmann::json out = nlohmann::json::array();
+    for (const auto& p : req.at("devices")) {
+        std::string path = p.get<std::string>();
+        std::string name = blockDeviceName(path);
+
+        // The registry already knows present drives; no re-probe needed.
+        Device dev;
+        std::string error;
+        if (!registry.find(name, dev) && !getDevice(name, dev)) error = "unknown device";
+        else if (deviceInUse(name)) error = "device is in use (mounted, swap or held)";
+
+        unsigned id = 0;
+        if (error.empty() && !(id = orchestrator.submit(dev, method))) {
+            error = "a wipe is already running on this device";
+        }
+        if (id) out.push_back({{"device", path}, {"job", id}});
+        else out.push_back({{"device", path}, {"error", error}});
+    }
+    return {{"ok", true}, {"jobs", out}};
+}
+
+nlohmann::json WipeDaemon::status(const nlohmann::json& req) {
+    std::vector<WipeJob> jobs;
+    if (req.contains("job")) {
+        WipeJob job;
+        if (!orchestrator.job(req["job"].get<unsigned>(), job)) {
+            return {{"ok", false}, {"error", "no such job"}};
+        }
+        jobs.push_back(job);
+    } else {
+        jobs = orchestrator.jobs();
+    }
+
+    nlohmann::json out = nlohmann::json::array();
+    for (const WipeJob& job : jobs) {
+        nlohmann::json j = jobToJson(job);
+        ProgressSnapshot snap;
+        if (!finished(job.state) && job.state != JobState::QUEUED && orchestrator.progress(job.id, snap)) {
+            j["progress"] = progressToJson(snap);
+        }
+        out.push_back(j);
+    }
+    return {{"ok", true}, {"jobs", out}};
+}
+
+bool WipeDaemon::send(Client& client, const nlohmann::json& msg) {
+    std::lock_guard<std::mutex> lock(client.writeMtx);
+    return writeFrame(client.fd, msg);
+}
+
+void WipeDaemon::broadcast(const nlohmann::json& event) {
+    std::vector<std::shared_ptr<Client>> targets;
+    {
+        std::lock_guard<std::mutex> lock(clientsMtx);
+        for (const auto& c : clients) targets.push_back(c);
+    }
+    for (const auto& c : targets) {
+        {
+            std::lock_guard<std::mutex> lock(c->writeMtx);
+            if (!c->streaming) continue;
+        }
+        // A stuck reader times out; hanging up makes its serve() clean up.
+        if (!send(*c, event)) shutdown(c->fd, SHUT_RDWR);
+    }
+}
+
+void WipeDaemon::progressLoop() {
+    std::unique_lock<std::mutex> lock(stopMtx);
+    while (!stopCv.wait_for(lock, PROGRESS_INTERVAL, [this] { return stopping; })) {
+        lock.unlock();
+        for (const WipeJob& job : orchestrator.jobs()) {
+            if (finished(job.state) || job.state == JobState::QUEUED) continue;
+            ProgressSnapshot snap;
+            if (!orchestrator.progress(job.id, snap)) continue;
+            nlohmann::json ev = jobToJson(job);
+            ev["event"] = "progress";
+            ev.update(progressToJson(snap));
+            broadcast(ev);
+        }
+        lock.lock();
+    }
+}
+
+DaemonClient::~DaemonClient() {
+    if (fd >= 0) close(fd);
+}
+
+bool DaemonClient::connect(const std::string& socketPath) {
+    signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return false;
+    }
+    if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror(("connect " + socketPath).c_str());
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool DaemonClient::call(const nlohmann::json& req, nlohmann::json& reply) {
+    nlohmann::json msg = req;
+    unsigned id = nextId++;
+    msg["id"] = id;
+    if (!writeFrame(fd, msg)) return false;
+
+    nlohmann::json in;
+    while (readFrame(fd, in)) {
+        if (in.contains("event")) {
+            pending.push_back(in);
+            continue;
+        }
+        if (in.value("id", 0u) != id) continue;
+        reply = in;
+        return true;
+    }
+    return false;
+}
+
+bool DaemonClient::next(nlohmann::json& event) {
+    if (!pending.empty()) {
+        event = pending.front();
+        pending.erase(pending.begin());
+        return true;
+    }
+    nlohmann::json in;
+    while (readFrame(fd, in)) {
+        if (!in.contains("event")) continue;
+        event = in;
+        return true;
+    }
+    return false;
+}
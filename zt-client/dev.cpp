@@ -1,74 +1,281 @@
 #include "include/dev.hpp"
+#include "include/sysfs.hpp"
+#include "include/numa.hpp"
+#include "include/ata.hpp"
+#include "include/nvme.hpp"
+#include "include/capcache.hpp"
+#include <algorithm>
+#include <condition_variable>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
-#include <cstdio>
 #include <memory>
-#include <array>
+#include <mutex>
+#include <set>
+#include <thread>
 
-static std::string runCommand(const std::string& cmd) {
-    std::array<char, 4096> buffer{};
-    std::string result;
+namespace fs = std::filesystem;
 
-    std::unique_ptr<FILE, decltype(&pclose)>
-        pipe(popen(cmd.c_str(), "r"), pclose);
 
-    if (!pipe) return "";
+static bool supportsATASE(const std::string& devPath) {
+    SgIoTransport transport(devPath);
+    if (!transport.isOpen()) return false;
 
-    while (fgets(buffer.data(), buffer.size(), pipe.get())) {
-        result += buffer.data();
-    }
-    return result;
+    AtaIdentity id;
+    return ataIdentify(transport, id).ok() && id.securitySupported;
 }
 
+static bool probeNVMe(const std::string& devPath) {
+    IoctlNvmeTransport nvme(devPath);
+    if (!nvme.isOpen()) return false;
 
-namespace fs = std::filesystem;
+    NvmeController ctrl;
+    if (!nvmeIdentifyController(nvme, ctrl).ok()) return false;
+    return ctrl.sanitizeAny() || ctrl.formatSupported;
+}
+
+static constexpr unsigned MAX_PROBE_WORKERS = 16;
+
+// Shared between getDevices() and the probe workers. Workers are detached
+// and hold a reference, so one stuck in an ioctl on a hung bridge can
+// outlive the scan without touching freed memory.
+struct ProbeBatch {
+    struct Job {
+        std::string path;
+        std::string type;
+        bool started = false;
+        bool done = false;
+        bool supported = false;
+        std::chrono::steady_clock::time_point startedAt;
+    };
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Job> jobs;
+    size_t next = 0;
+    bool abandoned = false;     // the scan gave up; start no more jobs
+};
 
-// Helper to read a single line from a file
-static std::string readFileLine(const fs::path& path) {
-    std::ifstream file(path);
-    if (file.is_open()) {
-        std::string value;
-        std::getline(file, value);
-        // Trim whitespace/newlines
-        value.erase(value.find_last_not_of(" \n\r\t") + 1);
-        return value;
+// Devices with a probe still running from this or an earlier scan. A drive
+// whose probe hangs is not probed again until that one returns, so a
+// rescan loop cannot pile up stuck threads on it.
+static std::mutex outstandingMtx;
+static std::set<std::string> probesOutstanding;
+
+static void probeFinished(const std::string& path) {
+    std::lock_guard<std::mutex> lock(outstandingMtx);
+    probesOutstanding.erase(path);
+}
+
+static void probeWorker(std::shared_ptr<ProbeBatch> batch) {
+    for (;;) {
+        size_t i;
+        std::string path, type;
+        {
+            std::lock_guard<std::mutex> lock(batch->mtx);
+            if (batch->abandoned || batch->next >= batch->jobs.size()) return;
+            i = batch->next++;
+            batch->jobs[i].started = true;
+            batch->jobs[i].startedAt = std::chrono::steady_clock::now();
+            path = batch->jobs[i].path;
+            type = batch->jobs[i].type;
+        }
+
+        bool supported = type == "NVMe" ? probeNVMe(path) : supportsATASE(path);
+        probeFinished(path);
+
+        {
+            std::lock_guard<std::mutex> lock(batch->mtx);
+            batch->jobs[i].done = true;
+            batch->jobs[i].supported = supported;
+        }
+        batch->cv.notify_all();
     }
-    return "";
 }
 
+static void addFirmwareMethod(Device& dev) {
+    dev.supportedWipeMethods.push_back(dev.type == "NVMe" ? WipeMethod::FIRMWARE_ERASE
+                                                          : WipeMethod::ATA_SECURE_ERASE);
+}
 
-static bool supportsATASE(const std::string& devPath) {
-    std::string out = runCommand("hdparm -I " + devPath + " 2>/dev/null");
+// Runs the firmware erase probes for `devices` in parallel and fills in
+// their methods, flagging those whose probe missed the deadline or is
+// still stuck from an earlier scan. Drives in the capability cache are not
+// probed unless opts.refresh is set.
+static void probeFirmwareErase(std::vector<Device>& devices, const ScanOptions& opts) {
+    CapabilityCache cache(opts.capabilityCache);
+    cache.load();
 
-    if (out.empty()) return false;
+    auto batch = std::make_shared<ProbeBatch>();
+    std::vector<size_t> owner;
+    for (size_t i = 0; i < devices.size(); i++) {
+        Device& dev = devices[i];
+        if (dev.isReadOnly || (dev.type != "NVMe" && dev.type != "ATA/SCSI")) continue;
 
-    if (out.find("Security:") != std::string::npos &&
-        out.find("supported") != std::string::npos) {
-        return true;
+        CachedCapabilities cached;
+        if (!opts.refresh && !dev.identity.empty() && cache.lookup(dev.identity, dev.firmware, cached)) {
+            if (cached.firmwareErase) addFirmwareMethod(dev);
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(outstandingMtx);
+            if (!probesOutstanding.insert(dev.path).second) {
+                std::cerr << "Capability probe of " << dev.path << " still running\n";
+                dev.capabilitiesUnknown = true;
+                continue;
+            }
+        }
+        ProbeBatch::Job job;
+        job.path = dev.path;
+        job.type = dev.type;
+        batch->jobs.push_back(job);
+        owner.push_back(i);
+    }
+    if (batch->jobs.empty()) return;
+
+    auto timeout = opts.probeTimeout;
+    size_t workers = std::min<size_t>(batch->jobs.size(), MAX_PROBE_WORKERS);
+    for (size_t w = 0; w < workers; w++) std::thread(probeWorker, batch).detach();
+
+    // A job that never got a worker because every worker is stuck is given
+    // up once a healthy pool would have reached it.
+    auto now = std::chrono::steady_clock::now();
+    long rounds = (batch->jobs.size() + workers - 1) / workers;
+    auto queueDeadline = now + timeout * rounds;
+
+    std::unique_lock<std::mutex> lock(batch->mtx);
+    for (;;) {
+        now = std::chrono::steady_clock::now();
+        auto wakeAt = queueDeadline;
+        bool pending = false;
+        for (const auto& job : batch->jobs) {
+            if (job.done) continue;
+            auto deadline = job.started ? job.startedAt + timeout : queueDeadline;
+            if (now >= deadline) continue;
+            pending = true;
+            wakeAt = std::min(wakeAt, deadline);
+        }
+        if (!pending) break;
+        batch->cv.wait_until(lock, wakeAt);
+    }
+
+    // Jobs no worker reached will never run now.
+    batch->abandoned = true;
+    for (const auto& job : batch->jobs) {
+        if (!job.started) probeFinished(job.path);
+    }
+
+    for (size_t j = 0; j < batch->jobs.size(); j++) {
+        const auto& job = batch->jobs[j];
+        Device& dev = devices[owner[j]];
+        if (!job.done) {
+            std::cerr << "Capability probe of " << dev.path << " timed out\n";
+            dev.capabilitiesUnknown = true;
+            continue;
+        }
+        if (job.supported) addFirmwareMethod(dev);
+        if (!dev.identity.empty()) cache.store(dev.identity, dev.firmware, job.supported);
+    }
+    lock.unlock();
+    cache.save();
+}
+
+
+const char* wipeMethodName(WipeMethod m) {
+    switch (m) {
+        case WipeMethod::PLAIN_OVERWRITE:     return "plain";
+        case WipeMethod::ENCRYPTED_OVERWRITE: return "encrypted";
+        case WipeMethod::FIRMWARE_ERASE:      return "firmware";
+        case WipeMethod::ATA_SECURE_ERASE:    return "ata";
+    }
+    return "unknown";
+}
+
+bool parseWipeMethod(const std::string& name, WipeMethod& out) {
+    for (WipeMethod m : { WipeMethod::PLAIN_OVERWRITE, WipeMethod::ENCRYPTED_OVERWRITE,
+                          WipeMethod::FIRMWARE_ERASE, WipeMethod::ATA_SECURE_ERASE }) {
+        if (name == wipeMethodName(m)) {
+            out = m;
+            return true;
+        }
     }
     return false;
 }
 
-static bool probeNVMe(const std::string& devPath) {
-    std::string out = runCommand("nvme id-ctrl " + devPath + " 2>/dev/null");
-
-    auto pos = out.find("sanicap");
-    if (pos != std::string::npos) {
-        auto hexPos = out.find("0x", pos);
-        if (hexPos != std::string::npos) {
-            unsigned sanicap = std::stoul(
-                out.substr(hexPos + 2), nullptr, 16);
-            if (sanicap != 0)
-                return true;
+bool isCandidateDevice(const std::string& deviceName) {
+    // Filter out loop, ram, and other non-physical devices
+    return !(deviceName.rfind("loop", 0) == 0 ||
+             deviceName.rfind("ram", 0) == 0 ||
+             deviceName.rfind("dm-", 0) == 0 ||
+             deviceName.rfind("sr", 0) == 0); // sr is usually CD-ROM
+}
+
+// Everything about the device that sysfs can tell without talking to it.
+static bool readDevice(const fs::path& sysPath, Device& dev) {
+    std::string deviceName = sysPath.filename().string();
+    std::error_code ec;
+    if (!fs::is_directory(sysPath, ec)) return false;
+
+    dev = Device();
+    dev.name = deviceName;
+    dev.path = "/dev/" + deviceName;
+
+    // Read size (in sectors, usually 512 bytes)
+    std::string sizeStr = readSysfsLine(sysPath / "size");
+    try {
+        // Check if size is empty or not a number
+        if (!sizeStr.empty()) {
+            dev.sizeBytes = std::stoull(sizeStr) * 512;
+        } else {
+            dev.sizeBytes = 0;
         }
+    } catch (...) {
+        dev.sizeBytes = 0;
     }
 
-    return false;
+    dev.isRemovable = (readSysfsLine(sysPath / "removable") == "1");
+    dev.isReadOnly = (readSysfsLine(sysPath / "ro") == "1");
+
+    dev.model = readSysfsLine(sysPath / "device" / "model");
+    dev.transport = deviceTransport(deviceName);
+    dev.busPath = deviceBusPath(deviceName);
+    dev.pciPath = devicePciPath(deviceName);
+    dev.numaNode = deviceNumaNode(deviceName);
+    bool stableId = false;
+    dev.identity = deviceIdentity(deviceName, &stableId);
+    // name + size identities are reused across drives, so never cache them
+    if (!stableId) dev.identity.clear();
+    dev.firmware = firmwareRevision(deviceName);
+    // Determine Type
+    if (deviceName.rfind("nvme", 0) == 0) {
+        dev.type = "NVMe";
+    } else if (deviceName.rfind("sd", 0) == 0) {
+        dev.type = "ATA/SCSI"; // Broad category
+    } else if (deviceName.rfind("mmcblk", 0) == 0) {
+        dev.type = "SD/MMC";
+    } else {
+        dev.type = "Unknown";
+    }
+
+    // All writable block devices support overwrite
+    if (!dev.isReadOnly) {
+        dev.supportedWipeMethods.push_back(WipeMethod::PLAIN_OVERWRITE);
+        dev.supportedWipeMethods.push_back(WipeMethod::ENCRYPTED_OVERWRITE);
+    }
+    return true;
 }
 
+bool getDevice(const std::string& deviceName, Device& out, const ScanOptions& opts) {
+    if (!isCandidateDevice(deviceName)) return false;
 
-std::vector<Device> getDevices() {
+    std::vector<Device> devices(1);
+    if (!readDevice(fs::path("/sys/block") / deviceName, devices[0])) return false;
+    probeFirmwareErase(devices, opts);
+    out = devices[0];
+    return true;
+}
+
+std::vector<Device> getDevices(const ScanOptions& opts) {
     std::vector<Device> devices;
     std::string sysBlockPath = "/sys/block";
 
@@ -79,65 +286,14 @@ std::vector<Device> getDevices() {
 
     for (const auto& entry : fs::directory_iterator(sysBlockPath)) {
         if (!entry.is_directory()) continue;
-
-        std::string deviceName = entry.path().filename().string();
-        
-        // Filter out loop, ram, and other non-physical devices
-        if (deviceName.rfind("loop", 0) == 0 || 
-            deviceName.rfind("ram", 0) == 0 ||
-            deviceName.rfind("dm-", 0) == 0 ||
-            deviceName.rfind("sr", 0) == 0) { // sr is usually CD-ROM
-            continue;
-        }
+        if (!isCandidateDevice(entry.path().filename().string())) continue;
 
         Device dev;
-        dev.name = deviceName;
-        dev.path = "/dev/" + deviceName;
-        
-        // Read size (in sectors, usually 512 bytes)
-        std::string sizeStr = readFileLine(entry.path() / "size");
-        try {
-            // Check if size is empty or not a number
-            if (!sizeStr.empty()) {
-                dev.sizeBytes = std::stoull(sizeStr) * 512;
-            } else {
-                dev.sizeBytes = 0;
-            }
-        } catch (...) {
-            dev.sizeBytes = 0;
-        }
-
-        dev.isRemovable = (readFileLine(entry.path() / "removable") == "1");
-        dev.isReadOnly = (readFileLine(entry.path() / "ro") == "1");
-        
-        dev.model = readFileLine(entry.path() / "device" / "model");
-        // Determine Type
-        if (deviceName.rfind("nvme", 0) == 0) {
-            dev.type = "NVMe";
-        } else if (deviceName.rfind("sd", 0) == 0) {
-            dev.type = "ATA/SCSI"; // Broad category
-        } else if (deviceName.rfind("mmcblk", 0) == 0) {
-            dev.type = "SD/MMC";
-        } else {
-            dev.type = "Unknown";
-        }
-
-        // All writable block devices support overwrite
-        if (!dev.isReadOnly) {
-            dev.supportedWipeMethods.push_back(WipeMethod::PLAIN_OVERWRITE);
-            dev.supportedWipeMethods.push_back(WipeMethod::ENCRYPTED_OVERWRITE);
-            
-            // Heuristic for Firmware Erase
-            if (dev.type == "NVMe" && probeNVMe(dev.path)) {
-                dev.supportedWipeMethods.push_back(WipeMethod::FIRMWARE_ERASE);
-            } else if (dev.type == "ATA/SCSI" && supportsATASE(dev.path)) {
-                dev.supportedWipeMethods.push_back(WipeMethod::ATA_SECURE_ERASE);
-            }
-        }
-
-        devices.push_back(dev);
+        if (readDevice(entry.path(), dev)) devices.push_back(dev);
     }
+
+    // Firmware erase support needs a command round trip per drive, which
+    // is slow in bulk and can hang behind a bad bridge.
+    probeFirmwareErase(devices, opts);
     return devices;
 }
-
-
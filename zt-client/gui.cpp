@@ -2,6 +2,9 @@
 #include "include/cert.hpp"
 #include "include/wipe.hpp"
 #include "include/dev.hpp"
+#include "include/orchestrator.hpp"
+#include "include/hotplug.hpp"
+#include "include/station.hpp"
 #include <gtk/gtk.h>
 #include <iostream>
 #include <iomanip>
@@ -34,12 +37,64 @@ struct AppState {
     GtkWidget *verification_result_label;
     GtkWidget *verification_status_label;
     
+    // Job Panel Widgets
+    GtkWidget *jobs_box;
+    std::map<unsigned, GtkWidget*> job_labels;
+    std::map<unsigned, GtkWidget*> job_bars;
+    std::map<unsigned, GtkWidget*> job_cancel_buttons;
+    
     // Selected Context
-    Device selectedDevice;
+    std::vector<Device> selectedDevices;         // targets of the next wipe
+    std::map<std::string, Device> batchSelection; // ticked in the device list, keyed by path
+    
+    WipeOrchestrator *orchestrator;
+
+    // Device list, kept current by hotplug events
+    DeviceRegistry *registry;
+    HotplugMonitor *hotplug;
+    GtkWidget *device_list_box;
+    GtkWidget *empty_list_label;
+    std::map<std::string, GtkWidget*> device_cards; // keyed by /sys/block name
+
+    // Station mode, when started with a policy
+    std::string station_policy;
+    StationMode *station;
+    GtkWidget *station_label;
+    unsigned station_certified;
+    unsigned station_quarantined;
 };
 
 static AppState appState;
 
+// Station decisions are reported from hotplug and worker threads.
+static gboolean on_station_event(gpointer data) {
+    StationEvent* ev = (StationEvent*)data;
+    if (ev->kind == StationEventKind::CERTIFIED) appState.station_certified++;
+    if (ev->kind == StationEventKind::QUARANTINED) appState.station_quarantined++;
+
+    const char* color = "#40a4ff";
+    if (ev->kind == StationEventKind::CERTIFIED) color = "#64ff64";
+    else if (ev->kind == StationEventKind::QUARANTINED) color = "#ff6464";
+    else if (ev->kind == StationEventKind::SKIPPED) color = "#c0c0c0";
+
+    gchar* markup = g_markup_printf_escaped(
+        "<b>STATION MODE</b>  certified %u, quarantined %u\n"
+        "<span color='%s'>%s %s</span> %s",
+        appState.station_certified, appState.station_quarantined, color,
+        ev->device.path.c_str(), stationEventKindName(ev->kind), ev->detail.c_str());
+    gtk_label_set_markup(GTK_LABEL(appState.station_label), markup);
+    g_free(markup);
+
+    delete ev;
+    return FALSE;
+}
+
+// Registry change handed from the hotplug thread to the main loop.
+struct DeviceUpdate {
+    DeviceChange change;
+    Device device;
+};
+
 // --- Utilities ---
 
 std::string formatSize(uint64_t bytes) {
@@ -57,6 +112,8 @@ std::string formatSize(uint64_t bytes) {
 
 // --- Forward Declarations ---
 static void refresh_device_list(GtkWidget* container_box);
+static void reprobe_device_list(GtkWidget* container_box);
+static gboolean on_device_change(gpointer data);
 static void switch_to_device_list(GtkButton* btn, gpointer user_data);
 static void switch_to_landing(GtkButton* btn, gpointer user_data);
 static void switch_to_verification(GtkButton* btn, gpointer user_data);
@@ -99,36 +156,124 @@ static void show_status_safe(const std::string& msg, bool isError = false) {
 }
 
 
-static gboolean on_wipe_complete(gpointer data) {
-    WipeResult* resultPtr = (WipeResult*)data;
-    WipeResult result = *resultPtr;
-    delete resultPtr;
+static void on_cancel_job_clicked(GtkButton* btn, gpointer user_data) {
+    gtk_widget_set_sensitive(GTK_WIDGET(btn), FALSE);
+    appState.orchestrator->cancel(GPOINTER_TO_UINT(user_data));
+}
 
-    if (result.status == WipeStatus::SUCCESS) {
-        std::string cert = generateCertificateJSON(result);
-        std::cout << "--- WIPE CERTIFICATE ---\n" << cert << "\n------------------------" << std::endl;
+static gboolean on_job_update(gpointer data) {
+    WipeJob* jobPtr = (WipeJob*)data;
+    WipeJob job = *jobPtr;
+    delete jobPtr;
+
+    // One row per job in the jobs panel: status line and cancel button
+    // over a progress bar
+    GtkWidget *row;
+    auto it = appState.job_labels.find(job.id);
+    if (it == appState.job_labels.end()) {
+        GtkWidget *job_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+        GtkWidget *header = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+        row = gtk_label_new("");
+        gtk_widget_set_halign(row, GTK_ALIGN_START);
+        gtk_widget_set_hexpand(row, TRUE);
+        GtkWidget *cancel = gtk_button_new_with_label("Cancel");
+        g_signal_connect(cancel, "clicked", G_CALLBACK(on_cancel_job_clicked), GUINT_TO_POINTER(job.id));
+        gtk_box_append(GTK_BOX(header), row);
+        gtk_box_append(GTK_BOX(header), cancel);
+        GtkWidget *bar = gtk_progress_bar_new();
+        gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(bar), TRUE);
+        gtk_box_append(GTK_BOX(job_box), header);
+        gtk_box_append(GTK_BOX(job_box), bar);
+        gtk_box_append(GTK_BOX(appState.jobs_box), job_box);
+        appState.job_labels[job.id] = row;
+        appState.job_bars[job.id] = bar;
+        appState.job_cancel_buttons[job.id] = cancel;
+    } else {
+        row = it->second;
+    }
+    if (job.state == JobState::DONE || job.state == JobState::FAILED || job.state == JobState::CERTIFYING) {
+        gtk_widget_set_visible(appState.job_cancel_buttons[job.id], FALSE);
+    }
+
+    GtkProgressBar *bar = GTK_PROGRESS_BAR(appState.job_bars[job.id]);
+    if (job.state == JobState::DONE) {
+        gtk_progress_bar_set_fraction(bar, 1.0);
+        gtk_progress_bar_set_text(bar, "complete");
+    } else if (job.state == JobState::FAILED) {
+        gtk_progress_bar_set_text(bar, "failed");
+    } else if (job.state == JobState::QUEUED) {
+        gtk_progress_bar_set_text(bar, "waiting");
+    }
 
-        auto certHash = sha256(cert);
-        auto devHash = deviceIdentityHash(result);
-        auto payload = makeChainRequest(certHash, devHash, static_cast<uint8_t>(result.method));
+    const char* color = "#c0c0c0";
+    if (job.state == JobState::DONE) color = "#64ff64";
+    else if (job.state == JobState::FAILED) color = "#ff6464";
+    else if (job.state != JobState::QUEUED) color = "#40a4ff";
 
-        if (recordWipeViaHelper(payload)) {
-            show_status_safe("Wipe Success! Certificate recorded on blockchain.", false);
+    std::string detail = job.error;
+    if (job.state == JobState::DONE && !job.certRecorded) {
+        detail = "certificate recording failed";
+    }
+    gchar* markup = g_markup_printf_escaped(
+        "Job %u  <b>%s</b>  <span color='%s'>%s</span> %s",
+        job.id, job.device.path.c_str(), color, jobStateName(job.state), detail.c_str());
+    gtk_label_set_markup(GTK_LABEL(row), markup);
+    g_free(markup);
+
+    if (job.state == JobState::DONE) {
+        if (job.certRecorded) {
+            show_status_safe("Wipe Success on " + job.device.path + "! Certificate recorded on blockchain.", false);
         } else {
-            show_status_safe("Wipe Success, but Certificate recording failed.", true);
+            show_status_safe("Wipe Success on " + job.device.path + ", but Certificate recording failed.", true);
         }
-    } else if(result.status == WipeStatus::FAILURE) {
-        show_status_safe("Wipe Failed! Check console/logs.", true);
-    }
-
-    // Re-enable button
-    if (appState.confirm_wipe_btn) {
-        gtk_widget_set_sensitive(appState.confirm_wipe_btn, TRUE);
+    } else if (job.state == JobState::FAILED) {
+        show_status_safe("Wipe Failed on " + job.device.path + "! Check console/logs.", true);
     }
 
     return FALSE; // Stop the idle function
 }
 
+static std::string formatDuration(double seconds) {
+    unsigned long s = (unsigned long)seconds;
+    std::stringstream ss;
+    if (s >= 3600) ss << s / 3600 << "h " << (s % 3600) / 60 << "m";
+    else if (s >= 60) ss << s / 60 << "m " << s % 60 << "s";
+    else ss << s << "s";
+    return ss.str();
+}
+
+// Polled from a GLib timeout: reads each running job's progress counters
+// without touching the wipe threads.
+static gboolean poll_job_progress(gpointer data) {
+    (void)data;
+    for (const auto& [id, widget] : appState.job_bars) {
+        WipeJob job;
+        if (!appState.orchestrator->job(id, job)) continue;
+        if (job.state != JobState::RUNNING && job.state != JobState::VERIFYING) continue;
+
+        ProgressSnapshot snap;
+        if (!appState.orchestrator->progress(id, snap)) continue;
+
+        std::stringstream text;
+        text << wipePhaseName(snap.phase);
+        if (snap.phase == WipePhase::WRITING || snap.phase == WipePhase::FLUSHING) {
+            text << " pass " << snap.pass << "/" << snap.passes;
+        }
+        if (snap.phase != WipePhase::ERASING) {
+            text << "  " << formatSize((uint64_t)snap.currentRate) << "/s"
+                 << " (avg " << formatSize((uint64_t)snap.averageRate) << "/s)";
+        }
+        if (snap.etaSeconds >= 0) text << "  ETA " << formatDuration(snap.etaSeconds);
+        if (snap.idleSeconds > 30) text << "  - stalled for " << formatDuration(snap.idleSeconds);
+
+        GtkProgressBar *bar = GTK_PROGRESS_BAR(widget);
+        if (snap.bytesTotal) gtk_progress_bar_set_fraction(bar, snap.fraction());
+        else gtk_progress_bar_pulse(bar);
+        gtk_progress_bar_set_text(bar, text.str().c_str());
+    }
+    return TRUE; // keep polling
+}
+
 static void on_confirm_wipe_clicked(GtkButton* btn, gpointer user_data) {
     (void)btn;
     (void)user_data;
@@ -150,25 +295,24 @@ static void on_confirm_wipe_clicked(GtkButton* btn, gpointer user_data) {
         methodStr = "Firmware Erase";
     }
     
-    std::cout << "Starting wipe on " << appState.selectedDevice.path 
-              << " using method: " << methodStr << std::endl;
-              
-    show_status_safe("Wiping... Please Wait... (This may take a while)", false);
-    
+    for (const Device& dev : appState.selectedDevices) {
+        std::cout << "Queueing wipe on " << dev.path
+                  << " using method: " << methodStr << std::endl;
+    }
+
+    std::vector<unsigned> ids = appState.orchestrator->submit(appState.selectedDevices, method);
+    if (ids.empty()) {
+        show_status_safe("Nothing queued - the selected drives are already being wiped.", true);
+        return;
+    }
+
+    show_status_safe("Queued " + std::to_string(ids.size()) +
+                     " wipe(s). Progress is shown in the device list.", false);
+
     // Disable button to prevent re-entry
     if (appState.confirm_wipe_btn) {
         gtk_widget_set_sensitive(appState.confirm_wipe_btn, FALSE);
     }
-
-    std::string path = appState.selectedDevice.path;
-
-    // Launch worker thread
-    std::thread worker([path, method]() {
-        WipeResult resultVal = wipeDisk(path, method);
-        WipeResult* resultHeap = new WipeResult(resultVal);
-        g_idle_add(on_wipe_complete, resultHeap);
-    });
-    worker.detach();
 }
 
 static void switch_to_device_list(GtkButton* btn, gpointer user_data) {
@@ -180,9 +324,23 @@ static void switch_to_device_list(GtkButton* btn, gpointer user_data) {
 // Prepare the options screen for the selected device
 static void prepare_wipe_options() {
     // Update Label
-    std::string labelText = "Target: <b>" + appState.selectedDevice.name + "</b>\n" +
-                            "<span size='small' color='gray'>" + appState.selectedDevice.path + " - " + 
-                            formatSize(appState.selectedDevice.sizeBytes) + "</span>";
+    std::string labelText;
+    if (appState.selectedDevices.size() == 1) {
+        const Device& dev = appState.selectedDevices.front();
+        labelText = "Target: <b>" + dev.name + "</b>\n" +
+                    "<span size='small' color='gray'>" + dev.path + " - " +
+                    formatSize(dev.sizeBytes) + "</span>";
+    } else {
+        uint64_t total = 0;
+        std::string paths;
+        for (const Device& dev : appState.selectedDevices) {
+            total += dev.sizeBytes;
+            paths += (paths.empty() ? "" : ", ") + dev.path;
+        }
+        labelText = "Targets: <b>" + std::to_string(appState.selectedDevices.size()) + " drives</b>\n" +
+                    "<span size='small' color='gray'>" + paths + " - " +
+                    formatSize(total) + " total</span>";
+    }
     gtk_label_set_markup(GTK_LABEL(appState.target_device_label), labelText.c_str());
     
     // Reset Status
@@ -200,12 +358,35 @@ static void prepare_wipe_options() {
 static void on_wipe_request(GtkButton* btn, gpointer user_data) {
     (void)btn;
     Device* dev = (Device*)user_data;
-    appState.selectedDevice = *dev; // Copy device data
+    appState.selectedDevices = { *dev }; // Copy device data
     
     prepare_wipe_options();
     gtk_stack_set_visible_child(GTK_STACK(appState.stack), appState.wipe_options_view);
 }
 
+static void on_wipe_selected(GtkButton* btn, gpointer user_data) {
+    (void)btn;
+    (void)user_data;
+    if (appState.batchSelection.empty()) return;
+
+    appState.selectedDevices.clear();
+    for (const auto& [path, dev] : appState.batchSelection) {
+        appState.selectedDevices.push_back(dev);
+    }
+
+    prepare_wipe_options();
+    gtk_stack_set_visible_child(GTK_STACK(appState.stack), appState.wipe_options_view);
+}
+
+static void on_batch_toggled(GtkCheckButton* check, gpointer user_data) {
+    Device* dev = (Device*)user_data;
+    if (gtk_check_button_get_active(check)) {
+        appState.batchSelection[dev->path] = *dev;
+    } else {
+        appState.batchSelection.erase(dev->path);
+    }
+}
+
 static void free_device_copy(gpointer data, GClosure* closure) {
     (void)closure;
     delete (Device*)data;
@@ -231,10 +412,25 @@ static GtkWidget* create_device_list_view() {
     gtk_widget_set_hexpand(spacer, TRUE);
     gtk_box_append(GTK_BOX(header_bar), spacer);
 
+    GtkWidget *wipe_selected_btn = gtk_button_new_with_label("Wipe Selected");
+    gtk_widget_add_css_class(wipe_selected_btn, "destructive-action");
+    g_signal_connect(wipe_selected_btn, "clicked", G_CALLBACK(on_wipe_selected), NULL);
+    gtk_box_append(GTK_BOX(header_bar), wipe_selected_btn);
+
     GtkWidget *refresh_btn = gtk_button_new_with_label("Refresh Devices");
     gtk_box_append(GTK_BOX(header_bar), refresh_btn);
+
+    GtkWidget *reprobe_btn = gtk_button_new_with_label("Re-probe All");
+    gtk_widget_set_tooltip_text(reprobe_btn, "Ignore cached drive capabilities and query every drive");
+    gtk_box_append(GTK_BOX(header_bar), reprobe_btn);
     
     gtk_box_append(GTK_BOX(box), header_bar);
+
+    appState.station_label = gtk_label_new(NULL);
+    gtk_widget_set_halign(appState.station_label, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(appState.station_label, 30);
+    gtk_widget_set_visible(appState.station_label, FALSE);
+    gtk_box_append(GTK_BOX(box), appState.station_label);
     gtk_box_append(GTK_BOX(box), gtk_separator_new(GTK_ORIENTATION_HORIZONTAL));
 
     // Content Scroller
@@ -250,11 +446,38 @@ static GtkWidget* create_device_list_view() {
     
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled_window), content_box);
 
+    // Jobs Panel
+    GtkWidget *jobs_frame = gtk_frame_new("Wipe Jobs");
+    gtk_widget_set_margin_start(jobs_frame, 30);
+    gtk_widget_set_margin_end(jobs_frame, 30);
+    gtk_widget_set_margin_bottom(jobs_frame, 20);
+    appState.jobs_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+    gtk_widget_set_margin_top(appState.jobs_box, 8);
+    gtk_widget_set_margin_bottom(appState.jobs_box, 8);
+    gtk_widget_set_margin_start(appState.jobs_box, 8);
+    gtk_widget_set_margin_end(appState.jobs_box, 8);
+    gtk_frame_set_child(GTK_FRAME(jobs_frame), appState.jobs_box);
+    gtk_box_append(GTK_BOX(box), jobs_frame);
+
+    appState.device_list_box = content_box;
+
+    // Hotplug events keep the list current after the initial scan; without
+    // them the Refresh button is the only way to pick up new drives.
+    appState.registry = new DeviceRegistry();
+    appState.registry->subscribe([](DeviceChange change, const Device& dev) {
+        g_idle_add(on_device_change, new DeviceUpdate{change, dev});
+    });
+    appState.hotplug = new HotplugMonitor(*appState.registry);
+    if (!appState.hotplug->start()) {
+        std::cerr << "Hotplug monitoring unavailable; use Refresh Devices\n";
+    }
+
     // Initial load
     refresh_device_list(content_box);
     
     // Signal
     g_signal_connect_swapped(refresh_btn, "clicked", G_CALLBACK(refresh_device_list), content_box);
+    g_signal_connect_swapped(reprobe_btn, "clicked", G_CALLBACK(reprobe_device_list), content_box);
     
     return box;
 }
@@ -508,104 +731,176 @@ static void on_verify_certificate(GtkButton* btn, gpointer user_data) {
 
 // --- List Logic (Refactored) ---
 
-static void refresh_device_list(GtkWidget* container_box) {
-    // Remove all children
-    GtkWidget *child = gtk_widget_get_first_child(container_box);
-    while (child != NULL) {
-        GtkWidget *next = gtk_widget_get_next_sibling(child);
-        gtk_box_remove(GTK_BOX(container_box), child);
-        child = next;
+static GtkWidget* build_device_card(const Device& dev) {
+    // Card Container (Frame)
+    GtkWidget *frame = gtk_frame_new(NULL);
+    gtk_widget_set_margin_bottom(frame, 10);
+    
+    // Main Box inside Frame
+    GtkWidget *card_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
+    gtk_widget_set_margin_top(card_box, 12);
+    gtk_widget_set_margin_bottom(card_box, 12);
+    gtk_widget_set_margin_start(card_box, 12);
+    gtk_widget_set_margin_end(card_box, 12);
+    gtk_frame_set_child(GTK_FRAME(frame), card_box);
+
+    // -- Top Row: Type & Name --
+    GtkWidget *top_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    
+    // Type Badge
+    GtkWidget *type_label = gtk_label_new(dev.type.c_str());
+    gtk_widget_add_css_class(type_label, "badge"); 
+    char* type_markup = g_strdup_printf("<span background='#40a4ff' color='white' weight='bold'>  %s  </span>", dev.type.c_str());
+    gtk_label_set_markup(GTK_LABEL(type_label), type_markup);
+    g_free(type_markup);
+    gtk_box_append(GTK_BOX(top_row), type_label);
+
+    // Name
+    GtkWidget *name_label = gtk_label_new(dev.name.c_str());
+    char* name_markup = g_strdup_printf("<span size='large' weight='bold'>%s</span>", dev.name.c_str());
+    gtk_label_set_markup(GTK_LABEL(name_label), name_markup);
+    g_free(name_markup);
+    gtk_box_append(GTK_BOX(top_row), name_label);
+
+    gtk_box_append(GTK_BOX(card_box), top_row);
+
+    // -- Details Row --
+    GtkWidget *details_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 20);
+    
+    // Model
+    std::string modelStr = "Model: " + (dev.model.empty() ? "Unknown" : dev.model);
+    GtkWidget *model_label = gtk_label_new(modelStr.c_str());
+    gtk_widget_add_css_class(model_label, "dim-label");
+    gtk_box_append(GTK_BOX(details_box), model_label);
+
+    // Size
+    std::string sizeStr = "Size: " + formatSize(dev.sizeBytes);
+    GtkWidget *size_label = gtk_label_new(sizeStr.c_str());
+    gtk_widget_add_css_class(size_label, "dim-label");
+    gtk_box_append(GTK_BOX(details_box), size_label);
+
+    // Flags
+    if (dev.isReadOnly) {
+        GtkWidget *flag = gtk_label_new(NULL);
+        gtk_label_set_markup(GTK_LABEL(flag), "<span color='#ff6464'>[READ-ONLY]</span>");
+        gtk_box_append(GTK_BOX(details_box), flag);
     }
+    if (dev.capabilitiesUnknown) {
+        GtkWidget *flag = gtk_label_new(NULL);
+        gtk_label_set_markup(GTK_LABEL(flag), "<span color='#ffb020'>[CAPABILITIES UNKNOWN]</span>");
+        gtk_widget_set_tooltip_text(flag, "Firmware erase probe timed out; rescan to retry");
+        gtk_box_append(GTK_BOX(details_box), flag);
+    }
+    if (dev.isRemovable) {
+        GtkWidget *flag = gtk_label_new(NULL);
+        gtk_label_set_markup(GTK_LABEL(flag), "<span color='#64ff64'>[REMOVABLE]</span>");
+        gtk_box_append(GTK_BOX(details_box), flag);
+    }
+
+    gtk_box_append(GTK_BOX(card_box), details_box);
 
-    std::vector<Device> devices = getDevices();
+    // -- Actions Row --
+    GtkWidget *actions_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_widget_set_margin_top(actions_box, 8);
+
+    GtkWidget *wipe_btn = gtk_button_new_with_label("Wipe Drive");
+    gtk_widget_add_css_class(wipe_btn, "destructive-action");
     
-    if (devices.empty()) {
+    // Copy device data for callback
+    Device* devCopy = new Device(dev);
+    g_signal_connect_data(wipe_btn, "clicked", G_CALLBACK(on_wipe_request), devCopy, free_device_copy, (GConnectFlags)0);
+
+    gtk_box_append(GTK_BOX(actions_box), wipe_btn);
+
+    GtkWidget *batch_check = gtk_check_button_new_with_label("Select for batch");
+    Device* batchCopy = new Device(dev);
+    g_signal_connect_data(batch_check, "toggled", G_CALLBACK(on_batch_toggled), batchCopy, free_device_copy, (GConnectFlags)0);
+    gtk_box_append(GTK_BOX(actions_box), batch_check);
+    gtk_box_append(GTK_BOX(card_box), actions_box);
+
+    return frame;
+}
+
+// Shown instead of the cards while the list is empty.
+static void update_empty_label(GtkWidget* container_box) {
+    bool empty = appState.device_cards.empty();
+    if (empty && !appState.empty_list_label) {
         GtkWidget *label = gtk_label_new(NULL);
         gtk_label_set_markup(GTK_LABEL(label), "<span color='red' size='large'>No devices found.</span>\n(Try running as root/sudo if drives are missing)");
         gtk_widget_set_halign(label, GTK_ALIGN_CENTER);
         gtk_widget_set_margin_top(label, 20);
         gtk_box_append(GTK_BOX(container_box), label);
-        return;
+        appState.empty_list_label = label;
+    } else if (!empty && appState.empty_list_label) {
+        gtk_box_remove(GTK_BOX(container_box), appState.empty_list_label);
+        appState.empty_list_label = NULL;
+    }
+}
+
+static void load_device_list(GtkWidget* container_box, const ScanOptions& scan) {
+    // Remove all children
+    GtkWidget *child = gtk_widget_get_first_child(container_box);
+    while (child != NULL) {
+        GtkWidget *next = gtk_widget_get_next_sibling(child);
+        gtk_box_remove(GTK_BOX(container_box), child);
+        child = next;
     }
 
+    appState.batchSelection.clear();
+    appState.device_cards.clear();
+    appState.empty_list_label = NULL;
+    std::vector<Device> devices = getDevices(scan);
+    if (appState.registry) appState.registry->reset(devices);
+    
     for (const auto& dev : devices) {
-        // Card Container (Frame)
-        GtkWidget *frame = gtk_frame_new(NULL);
-        gtk_widget_set_margin_bottom(frame, 10);
-        
-        // Main Box inside Frame
-        GtkWidget *card_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
-        gtk_widget_set_margin_top(card_box, 12);
-        gtk_widget_set_margin_bottom(card_box, 12);
-        gtk_widget_set_margin_start(card_box, 12);
-        gtk_widget_set_margin_end(card_box, 12);
-        gtk_frame_set_child(GTK_FRAME(frame), card_box);
-
-        // -- Top Row: Type & Name --
-        GtkWidget *top_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
-        
-        // Type Badge
-        GtkWidget *type_label = gtk_label_new(dev.type.c_str());
-        gtk_widget_add_css_class(type_label, "badge"); 
-        char* type_markup = g_strdup_printf("<span background='#40a4ff' color='white' weight='bold'>  %s  </span>", dev.type.c_str());
-        gtk_label_set_markup(GTK_LABEL(type_label), type_markup);
-        g_free(type_markup);
-        gtk_box_append(GTK_BOX(top_row), type_label);
-
-        // Name
-        GtkWidget *name_label = gtk_label_new(dev.name.c_str());
-        char* name_markup = g_strdup_printf("<span size='large' weight='bold'>%s</span>", dev.name.c_str());
-        gtk_label_set_markup(GTK_LABEL(name_label), name_markup);
-        g_free(name_markup);
-        gtk_box_append(GTK_BOX(top_row), name_label);
-
-        gtk_box_append(GTK_BOX(card_box), top_row);
-
-        // -- Details Row --
-        GtkWidget *details_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 20);
-        
-        // Model
-        std::string modelStr = "Model: " + (dev.model.empty() ? "Unknown" : dev.model);
-        GtkWidget *model_label = gtk_label_new(modelStr.c_str());
-        gtk_widget_add_css_class(model_label, "dim-label");
-        gtk_box_append(GTK_BOX(details_box), model_label);
-
-        // Size
-        std::string sizeStr = "Size: " + formatSize(dev.sizeBytes);
-        GtkWidget *size_label = gtk_label_new(sizeStr.c_str());
-        gtk_widget_add_css_class(size_label, "dim-label");
-        gtk_box_append(GTK_BOX(details_box), size_label);
-
-        // Flags
-        if (dev.isReadOnly) {
-            GtkWidget *flag = gtk_label_new(NULL);
-            gtk_label_set_markup(GTK_LABEL(flag), "<span color='#ff6464'>[READ-ONLY]</span>");
-            gtk_box_append(GTK_BOX(details_box), flag);
+        GtkWidget *frame = build_device_card(dev);
+        gtk_box_append(GTK_BOX(container_box), frame);
+        appState.device_cards[dev.name] = frame;
+    }
+    update_empty_label(container_box);
+}
+
+// Idle callback for one registry change: only the affected card is
+// added, replaced or removed.
+static gboolean on_device_change(gpointer data) {
+    DeviceUpdate* update = (DeviceUpdate*)data;
+    const Device& dev = update->device;
+    GtkWidget *container_box = appState.device_list_box;
+
+    auto it = appState.device_cards.find(dev.name);
+    GtkWidget *old = it == appState.device_cards.end() ? NULL : it->second;
+    // A replaced card starts unticked, so drop any batch selection with it.
+    appState.batchSelection.erase(dev.path);
+
+    if (update->change == DeviceChange::REMOVED) {
+        if (old) {
+            gtk_box_remove(GTK_BOX(container_box), old);
+            appState.device_cards.erase(it);
         }
-        if (dev.isRemovable) {
-            GtkWidget *flag = gtk_label_new(NULL);
-            gtk_label_set_markup(GTK_LABEL(flag), "<span color='#64ff64'>[REMOVABLE]</span>");
-            gtk_box_append(GTK_BOX(details_box), flag);
+    } else {
+        GtkWidget *frame = build_device_card(dev);
+        if (old) {
+            gtk_box_insert_child_after(GTK_BOX(container_box), frame, old);
+            gtk_box_remove(GTK_BOX(container_box), old);
+        } else {
+            gtk_box_append(GTK_BOX(container_box), frame);
         }
+        appState.device_cards[dev.name] = frame;
+    }
+    update_empty_label(container_box);
 
-        gtk_box_append(GTK_BOX(card_box), details_box);
-
-        // -- Actions Row --
-        GtkWidget *actions_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
-        gtk_widget_set_margin_top(actions_box, 8);
-
-        GtkWidget *wipe_btn = gtk_button_new_with_label("Wipe Drive");
-        gtk_widget_add_css_class(wipe_btn, "destructive-action");
-        
-        // Copy device data for callback
-        Device* devCopy = new Device(dev);
-        g_signal_connect_data(wipe_btn, "clicked", G_CALLBACK(on_wipe_request), devCopy, free_device_copy, (GConnectFlags)0);
+    delete update;
+    return FALSE;
+}
 
-        gtk_box_append(GTK_BOX(actions_box), wipe_btn);
-        gtk_box_append(GTK_BOX(card_box), actions_box);
+static void refresh_device_list(GtkWidget* container_box) {
+    load_device_list(container_box, ScanOptions());
+}
 
-        gtk_box_append(GTK_BOX(container_box), frame);
-    }
+static void reprobe_device_list(GtkWidget* container_box) {
+    ScanOptions scan;
+    scan.refresh = true;
+    load_device_list(container_box, scan);
 }
 
 // --- Main Init ---
@@ -616,6 +911,17 @@ static void on_activate(GtkApplication *app, gpointer user_data) {
     gtk_window_set_title(GTK_WINDOW(window), "ZeroTrace");
     gtk_window_set_default_size(GTK_WINDOW(window), 900, 700);
 
+    // Deliberately never destroyed: its destructor waits for running wipes,
+    // which must not block closing the window.
+    if (!appState.orchestrator) {
+        appState.orchestrator = new WipeOrchestrator();
+        appState.orchestrator->onJobUpdate([](const WipeJob& job) {
+            if (appState.station) appState.station->jobUpdated(job);
+            g_idle_add(on_job_update, new WipeJob(job));
+        });
+        g_timeout_add(500, poll_job_progress, nullptr);
+    }
+
     // Load CSS
        // Main Stack
     appState.stack = gtk_stack_new();
@@ -634,13 +940,35 @@ static void on_activate(GtkApplication *app, gpointer user_data) {
     
     // Set landing as initial view
     gtk_stack_set_visible_child(GTK_STACK(appState.stack), appState.landing_view);
+
+    // Station mode goes straight to the device list and wipes new drives
+    // as the policy says; the manual controls stay usable alongside it.
+    StationPolicy policy;
+    if (!appState.station && !appState.station_policy.empty() &&
+        loadStationPolicy(appState.station_policy, policy)) {
+        appState.station = new StationMode(policy, *appState.registry, *appState.orchestrator);
+        appState.station->onEvent([](const StationEvent& ev) {
+            g_idle_add(on_station_event, new StationEvent(ev));
+        });
+        appState.station->start();
+
+        gtk_label_set_markup(GTK_LABEL(appState.station_label),
+                             "<b>STATION MODE</b>  waiting for drives");
+        gtk_widget_set_visible(appState.station_label, TRUE);
+        gtk_stack_set_visible_child(GTK_STACK(appState.stack), appState.device_list_view);
+    } else if (!appState.station && !appState.station_policy.empty()) {
+        gtk_label_set_markup(GTK_LABEL(appState.station_label),
+                             "<span color='#ff6464'><b>Station policy could not be loaded</b></span>; manual mode only");
+        gtk_widget_set_visible(appState.station_label, TRUE);
+    }
     
     gtk_window_set_child(GTK_WINDOW(window), appState.stack);
 
     gtk_window_present(GTK_WINDOW(window));
 }
 
-void runGui() {
+void runGui(const std::string& stationPolicy) {
+    appState.station_policy = stationPolicy;
     GtkApplication *app = gtk_application_new("com.zerotrace.client", G_APPLICATION_DEFAULT_FLAGS);
     g_signal_connect(app, "activate", G_CALLBACK(on_activate), NULL);
     g_application_run(G_APPLICATION(app), 0, NULL);
@@ -0,0 +1,295 @@
+#include "include/hotplug.hpp"
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Room for a burst of events while a probe is holding up the thread; the
+// kernel drops events (ENOBUFS) once this fills.
+static constexpr int UEVENT_RCVBUF = 4 * 1024 * 1024;
+static constexpr size_t UEVENT_MAX = 8192;
+
+std::string Uevent::get(const std::string& key) const {
+    auto it = env.find(key);
+    return it == env.end() ? std::string() : it->second;
+}
+
+bool parseUevent(const char* buf, size_t len, Uevent& out) {
+    out = Uevent();
+    size_t pos = 0;
+    bool first = true;
+    while (pos < len) {
+        size_t n = strnlen(buf + pos, len - pos);
+        std::string field(buf + pos, n);
+        pos += n + 1;
+
+        if (first) {
+            first = false;
+            size_t at = field.find('@');
+            if (at == std::string::npos) return false;  // "libudev" header
+            out.action = field.substr(0, at);
+            out.devpath = field.substr(at + 1);
+            continue;
+        }
+        size_t eq = field.find('=');
+        if (eq != std::string::npos) out.env[field.substr(0, eq)] = field.substr(eq + 1);
+    }
+    if (out.action.empty()) return false;
+    if (out.env.count("ACTION")) out.action = out.env["ACTION"];
+    return true;
+}
+
+std::vector<Uevent> readUevents(std::istream& in) {
+    std::vector<Uevent> events;
+    Uevent cur;
+    auto flush = [&]() {
+        if (cur.action.empty()) cur.action = cur.get("ACTION");
+        if (cur.devpath.empty()) cur.devpath = cur.get("DEVPATH");
+        if (!cur.action.empty()) events.push_back(cur);
+        cur = Uevent();
+    };
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) {
+            flush();
+            continue;
+        }
+        size_t eq = line.find('=');
+        // Headers such as "KERNEL[123.45] add /devices/... (block)" and
+        // udevadm's banner have no '=' before the first space.
+        if (eq == std::string::npos || line.find(' ') < eq) continue;
+        cur.env[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+    flush();
+    return events;
+}
+
+const char* deviceChangeName(DeviceChange c) {
+    switch (c) {
+        case DeviceChange::ADDED: return "added";
+        case DeviceChange::REMOVED: return "removed";
+        case DeviceChange::CHANGED: return "changed";
+    }
+    return "unknown";
+}
+
+// Whether a rescan found the device in a state the UI would show differently.
+static bool sameDevice(const Device& a, const Device& b) {
+    return a.path == b.path && a.sizeBytes == b.sizeBytes && a.isReadOnly == b.isReadOnly &&
+           a.isRemovable == b.isRemovable && a.model == b.model && a.identity == b.identity &&
+           a.firmware == b.firmware && a.capabilitiesUnknown == b.capabilitiesUnknown &&
+           a.supportedWipeMethods == b.supportedWipeMethods;
+}
+
+DeviceRegistry::DeviceRegistry(DeviceProber prober_) : prober(std::move(prober_)) {
+    if (!prober) {
+        prober = [](const std::string& name, Device& out) { return getDevice(name, out); };
+    }
+}
+
+void DeviceRegistry::reset(const std::vector<Device>& list) {
+    std::lock_guard<std::mutex> lock(mtx);
+    devices.clear();
+    for (const Device& dev : list) devices[dev.name] = dev;
+}
+
+void DeviceRegistry::resync(const std::vector<Device>& list) {
+    std::vector<std::pair<DeviceChange, Device>> changes;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::map<std::string, Device> fresh;
+        for (const Device& dev : list) fresh[dev.name] = dev;
+
+        for (const auto& [name, dev] : devices) {
+            if (!fresh.count(name)) changes.push_back({DeviceChange::REMOVED, dev});
+        }
+        for (const auto& [name, dev] : fresh) {
+            auto it = devices.find(name);
+            if (it == devices.end()) changes.push_back({DeviceChange::ADDED, dev});
+            else if (!sameDevice(it->second, dev)) changes.push_back({DeviceChange::CHANGED, dev});
+        }
+        devices = std::move(fresh);
+    }
+    for (const auto& [change, dev] : changes) notify(change, dev);
+}
+
+std::vector<Device> DeviceRegistry::snapshot() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Device> out;
+    for (const auto& [name, dev] : devices) out.push_back(dev);
+    return out;
+}
+
+bool DeviceRegistry::find(const std::string& name, Device& out) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = devices.find(name);
+    if (it == devices.end()) return false;
+    out = it->second;
+    return true;
+}
+
+unsigned DeviceRegistry::subscribe(Callback cb) {
+    std::lock_guard<std::mutex> lock(subMtx);
+    unsigned id = nextSubscriber++;
+    subscribers[id] = std::move(cb);
+    return id;
+}
+
+void DeviceRegistry::unsubscribe(unsigned id) {
+    std::lock_guard<std::mutex> lock(subMtx);
+    subscribers.erase(id);
+}
+
+void DeviceRegistry::notify(DeviceChange change, const Device& dev) {
+    std::vector<Callback> cbs;
+    {
+        std::lock_guard<std::mutex> lock(subMtx);
+        for (const auto& [id, cb] : subscribers) cbs.push_back(cb);
+    }
+    for (const Callback& cb : cbs) cb(change, dev);
+}
+
+bool DeviceRegistry::apply(const Uevent& ev) {
+    if (ev.get("SUBSYSTEM") != "block" || ev.get("DEVTYPE") != "disk") return false;
+    std::string name = ev.get("DEVNAME");
+    if (name.rfind("/dev/", 0) == 0) name = name.substr(5);
+    if (name.empty()) {
+        size_t slash = ev.devpath.rfind('/');
+        if (slash == std::string::npos) return false;
+        name = ev.devpath.substr(slash + 1);
+    }
+    if (!isCandidateDevice(name)) return false;
+
+    Device old;
+    bool known = find(name, old);
+
+    if (ev.action == "remove") {
+        if (!known) return false;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            devices.erase(name);
+        }
+        notify(DeviceChange::REMOVED, old);
+        return true;
+    }
+    if (ev.action != "add" && ev.action != "change") return false;
+
+    // Probe outside the lock; it talks to the drive and can take seconds.
+    Device dev;
+    if (!prober(name, dev)) {
+        // Gone again before we could read it.
+        if (!known) return false;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            devices.erase(name);
+        }
+        notify(DeviceChange::REMOVED, old);
+        return true;
+    }
+    if (known && sameDevice(old, dev)) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        devices[name] = dev;
+    }
+    notify(known ? DeviceChange::CHANGED : DeviceChange::ADDED, dev);
+    return true;
+}
+
+HotplugMonitor::HotplugMonitor(DeviceRegistry& registry_) : registry(registry_) {}
+
+HotplugMonitor::~HotplugMonitor() {
+    stop();
+}
+
+bool HotplugMonitor::start() {
+    if (running()) return true;
+
+    sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (sock < 0) {
+        perror("socket NETLINK_KOBJECT_UEVENT");
+        return false;
+    }
+    int rcvbuf = UEVENT_RCVBUF;
+    // RCVBUFFORCE exceeds rmem_max but needs CAP_NET_ADMIN; fall back quietly.
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;     // kernel uevents; udev rebroadcasts on group 2
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind uevent socket");
+        close(sock);
+        sock = -1;
+        return false;
+    }
+
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        perror("eventfd");
+        close(sock);
+        sock = -1;
+        return false;
+    }
+
+    worker = std::thread(&HotplugMonitor::run, this);
+    return true;
+}
+
+void HotplugMonitor::stop() {
+    if (!running()) return;
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) perror("eventfd write");
+    worker.join();
+    close(sock);
+    close(wakeFd);
+    sock = wakeFd = -1;
+}
+
+void HotplugMonitor::replay(const std::vector<Uevent>& events) {
+    for (const Uevent& ev : events) registry.apply(ev);
+}
+
+void HotplugMonitor::run() {
+    char buf[UEVENT_MAX];
+    pollfd fds[2] = { {sock, POLLIN, 0}, {wakeFd, POLLIN, 0} };
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll uevent socket");
+            return;
+        }
+        if (fds[1].revents) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        sockaddr_nl from{};
+        socklen_t fromLen = sizeof(from);
+        ssize_t n = recvfrom(sock, buf, sizeof(buf), 0, (sockaddr*)&from, &fromLen);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            if (errno == ENOBUFS) {
+                // The kernel dropped events; only a rescan can tell which.
+                std::cerr << "uevent queue overflowed, rescanning devices\n";
+                registry.resync(getDevices());
+                continue;
+            }
+            perror("recv uevent");
+            return;
+        }
+        // Only the kernel (port 0) may speak for devices.
+        if (from.nl_pid != 0) continue;
+
+        Uevent ev;
+        if (parseUevent(buf, n, ev)) registry.apply(ev);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Hands out buffers aligned to both the page size and the device's logical
+// block size, as O_DIRECT requires. Backing memory comes from 2 MiB huge
+// pages when the system has them reserved, otherwise from posix_memalign()
+// with a transparent-hugepage hint. With a NUMA node, regions are bound to
+// it before first use. Buffers live as long as the arena.
+class BufferArena {
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    explicit BufferArena(size_t blockAlign = 0, int numaNode = -1);
+    ~BufferArena();
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+
+    // Returns nullptr only if both huge pages and posix_memalign fail.
+    char* allocate(size_t size);
+
+    size_t alignment() const { return align; }
+    bool usingHugePages() const { return hugeRegions > 0; }
+
+private:
+    struct Region {
+        char*  base;
+        size_t size;
+        size_t used;
+        bool   huge;
+    };
+
+    bool addRegion(size_t minSize);
+
+    size_t align;
+    int    node;
+    size_t hugeRegions = 0;
+    std::vector<Region> regions;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef ATA_HPP
+#define ATA_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "progress.hpp"
+
+// Native ATA commands sent with ATA PASS-THROUGH(16) over SG_IO, replacing
+// hdparm for identify and the security erase feature set. Works for SATA
+// disks behind libata and most SAT-capable USB bridges and HBAs.
+
+enum class AtaProtocol {
+    NON_DATA,
+    PIO_IN,     // device to host, 512-byte blocks
+    PIO_OUT     // host to device, 512-byte blocks
+};
+
+// One taskfile. 28-bit commands only need the low halves.
+struct AtaCommand {
+    uint8_t     command = 0;
+    uint16_t    feature = 0;
+    uint16_t    count = 0;
+    uint64_t    lba = 0;
+    uint8_t     device = 0;
+    AtaProtocol protocol = AtaProtocol::NON_DATA;
+    unsigned    timeoutSeconds = 15;
+};
+
+enum class AtaErrorKind {
+    NONE,
+    OPEN,           // could not open the device
+    TRANSPORT,      // SG_IO itself failed, or the HBA/bridge rejected the CDB
+    TIMEOUT,        // command did not complete within its timeout
+    ABORTED,        // device set ERR in status; see status/error
+    NOT_SUPPORTED,  // feature missing from IDENTIFY
+    FROZEN,         // security frozen by the BIOS; needs a suspend/resume or hotplug
+    LOCKED,         // security locked with a password we do not know
+    COUNT_EXPIRED,  // too many bad passwords; needs a power cycle
+    BAD_RESPONSE    // reply could not be parsed
+};
+
+const char* ataErrorKindName(AtaErrorKind k);
+
+struct AtaError {
+    AtaErrorKind kind = AtaErrorKind::NONE;
+    uint8_t      command = 0;   // command that failed
+    uint8_t      status = 0;    // ATA status register, if returned
+    uint8_t      error = 0;     // ATA error register, if returned
+    int          sysErrno = 0;
+    std::string  message;
+
+    bool ok() const { return kind == AtaErrorKind::NONE; }
+    std::string describe() const;
+};
+
+// Carries one command to a drive. SgIoTransport is the real one; tests and
+// dry runs can substitute MockAtaDrive.
+class AtaTransport {
+public:
+    virtual ~AtaTransport() = default;
+    // `data` must hold count * 512 bytes for PIO commands.
+    virtual AtaError execute(const AtaCommand& cmd, uint8_t* data, size_t len) = 0;
+};
+
+class SgIoTransport : public AtaTransport {
+public:
+    explicit SgIoTransport(const std::string& devicePath);
+    ~SgIoTransport() override;
+    SgIoTransport(const SgIoTransport&) = delete;
+    SgIoTransport& operator=(const SgIoTransport&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    AtaError execute(const AtaCommand& cmd, uint8_t* data, size_t len) override;
+
+private:
+    int fd = -1;
+    int openErrno = 0;
+    std::string path;
+};
+
+// The parts of IDENTIFY DEVICE the wipe code uses.
+struct AtaIdentity {
+    std::string model;              // words 27-46
+    std::string serial;             // words 10-19
+    std::string firmware;           // words 23-26
+    uint64_t    sectors = 0;        // words 100-103 if 48-bit, else 60-61
+
+    // Word 128
+    bool securitySupported = false;
+    bool securityEnabled = false;
+    bool securityLocked = false;
+    bool securityFrozen = false;
+    bool securityCountExpired = false;
+    bool enhancedEraseSupported = false;
+
+    // Words 89/90 in minutes; 0 = not reported. A value at the top of the
+    // field's range means "longer than that": the minutes are then only a
+    // lower bound and the OpenEnded flag is set.
+    unsigned eraseMinutes = 0;
+    unsigned enhancedEraseMinutes = 0;
+    bool     eraseOpenEnded = false;
+    bool     enhancedEraseOpenEnded = false;
+};
+
+// Decodes a 256-word IDENTIFY DEVICE block.
+AtaIdentity parseIdentify(const std::array<uint16_t, 256>& words);
+
+AtaError ataIdentify(AtaTransport& t, AtaIdentity& out);
+
+// SECURITY SET PASSWORD for the user password.
+AtaError ataSetPassword(AtaTransport& t, const std::string& password);
+
+// SECURITY DISABLE PASSWORD, to unlock a drive left with our password.
+AtaError ataDisablePassword(AtaTransport& t, const std::string& password);
+
+// SECURITY ERASE PREPARE followed by SECURITY ERASE UNIT. The erase timeout
+// is twice the drive's own estimate, or 12 hours if it gives none.
+AtaError ataEraseUnit(AtaTransport& t, const std::string& password, bool enhanced,
+                      const AtaIdentity& id);
+
+// The full sequence: identify, refuse frozen/locked drives, set a temporary
+// password, erase (enhanced when asked for and supported), and on failure
+// try to remove the password again so the drive is not left locked.
+// `progress` advances in seconds against the drive's estimate;
+// `enhancedUsed`, when given, is set to whether the enhanced erase was run.
+AtaError ataSecurityErase(AtaTransport& t, bool preferEnhanced, WipeProgress* progress = nullptr,
+                          bool* enhancedUsed = nullptr);
+
+// Simulated drive implementing IDENTIFY and the security state machine,
+// for exercising the erase sequence without hardware. Every command is
+// logged; `failCommand` makes that opcode fail with ABORTED.
+class MockAtaDrive : public AtaTransport {
+public:
+    AtaIdentity identity;           // reported by IDENTIFY; security bits track state
+    uint8_t     failCommand = 0;
+    std::vector<uint8_t> log;       // opcodes in the order received
+    std::string password;           // current user password, "" if none
+    bool        erased = false;
+    bool        erasedEnhanced = false;
+    unsigned    eraseTimeout = 0;   // timeoutSeconds of the last ERASE UNIT
+
+    AtaError execute(const AtaCommand& cmd, uint8_t* data, size_t len) override;
+
+private:
+    bool prepared = false;
+};
+
+#endif
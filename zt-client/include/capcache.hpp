@@ -0,0 +1,41 @@
+#ifndef CAPCACHE_HPP
+#define CAPCACHE_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Results of the firmware erase probes, remembered per drive so a rescan
+// only has to talk to disks it has not seen before. Keyed by the stable
+// identity from deviceIdentity() (WWN, EUI-64/NGUID, or model + serial);
+// an entry is ignored once the drive reports a different firmware
+// revision, since an update can change what the drive supports.
+struct CachedCapabilities {
+    std::string firmware;
+    bool        firmwareErase = false;  // FIRMWARE_ERASE or ATA_SECURE_ERASE, by type
+    uint64_t    probedAt = 0;
+};
+
+// A single JSON file. load() and save() are cheap; the file is small and
+// read once per scan, and a missing or corrupt file is just an empty cache.
+class CapabilityCache {
+public:
+    explicit CapabilityCache(const std::string& file);
+
+    void load();
+    // Writes the cache back if store() changed anything.
+    bool save();
+
+    bool lookup(const std::string& identity, const std::string& firmware,
+                CachedCapabilities& out) const;
+    void store(const std::string& identity, const std::string& firmware, bool firmwareErase);
+
+    const std::string& path() const { return file; }
+
+private:
+    std::string file;
+    std::map<std::string, CachedCapabilities> entries;
+    bool dirty = false;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <string>
 #include <cstdint>
 #include <array>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include "dev.hpp"
 
@@ -13,6 +14,11 @@ enum class WipeStatus {
     FAILURE
 };
 
+struct LbaRange {
+    uint64_t first;
+    uint64_t count;
+};
+
 struct WipeResult {
     std::string device_path;
     std::string device_model;
@@ -26,6 +32,40 @@ struct WipeResult {
     uint64_t end_time;
 
     std::string tool_version;
+
+    // Why a failed wipe failed, when a single cause is known; not part of
+    // the certificate.
+    std::string failure;
+
+    // Firmware erase that ran, e.g. "nvme-sanitize-crypto-erase"; empty for
+    // overwrites. erase_status is the final sanitize log SSTAT, 0 otherwise.
+    std::string erase_action;
+    uint64_t    erase_seconds;
+    unsigned    erase_status;
+
+    // Overwrite passes, one description per pass; empty for firmware erases
+    std::string scheme;
+    std::vector<std::string> scheme_passes;
+
+    // Read-back verification; verify_mode is "none" when it did not run
+    std::string verify_mode;
+    uint64_t    verify_bytes;
+    uint64_t    verify_mismatched_blocks;
+    std::vector<LbaRange> verify_bad_lbas;  // capped, see verify_bad_lbas_truncated
+    bool        verify_bad_lbas_truncated;
+
+    // Sampled verification parameters, enough to regenerate the ranges
+    uint64_t    verify_seed;
+    unsigned    verify_regions;
+    unsigned    verify_samples_per_region;
+    uint64_t    verify_sample_bytes;
+    uint64_t    verify_edge_bytes;
+    uint64_t    verify_sample_align;
+    double      verify_coverage;    // fraction of the device actually read
+
+    // Set when the overwrite continued from a checkpoint
+    unsigned    resume_count;       // 0 = ran in one go
+    uint64_t    first_start_time;   // when the interrupted wipe began
 };
 
 struct VerificationResult {
@@ -0,0 +1,33 @@
+#ifndef CLI_HPP
+#define CLI_HPP
+
+// Headless front end for racks and scripts; nothing here touches GTK.
+//
+//   zt-client list   [--json] [--refresh]
+//   zt-client wipe   [--json] --yes [--method M] [--scheme S] [--verify none|sampled|full]
+//                    [--jobs N] [--timeout SEC] [--stall-timeout SEC] [--cert-dir DIR]
+//                    [--daemon | --socket PATH] DEVICE...
+//   zt-client verify [--json] CERTIFICATE...
+//   zt-client daemon [--socket PATH] [--scheme S] [--verify MODE] [--jobs N]
+//                    [--timeout SEC] [--stall-timeout SEC]
+//   zt-client status [--json] [--socket PATH] [JOB]
+//   zt-client cancel [--json] [--socket PATH] JOB
+//
+// `daemon` serves the wipe queue until SIGINT/SIGTERM (see daemon.hpp);
+// `wipe --daemon`, `status` and `cancel` talk to it, so wipes survive the
+// client exiting and can be cancelled from another shell.
+//
+// With --json, stdout carries only newline-delimited JSON objects, one
+// per event, each with an "event" field; everything the wipe engine logs
+// goes to stderr. Each wipe runs in its own worker process (worker.hpp);
+// --timeout and --stall-timeout say when it is killed. Exit status is 0
+// when every device or certificate succeeded, 1 when any failed and 2 for
+// usage errors.
+
+// True if `arg` names a CLI subcommand.
+bool isCliCommand(const char* arg);
+
+// argv[1] is the subcommand.
+int runCli(int argc, char* argv[]);
+
+#endif
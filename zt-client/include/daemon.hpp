@@ -0,0 +1,115 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "hotplug.hpp"
+#include "orchestrator.hpp"
+#include "qos.hpp"
+#include "wipe.hpp"
+
+// Long-running owner of the device registry and the wipe queue. Front
+// ends connect over a Unix socket, so wipes outlive any one GUI or CLI
+// session and several of them can watch the same jobs.
+//
+// Every message is one frame (see wire.hpp). Requests carry "op" and an
+// optional "id" that the reply echoes; replies carry "ok" and, on failure,
+// "error". Operations:
+//   devices                         -> "devices": [device...]
+//   submit  devices:[path], method  -> "jobs": [{device, job} | {device, error}]
+//   cancel  job                     -> ok
+//   status  [job]                   -> "jobs": [job + "progress" while running]
+//   certificate job                 -> "certificate": exact text, once DONE
+//   stream                          -> ok, then pushed frames carrying "event":
+//                                      "job" on each state change, "progress"
+//                                      every second per running job, "device"
+//                                      with "change" on hotplug
+// A streaming connection can still send requests.
+
+struct DaemonOptions {
+    std::string socketPath = "/run/zerotrace/zt.sock";
+    unsigned    maxConcurrent = 8;
+    WipeOptions wipe;
+    QosOptions  qos;
+    WorkerLimits limits;
+};
+
+class WipeDaemon {
+public:
+    explicit WipeDaemon(DaemonOptions opts);
+    ~WipeDaemon();
+    WipeDaemon(const WipeDaemon&) = delete;
+    WipeDaemon& operator=(const WipeDaemon&) = delete;
+
+    // Binds the socket and serves until stop(). False if the socket
+    // cannot be set up.
+    bool run();
+    // Async-signal-safe.
+    void stop();
+
+private:
+    // Closed when the last reference goes, so a broadcast still holding
+    // one never writes to a recycled descriptor.
+    struct Client {
+        int fd = -1;
+        bool streaming = false;
+        std::mutex writeMtx;
+        ~Client();
+    };
+
+    void serve(std::shared_ptr<Client> client);
+    nlohmann::json handle(const nlohmann::json& req, const std::shared_ptr<Client>& client);
+    nlohmann::json submit(const nlohmann::json& req);
+    nlohmann::json status(const nlohmann::json& req);
+    bool send(Client& client, const nlohmann::json& msg);
+    void broadcast(const nlohmann::json& event);
+    void progressLoop();
+
+    DaemonOptions opts;
+    DeviceRegistry registry;
+    HotplugMonitor hotplug;
+
+    int listenFd = -1;
+    int wakeFd = -1;
+
+    std::mutex clientsMtx;
+    std::condition_variable clientsCv;
+    std::set<std::shared_ptr<Client>> clients;
+
+    std::mutex stopMtx;
+    std::condition_variable stopCv;
+    bool stopping = false;
+
+    // Last: its destructor waits for running wipes, whose updates are
+    // still broadcast through the members above.
+    WipeOrchestrator orchestrator;
+};
+
+// Connection from a front end to the daemon.
+class DaemonClient {
+public:
+    DaemonClient() = default;
+    ~DaemonClient();
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+
+    bool connect(const std::string& socketPath);
+
+    // Sends `req` and waits for its reply. Events arriving meanwhile on a
+    // streaming connection are kept for next().
+    bool call(const nlohmann::json& req, nlohmann::json& reply);
+    // Next pushed event; blocks. False once the connection is gone.
+    bool next(nlohmann::json& event);
+
+private:
+    int fd = -1;
+    unsigned nextId = 1;
+    std::vector<nlohmann::json> pending;
+};
+
+#endif
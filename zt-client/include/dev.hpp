@@ -1,6 +1,7 @@
 #ifndef DEV_HPP
 #define DEV_HPP
 
+#include <chrono>
 #include <string>
 #include <vector>
 #include <cstdint>
@@ -20,11 +21,45 @@ struct Device {
     bool isRemovable;
     bool isReadOnly;
     std::string model;
+    std::string identity;   // WWN, EUI-64/NGUID or model + serial; "" if none is stable
+    std::string firmware;   // firmware revision from sysfs, "" if unknown
     std::string type; // "NVMe", "ATA", "USB", "Unknown"
+    std::string transport;  // "nvme", "sata", "sas", "usb", ..., see deviceTransport()
+    std::string busPath;    // sysfs device path, identifies the bay
+    std::string pciPath;  // PCI addresses down to the controller, "" if virtual
+    int numaNode = -1;    // controller's NUMA node, -1 if unknown
     std::vector<WipeMethod> supportedWipeMethods;
+    // Firmware erase probe did not answer in time; only the overwrite
+    // methods are listed and a rescan may find more.
+    bool capabilitiesUnknown = false;
 };
 
-std::vector<Device> getDevices();
+// Short names used in policies and on the command line:
+// "plain", "encrypted", "firmware", "ata".
+const char* wipeMethodName(WipeMethod m);
+bool parseWipeMethod(const std::string& name, WipeMethod& out);
+
+struct ScanOptions {
+    // A probe still running after this is abandoned and its device
+    // returned with capabilitiesUnknown set.
+    std::chrono::milliseconds probeTimeout = std::chrono::seconds(5);
+    // Probe results are cached per drive identity and firmware revision;
+    // refresh ignores the cache and probes every drive again.
+    bool refresh = false;
+    std::string capabilityCache = "/var/lib/zerotrace/capabilities.json";
+};
+
+// Enumerates /sys/block and probes firmware erase support on a worker
+// pool, skipping drives the capability cache already knows.
+std::vector<Device> getDevices(const ScanOptions& opts = ScanOptions());
+
+// False for loop, ram, device-mapper and optical devices, which are never
+// wipe targets.
+bool isCandidateDevice(const std::string& deviceName);
+
+// Reads and probes the single disk /sys/block/<deviceName>. False if it is
+// not a candidate or has gone away.
+bool getDevice(const std::string& deviceName, Device& out, const ScanOptions& opts = ScanOptions());
 
 void printDeviceList(const std::vector<Device>& devices);
 
@@ -1,10 +1,12 @@
 #ifndef GUI_HPP
 #define GUI_HPP
 
+#include <string>
 #include <vector>
 #include "dev.hpp"
 
-// Main entry point for the GUI
-void runGui();
+// Main entry point for the GUI. With a station policy file, newly
+// inserted drives are wiped automatically (see station.hpp).
+void runGui(const std::string& stationPolicy = "");
 
 #endif
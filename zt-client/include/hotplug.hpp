@@ -0,0 +1,105 @@
+#ifndef HOTPLUG_HPP
+#define HOTPLUG_HPP
+
+#include <functional>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dev.hpp"
+
+// Kernel uevents on NETLINK_KOBJECT_UEVENT keep an in-memory device list
+// current, so drives coming and going on a live bench never need a full
+// rescan. Only the disk an event names is read and probed.
+
+// One kernel uevent: "ACTION@DEVPATH" followed by KEY=VALUE properties.
+struct Uevent {
+    std::string action;     // add, remove, change, ...
+    std::string devpath;    // /devices/.../block/sda
+    std::map<std::string, std::string> env;
+
+    std::string get(const std::string& key) const;
+};
+
+// Parses a raw netlink datagram. False for anything that is not a kernel
+// uevent (udev's own "libudev" broadcasts included).
+bool parseUevent(const char* buf, size_t len, Uevent& out);
+
+// Reads canned uevents in the text form `udevadm monitor --kernel
+// --property` prints: KEY=VALUE lines, records separated by blank lines,
+// header lines ("KERNEL[...] add ...") ignored.
+std::vector<Uevent> readUevents(std::istream& in);
+
+enum class DeviceChange { ADDED, REMOVED, CHANGED };
+
+const char* deviceChangeName(DeviceChange c);
+
+// Reads one disk by /sys/block name; getDevice() unless a test substitutes it.
+using DeviceProber = std::function<bool(const std::string& name, Device& out)>;
+
+// The current device list, keyed by /sys/block name. Subscribers are
+// called on the thread that applied the event, outside the lock.
+class DeviceRegistry {
+public:
+    using Callback = std::function<void(DeviceChange, const Device&)>;
+
+    explicit DeviceRegistry(DeviceProber prober = nullptr);
+
+    // Replaces the contents with a full scan, without notifying anyone.
+    void reset(const std::vector<Device>& devices);
+    // Replaces the contents with a full scan and notifies the difference;
+    // used when events may have been lost.
+    void resync(const std::vector<Device>& devices);
+
+    std::vector<Device> snapshot() const;
+    bool find(const std::string& name, Device& out) const;
+
+    unsigned subscribe(Callback cb);
+    void unsubscribe(unsigned id);
+
+    // Applies one event. Whole-disk block events only; partitions and
+    // other subsystems are ignored. Returns true if the list changed.
+    bool apply(const Uevent& ev);
+
+private:
+    void notify(DeviceChange change, const Device& dev);
+
+    mutable std::mutex mtx;
+    std::map<std::string, Device> devices;
+    DeviceProber prober;
+
+    std::mutex subMtx;
+    std::map<unsigned, Callback> subscribers;
+    unsigned nextSubscriber = 1;
+};
+
+// Listens on the kernel uevent multicast group and feeds a registry from
+// a background thread.
+class HotplugMonitor {
+public:
+    explicit HotplugMonitor(DeviceRegistry& registry);
+    ~HotplugMonitor();
+    HotplugMonitor(const HotplugMonitor&) = delete;
+    HotplugMonitor& operator=(const HotplugMonitor&) = delete;
+
+    // False if the netlink socket cannot be opened; the caller then has
+    // to fall back to rescanning.
+    bool start();
+    void stop();
+    bool running() const { return worker.joinable(); }
+
+    // Feeds canned events through the same path as live ones.
+    void replay(const std::vector<Uevent>& events);
+
+private:
+    void run();
+
+    DeviceRegistry& registry;
+    int sock = -1;
+    int wakeFd = -1;
+    std::thread worker;
+};
+
+#endif
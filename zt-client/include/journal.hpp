@@ -0,0 +1,56 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "keystream.hpp"
+
+// Where one stripe had got to. `written` counts across passes,
+// pass * length + bytes into that pass, so a single value orders it.
+struct StripeCheckpoint {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t written;
+};
+
+// Everything needed to continue an overwrite where it stopped. Only bytes
+// that had been fsync'd when the checkpoint was saved are counted.
+struct WipeCheckpoint {
+    std::string deviceId;
+    int         method = 0;
+    std::string scheme;             // WipeScheme name, see pattern.hpp
+    uint64_t    size = 0;
+    unsigned    passes = 0;
+    std::vector<StripeCheckpoint> stripes;
+
+    // Keystream for the scheme's random passes. Resuming needs the same key, and
+    // keeping it is harmless: it decides the filler, not the user data.
+    bool         hasKey = false;
+    KeystreamKey key{};
+
+    unsigned resumeCount = 0;
+    uint64_t startTime = 0;
+};
+
+// One JSON file per device identity in a root-only directory. save() is
+// durable: it writes a temporary file, fsyncs it, renames it over the old
+// checkpoint and fsyncs the directory, so a crash leaves either the old
+// or the new checkpoint, never a torn one.
+class CheckpointJournal {
+public:
+    CheckpointJournal(const std::string& dir, const std::string& deviceId);
+
+    // False if there is no checkpoint or it cannot be parsed.
+    bool load(WipeCheckpoint& out) const;
+    bool save(const WipeCheckpoint& cp);
+    void remove();
+
+    const std::string& path() const { return file; }
+
+private:
+    std::string dir;
+    std::string file;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef KEYSTREAM_HPP
+#define KEYSTREAM_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "arena.hpp"
+#include "overwrite.hpp"
+#include "verify.hpp"
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+enum class KeystreamCipher {
+    AES_128_CTR,
+    CHACHA20
+};
+
+// Ephemeral per-wipe key material. The stream for a given pass is fully
+// determined by (cipher, key, iv, pass), so any byte of it can be
+// regenerated later without storing what was written.
+struct KeystreamKey {
+    KeystreamCipher         cipher;
+    std::array<uint8_t, 32> key;    // AES-128 uses the first 16 bytes
+    std::array<uint8_t, 16> iv;
+};
+
+// AES-128-CTR when the CPU has AES instructions, ChaCha20 otherwise.
+KeystreamCipher preferredCipher();
+const char* cipherName(KeystreamCipher c);
+
+// Fresh key and IV from the OpenSSL CSPRNG.
+bool newEphemeralKey(KeystreamCipher cipher, KeystreamKey& out);
+
+// Seekable keystream: generate() can start at any byte offset because
+// both ciphers are counter-mode. Not thread-safe; use one per thread.
+class KeystreamGenerator {
+public:
+    KeystreamGenerator(const KeystreamKey& key, unsigned pass);
+    ~KeystreamGenerator();
+    KeystreamGenerator(const KeystreamGenerator&) = delete;
+    KeystreamGenerator& operator=(const KeystreamGenerator&) = delete;
+
+    bool generate(uint64_t offset, char* out, size_t len);
+
+private:
+    bool seek(uint64_t offset, size_t& skip);
+
+    KeystreamKey key;
+    EVP_CIPHER_CTX* ctx;
+};
+
+// Verifies read-back data against the keystream regenerated at the same
+// offset, so nothing written needs to be kept.
+class KeystreamChecker : public BlockChecker {
+public:
+    KeystreamChecker(const KeystreamKey& key, unsigned pass, size_t blockSize);
+    bool check(uint64_t offset, const char* data, size_t len) override;
+
+private:
+    KeystreamGenerator gen;
+    std::vector<char> expected;
+};
+
+// ChunkSource that keeps a ring of arena buffers filled ahead of the writer
+// by a pool of generator threads. Buffers are handed to the engine in offset
+// order and recycled as soon as their write completes.
+class KeystreamSource : public ChunkSource {
+public:
+    KeystreamSource(const KeystreamKey& key, std::vector<char*> bufs,
+                    size_t blockSize, unsigned threads);
+    ~KeystreamSource() override;
+
+    std::vector<iovec> buffers() override;
+    size_t maxInFlight() const override;
+    bool healthy() const override;
+    void begin(unsigned pass, uint64_t offset, uint64_t length) override;
+    WriteChunk acquire(uint64_t offset, size_t len) override;
+    void release(const WriteChunk& chunk) override;
+
+private:
+    enum class SlotState { FREE, GENERATING, READY, IN_USE };
+
+    struct Slot {
+        char*     buf;
+        SlotState state;
+        uint64_t  seq;
+    };
+
+    void generatorLoop();
+
+    KeystreamKey key;
+    size_t blockSize;
+    std::vector<Slot> slots;
+    std::vector<std::thread> generators;
+    unsigned threadCount;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+    bool active = false;
+    unsigned epoch = 0;         // bumped by begin(); stale work is discarded
+    unsigned pass = 0;
+    uint64_t rangeStart = 0;
+    uint64_t rangeLength = 0;
+    uint64_t nextGen = 0;       // next block sequence number to generate
+    unsigned generating = 0;
+    std::atomic<bool> failed{false};
+};
+
+// Factory helper: allocates `slots` block buffers from the arena.
+std::unique_ptr<ChunkSource> makeKeystreamSource(BufferArena& arena, size_t blockSize,
+                                                 const KeystreamKey& key,
+                                                 unsigned slots, unsigned threads);
+
+#endif
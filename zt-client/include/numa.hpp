@@ -0,0 +1,45 @@
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <sched.h>
+#include <cstddef>
+#include <string>
+
+// PCI addresses from the root port down to the function the disk sits
+// behind, e.g. "0000:00:01.1/0000:02:00.0"; "" for virtual devices.
+std::string devicePciPath(const std::string& devName);
+
+// NUMA node of the controller behind devName as sysfs reports it, -1 if
+// unknown or the platform has no NUMA information.
+int deviceNumaNode(const std::string& devName);
+
+// Number of online NUMA nodes, at least 1.
+unsigned numaNodeCount();
+
+// Node to place a wipe of devicePath on: its controller's node on a
+// multi-node system, -1 (no placement) otherwise.
+int placementNode(const std::string& devicePath);
+
+// Asks the kernel to back [addr, addr + len) with memory from `node`,
+// migrating pages already touched. Preferred rather than strict, so a full
+// node spills over instead of failing the allocation.
+bool bindMemoryToNode(void* addr, size_t len, int node);
+
+// Restricts the calling thread to the CPUs of `node` until destruction,
+// then restores its previous mask. Threads started meanwhile inherit the
+// restriction. Does nothing for node -1.
+class NodeAffinity {
+public:
+    explicit NodeAffinity(int node);
+    ~NodeAffinity();
+    NodeAffinity(const NodeAffinity&) = delete;
+    NodeAffinity& operator=(const NodeAffinity&) = delete;
+
+    bool pinned() const { return active; }
+
+private:
+    cpu_set_t saved;
+    bool active = false;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef NVME_HPP
+#define NVME_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "progress.hpp"
+
+// Native NVMe admin commands through NVME_IOCTL_ADMIN_CMD, replacing
+// nvme-cli for identify, sanitize, format and the sanitize status log.
+
+struct NvmeAdminCommand {
+    uint8_t  opcode = 0;
+    uint32_t nsid = 0;
+    uint32_t cdw10 = 0, cdw11 = 0, cdw12 = 0, cdw13 = 0, cdw14 = 0, cdw15 = 0;
+    void*    data = nullptr;        // controller-to-host unless `write`
+    uint32_t dataLen = 0;
+    bool     write = false;
+    unsigned timeoutSeconds = 30;
+};
+
+enum class NvmeErrorKind {
+    NONE,
+    OPEN,           // could not open the device
+    IOCTL,          // the ioctl itself failed (not NVMe, permission, ...)
+    STATUS,         // controller completed the command with an error status
+    NOT_SUPPORTED,  // capability missing from Identify
+    TIMEOUT,        // sanitize did not finish within the allowed time
+    FAILED          // sanitize log reports the operation failed
+};
+
+const char* nvmeErrorKindName(NvmeErrorKind k);
+
+struct NvmeError {
+    NvmeErrorKind kind = NvmeErrorKind::NONE;
+    uint8_t       opcode = 0;
+    uint16_t      status = 0;       // status code type << 8 | status code
+    int           sysErrno = 0;
+    std::string   message;
+
+    bool ok() const { return kind == NvmeErrorKind::NONE; }
+    std::string describe() const;
+};
+
+// Carries one admin command. IoctlNvmeTransport is the real one; tests
+// and dry runs can substitute MockNvmeController.
+class NvmeTransport {
+public:
+    virtual ~NvmeTransport() = default;
+    // Namespace the device node refers to; 0 for a controller node.
+    virtual uint32_t namespaceId() const = 0;
+    virtual NvmeError admin(const NvmeAdminCommand& cmd, uint32_t* result = nullptr) = 0;
+};
+
+class IoctlNvmeTransport : public NvmeTransport {
+public:
+    explicit IoctlNvmeTransport(const std::string& devicePath);
+    ~IoctlNvmeTransport() override;
+    IoctlNvmeTransport(const IoctlNvmeTransport&) = delete;
+    IoctlNvmeTransport& operator=(const IoctlNvmeTransport&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    uint32_t namespaceId() const override { return nsid; }
+    NvmeError admin(const NvmeAdminCommand& cmd, uint32_t* result = nullptr) override;
+
+private:
+    int fd = -1;
+    int openErrno = 0;
+    uint32_t nsid = 0;
+    std::string path;
+};
+
+// The parts of Identify Controller (CNS 01h) the wipe code uses.
+struct NvmeController {
+    std::string model;              // MN, bytes 24-63
+    std::string serial;             // SN, bytes 4-23
+    std::string firmware;           // FR, bytes 64-71
+    bool formatSupported = false;   // OACS bit 1
+    bool formatAllNamespaces = false;   // FNA bit 0: format/erase hits every namespace
+    bool formatCryptoErase = false;     // FNA bit 2: SES=2 supported
+    bool sanitizeCrypto = false;    // SANICAP bit 0
+    bool sanitizeBlock = false;     // SANICAP bit 1
+    bool sanitizeOverwrite = false; // SANICAP bit 2
+
+    bool sanitizeAny() const { return sanitizeCrypto || sanitizeBlock || sanitizeOverwrite; }
+};
+
+// Identify Namespace (CNS 00h).
+struct NvmeNamespace {
+    uint64_t blocks = 0;            // NSZE
+    uint32_t blockSize = 0;         // from the LBA format FLBAS selects
+    uint8_t  formatIndex = 0;       // FLBAS bits 3:0
+};
+
+// Sanitize Status log page (81h).
+struct SanitizeStatus {
+    uint16_t progress = 0;          // SPROG, fraction of 65536
+    uint8_t  state = 0;             // SSTAT bits 2:0, see SANITIZE_* below
+    unsigned overwritePasses = 0;   // SSTAT bits 7:3
+    bool     globalDataErased = false;  // SSTAT bit 8
+    uint32_t cdw10 = 0;             // SCDW10 of the last sanitize
+    uint32_t estOverwrite = 0;      // ETO, seconds; 0xffffffff = no estimate
+    uint32_t estBlockErase = 0;     // ETBE
+    uint32_t estCryptoErase = 0;    // ETCE
+};
+
+constexpr uint8_t SANITIZE_NEVER = 0;
+constexpr uint8_t SANITIZE_COMPLETED = 1;
+constexpr uint8_t SANITIZE_IN_PROGRESS = 2;
+constexpr uint8_t SANITIZE_FAILED = 3;
+constexpr uint8_t SANITIZE_COMPLETED_NO_DEALLOC = 4;
+
+enum class SanitizeAction : uint8_t {
+    BLOCK_ERASE = 2,
+    OVERWRITE = 3,
+    CRYPTO_ERASE = 4
+};
+
+const char* sanitizeActionName(SanitizeAction a);
+
+NvmeError nvmeIdentifyController(NvmeTransport& t, NvmeController& out);
+NvmeError nvmeIdentifyNamespace(NvmeTransport& t, uint32_t nsid, NvmeNamespace& out);
+NvmeError nvmeSanitizeStatus(NvmeTransport& t, SanitizeStatus& out);
+
+// Get Log Page into `buf` (a multiple of 4 bytes).
+NvmeError nvmeGetLogPage(NvmeTransport& t, uint8_t logId, uint32_t nsid,
+                         void* buf, uint32_t len);
+
+// Starts a sanitize; it runs in the background after the command returns.
+// OVERWRITE writes `pattern` once.
+NvmeError nvmeStartSanitize(NvmeTransport& t, SanitizeAction action, uint32_t pattern = 0);
+
+// Format NVM with Secure Erase Settings `ses` (1 = user data erase,
+// 2 = cryptographic erase), keeping LBA format `formatIndex`. Synchronous.
+NvmeError nvmeFormat(NvmeTransport& t, uint32_t nsid, uint8_t ses, uint8_t formatIndex);
+
+// Polls the sanitize log every `interval` until the sanitize started with
+// `action` leaves the in-progress state, publishing SPROG to `progress`
+// (out of 65536). An end state whose SCDW10 names another action is left
+// over from an earlier sanitize and is waited out like "never started".
+// `final` holds the last log read. Gives up after `timeout`.
+NvmeError waitForSanitize(NvmeTransport& t, SanitizeAction action, WipeProgress* progress,
+                          SanitizeStatus& final,
+                          std::chrono::milliseconds interval = std::chrono::seconds(2),
+                          std::chrono::seconds timeout = std::chrono::hours(24));
+
+// Simulated controller for exercising the admin layer without hardware.
+// A started sanitize advances by `progressStep` SPROG units each time the
+// status log is read. Every opcode is logged; `failOpcode` completes that
+// opcode with `failStatus`.
+class MockNvmeController : public NvmeTransport {
+public:
+    NvmeController identity;
+    NvmeNamespace  ns;
+    uint32_t       nsid = 1;
+    uint16_t       progressStep = 16384;
+    uint8_t        failOpcode = 0;
+    uint16_t       failStatus = 0x0002;     // Invalid Field in Command
+    bool           failSanitize = false;    // sanitize ends in SANITIZE_FAILED
+
+    std::vector<uint8_t> log;
+    SanitizeStatus status;
+    bool           formatted = false;
+    uint8_t        formatSes = 0;
+    uint8_t        formatIndex = 0;         // LBAF the format asked for
+    uint32_t       formatNsid = 0;
+
+    uint32_t namespaceId() const override { return nsid; }
+    NvmeError admin(const NvmeAdminCommand& cmd, uint32_t* result = nullptr) override;
+};
+
+#endif
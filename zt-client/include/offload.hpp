@@ -0,0 +1,37 @@
+#ifndef OFFLOAD_HPP
+#define OFFLOAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "overwrite.hpp"
+
+// Block-layer limits from /sys/block/<dev>/queue; 0 means unsupported.
+struct OffloadLimits {
+    uint64_t writeZeroesMax = 0;     // write_zeroes_max_bytes
+    uint64_t discardMax = 0;         // discard_max_bytes
+    uint64_t discardGranularity = 0; // discard_granularity
+};
+
+OffloadLimits queryOffloadLimits(const std::string& devName);
+
+enum class OffloadOp {
+    ZEROOUT,         // BLKZEROOUT: device writes zeros, nothing is unmapped
+    SECURE_DISCARD   // BLKSECDISCARD: unmap and erase the backing media
+};
+
+const char* offloadOpName(OffloadOp op);
+
+// Issues `op` over [offset, offset + length) in chunks of at most chunkBytes
+// and calls onChunk with each chunk's length once it is done.
+//
+// For ZEROOUT a chunk the kernel rejects is overwritten from `fallback`
+// through syncWriteRange() instead; after EOPNOTSUPP or ENOTTY the rest of the range
+// goes straight to the fallback. SECURE_DISCARD has no fallback and stops
+// at the first error. Returns false if any part of the range was not done.
+bool offloadRange(int fd, OffloadOp op, uint64_t offset, uint64_t length,
+                  uint64_t chunkBytes, ChunkSource* fallback, size_t blockSize,
+                  const std::function<void(uint64_t)>& onChunk);
+
+#endif
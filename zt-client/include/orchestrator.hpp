@@ -0,0 +1,106 @@
+#ifndef ORCHESTRATOR_HPP
+#define ORCHESTRATOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dev.hpp"
+#include "cert.hpp"
+#include "wipe.hpp"
+#include "progress.hpp"
+#include "qos.hpp"
+#include "worker.hpp"
+
+enum class JobState {
+    QUEUED,
+    RUNNING,
+    VERIFYING,
+    CERTIFYING,
+    DONE,
+    FAILED
+};
+
+const char* jobStateName(JobState s);
+
+struct WipeJob {
+    unsigned    id;
+    Device      device;
+    WipeMethod  method;
+    JobState    state;
+    WipeResult  result;         // valid from CERTIFYING on
+    std::string certificate;    // JSON, empty until CERTIFYING completes
+    bool        certRecorded;
+    std::string error;
+};
+
+// Runs wipes for a batch of devices concurrently on a bounded pool of
+// worker threads. Every state change is logged and passed to the update
+// callback from the worker thread that made it. With a QosMode other than
+// OFF, running wipes share one BandwidthController. Unless limits.isolate
+// is off, each wipe runs in its own WipeWorker process, which is killed
+// when it stalls, times out or ignores a cancel.
+class WipeOrchestrator {
+public:
+    using JobCallback = std::function<void(const WipeJob&)>;
+
+    explicit WipeOrchestrator(unsigned maxConcurrent = 8, WipeOptions opts = {},
+                              QosOptions qos = {}, WorkerLimits limits = {});
+    // Drops queued jobs and waits for running ones to finish.
+    ~WipeOrchestrator();
+    WipeOrchestrator(const WipeOrchestrator&) = delete;
+    WipeOrchestrator& operator=(const WipeOrchestrator&) = delete;
+
+    void onJobUpdate(JobCallback cb);
+
+    // Returns the new job id, or 0 if the device already has an active job.
+    unsigned submit(const Device& dev, WipeMethod method);
+    std::vector<unsigned> submit(const std::vector<Device>& devices, WipeMethod method);
+
+    std::vector<WipeJob> jobs() const;
+    bool job(unsigned id, WipeJob& out) const;
+
+    // Live counters for a job; never blocks the wipe, safe to poll.
+    bool progress(unsigned id, ProgressSnapshot& out) const;
+
+    // A queued job fails at once; a running overwrite stops at its next
+    // segment and keeps its checkpoint. False if the job is unknown or
+    // already finished. A firmware erase in progress runs to completion,
+    // unless its worker is killed after limits.cancelGraceSeconds.
+    bool cancel(unsigned id);
+
+    // Blocks until nothing is queued or running.
+    void waitIdle();
+
+private:
+    void workerLoop();
+    void runJob(unsigned id);
+    void setState(unsigned id, JobState s, const std::string& error = "");
+    void notify(unsigned id);
+
+    WipeOptions opts;
+    WorkerLimits limits;
+    std::unique_ptr<BandwidthController> bandwidth;
+    JobCallback callback;
+
+    mutable std::mutex mtx;
+    std::condition_variable workCv;
+    std::condition_variable idleCv;
+    std::deque<unsigned> queue;
+    std::map<unsigned, WipeJob> jobsById;
+    std::map<unsigned, std::unique_ptr<WipeProgress>> progressById; // never erased
+    std::map<unsigned, std::unique_ptr<std::atomic<bool>>> cancelById; // never erased
+    std::map<unsigned, std::shared_ptr<WipeWorker>> workerById;        // while running
+    std::vector<std::thread> workers;
+    unsigned nextId = 1;
+    unsigned active = 0;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef OVERWRITE_HPP
+#define OVERWRITE_HPP
+
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "arena.hpp"
+#include "progress.hpp"
+
+// A buffer handed to an overwrite engine for one write request.
+// bufIndex is the position of the backing buffer in ChunkSource::buffers(),
+// so engines that register buffers with the kernel can address it directly.
+struct WriteChunk {
+    const char* data;
+    size_t      len;
+    int         bufIndex;
+};
+
+// Supplies the bytes written at a given device offset. Engines acquire
+// chunks in increasing offset order and release them (possibly out of
+// order) once the write has completed.
+class ChunkSource {
+public:
+    virtual ~ChunkSource() = default;
+
+    // Every buffer acquire() can return, for registration with io_uring.
+    virtual std::vector<iovec> buffers() = 0;
+
+    // Upper bound on chunks held at once; engines clamp their queue depth.
+    virtual size_t maxInFlight() const { return SIZE_MAX; }
+
+    // Called before each pass over [offset, offset + length), so sources
+    // that generate data can start working ahead.
+    virtual void begin(unsigned pass, uint64_t offset, uint64_t length) {
+        (void)pass; (void)offset; (void)length;
+    }
+
+    virtual WriteChunk acquire(uint64_t offset, size_t len) = 0;
+    virtual void release(const WriteChunk& chunk) { (void)chunk; }
+
+    // False if any data handed out so far was not what the source promises.
+    virtual bool healthy() const { return true; }
+};
+
+// Builds the source for one writer, drawing blockSize buffers from `arena` so
+// they satisfy O_DIRECT alignment. Returns nullptr if allocation fails.
+using SourceFactory = std::function<std::unique_ptr<ChunkSource>(BufferArena& arena, size_t blockSize)>;
+
+// A single shared zero-filled buffer; every chunk points into it.
+class ZeroSource : public ChunkSource {
+public:
+    ZeroSource(char* buf, size_t size);
+
+    std::vector<iovec> buffers() override;
+    WriteChunk acquire(uint64_t offset, size_t len) override;
+
+private:
+    char*  buf;
+    size_t size;
+};
+
+// Blocking pwrite() loop over [offset, offset + length), one request at a time.
+// Completed bytes are added to `progress` if given.
+bool syncWriteRange(int fd, uint64_t offset, uint64_t length,
+                    ChunkSource& src, size_t blockSize,
+                    WipeProgress* progress = nullptr);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef PATTERN_HPP
+#define PATTERN_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "keystream.hpp"
+#include "overwrite.hpp"
+#include "verify.hpp"
+
+// What one overwrite pass writes. CONSTANT repeats a 1, 2, 4 or 8 byte
+// unit, phase-locked to the device offset; RANDOM is the keystream for
+// this pass number (see keystream.hpp).
+struct PassPattern {
+    enum Kind { CONSTANT, RANDOM } kind = CONSTANT;
+    std::array<uint8_t, 8> unit{};
+    size_t width = 1;
+
+    bool isZero() const;
+    std::string describe() const;   // "0x00", "0xaa55", "random"
+};
+
+// A named sequence of passes. verifyLastPass schemes read the device back
+// after the final pass even if the caller did not ask for verification.
+struct WipeScheme {
+    std::string name;
+    std::vector<PassPattern> passes;
+    bool verifyLastPass = false;
+
+    bool hasRandom() const;
+    bool allZero() const;
+};
+
+// Built-in schemes:
+//   zero        3 x 0x00                       (PLAIN_OVERWRITE default)
+//   random      3 x random                     (ENCRYPTED_OVERWRITE default)
+//   nist-clear  1 x 0x00, verify               NIST SP 800-88 Clear
+//   dod-3pass   0x00, complement, random, verify   DoD 5220.22-M
+// Anything else is read as a comma-separated pass list of hex units
+// ("0x55", "0xaa55"), "random", or "~" for the complement of the previous
+// constant pass, with an optional trailing ",verify":
+//   "0x55,~,random,verify"
+// Returns false with a message in `error` if the spec cannot be parsed.
+bool parseScheme(const std::string& spec, WipeScheme& out, std::string& error);
+
+std::vector<std::string> builtinSchemeNames();
+
+// Fills dst with `pattern` as it appears at device offset `offset`.
+// Dispatches to a kernel specialised for the unit width.
+void fillPattern(char* dst, size_t len, uint64_t offset, const PassPattern& pattern);
+
+// Read-back check for a CONSTANT pass.
+class PatternChecker : public BlockChecker {
+public:
+    PatternChecker(const PassPattern& pattern, size_t blockSize);
+    bool check(uint64_t offset, const char* data, size_t len) override;
+
+private:
+    PassPattern pattern;
+    std::vector<char> expected;     // one block of the pattern at phase 0
+};
+
+// Writes a whole scheme from one source: CONSTANT passes come from a single
+// buffer refilled at the start of the pass, RANDOM passes from a
+// KeystreamSource, which is only created if the scheme needs it.
+class SchemeSource : public ChunkSource {
+public:
+    SchemeSource(const WipeScheme& scheme, char* patternBuf, size_t blockSize,
+                 std::unique_ptr<KeystreamSource> random);
+
+    std::vector<iovec> buffers() override;
+    size_t maxInFlight() const override;
+    bool healthy() const override;
+    void begin(unsigned pass, uint64_t offset, uint64_t length) override;
+    WriteChunk acquire(uint64_t offset, size_t len) override;
+    void release(const WriteChunk& chunk) override;
+
+private:
+    const WipeScheme& scheme;
+    char*  patternBuf;
+    size_t blockSize;
+    std::unique_ptr<KeystreamSource> random;
+    bool   randomPass = false;
+};
+
+// Factory helper: `key` is only used if the scheme has RANDOM passes.
+std::unique_ptr<ChunkSource> makeSchemeSource(BufferArena& arena, size_t blockSize,
+                                              const WipeScheme& scheme,
+                                              const KeystreamKey& key,
+                                              unsigned slots, unsigned threads);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef PLANNER_HPP
+#define PLANNER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// What the block layer says about a device, from BLKSSZGET/BLKPBSZGET and
+// /sys/block/<dev>/queue. Fields the kernel does not report are 0.
+struct QueueLimits {
+    uint32_t logicalBlock = 512;
+    uint32_t physicalBlock = 512;
+    uint64_t minimumIo = 0;      // minimum_io_size
+    uint64_t optimalIo = 0;      // optimal_io_size, e.g. a RAID stripe width
+    uint64_t maxRequest = 0;     // max_sectors_kb in bytes; larger writes are split
+    uint32_t dmaAlignment = 511; // mask, buffers must be aligned to it + 1
+    unsigned nrRequests = 0;
+    unsigned hwQueues = 1;
+    bool     rotational = false;
+    bool     removable = false;
+};
+
+QueueLimits readQueueLimits(int fd, const std::string& devName);
+
+// The planner's choice for one device, with the reasons it made it.
+struct IoPlan {
+    size_t   requestSize = 1024 * 1024; // bytes per write, multiple of alignment
+    size_t   alignment = 4096;          // for buffers, offsets and stripe edges
+    unsigned queueDepth = 32;           // writes in flight per stripe
+    bool     calibrated = false;
+    std::string reason;
+    QueueLimits limits;
+};
+
+// Picks a plan from the limits alone. requestSize/queueDepth of 0 mean
+// "decide"; anything else is an override that only gets aligned.
+IoPlan planIo(const QueueLimits& limits, size_t requestSize = 0, unsigned queueDepth = 0);
+
+// Times sequential O_DIRECT writes of zeros at the start of `fd` for each
+// candidate request size and keeps the smallest one within 5% of the best,
+// the knee beyond which bigger requests stop paying. Writes up to
+// ~budgetBytes per candidate, so only call it on a disk about to be wiped.
+// Leaves the plan untouched if every candidate fails.
+void calibrateIo(int fd, uint64_t deviceSize, IoPlan& plan,
+                 uint64_t budgetBytes = 64ull * 1024 * 1024);
+
+// One line for logs, e.g. "request 1 MiB, align 4 KiB, qd 32 (...)".
+std::string describePlan(const IoPlan& plan);
+
+#endif
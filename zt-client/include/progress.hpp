@@ -0,0 +1,83 @@
+#ifndef PROGRESS_HPP
+#define PROGRESS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+enum class WipePhase {
+    IDLE,
+    WRITING,    // host or offloaded overwrite passes
+    ERASING,    // drive firmware is erasing; bytes are firmware progress units
+    FLUSHING,   // fsync between passes
+    VERIFYING,
+    DONE,
+    FAILED
+};
+
+const char* wipePhaseName(WipePhase p);
+
+// A consistent-enough copy of WipeProgress for display. Rates are in bytes
+// per second; etaSeconds is negative while the rate is still unknown.
+struct ProgressSnapshot {
+    WipePhase phase;
+    unsigned  pass;             // 1-based, 0 before the first pass
+    unsigned  passes;
+    uint64_t  bytesDone;        // this phase, across all passes
+    uint64_t  bytesTotal;       // 0 if unknown
+    double    elapsedSeconds;   // since the phase started
+    double    averageRate;
+    double    currentRate;      // recent window; decays towards 0 on a stall
+    double    etaSeconds;
+    double    idleSeconds;      // since the last byte was reported
+
+    double fraction() const { return bytesTotal ? (double)bytesDone / bytesTotal : 0; }
+};
+
+// Live counters published by the wipe engine. Any number of I/O threads
+// may add() concurrently; readers call snapshot() from any thread. Nothing
+// here takes a lock: producers do a relaxed fetch_add and, at most every
+// RATE_WINDOW_MS, one of them wins a CAS and folds the last window into
+// the smoothed rate.
+class WipeProgress {
+public:
+    static constexpr int64_t RATE_WINDOW_MS = 500;
+
+    // Resets the counters for a new phase of `total` bytes (0 if unknown).
+    // `alreadyDone` counts towards the total but not towards any rate, for
+    // work finished before a resume.
+    void start(WipePhase phase, uint64_t total, unsigned passes = 1,
+               uint64_t alreadyDone = 0);
+    void setPhase(WipePhase phase);
+    void setPass(unsigned pass);
+
+    void add(uint64_t bytes);
+    // For producers that only know an absolute position, e.g. sanitize progress.
+    void set(uint64_t bytes);
+
+    ProgressSnapshot snapshot() const;
+
+    // Called from the producer thread on every phase change. Set it before
+    // the wipe starts; it is not synchronised against setPhase().
+    void onPhaseChange(std::function<void(WipePhase)> cb) { phaseCb = std::move(cb); }
+
+private:
+    void tick(uint64_t now, uint64_t done);
+
+    std::atomic<int>      phase{ (int)WipePhase::IDLE };
+    std::atomic<unsigned> pass{0};
+    std::atomic<unsigned> passes{1};
+    std::atomic<uint64_t> done{0};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> baseline{0};
+
+    std::atomic<uint64_t> startNs{0};
+    std::atomic<uint64_t> lastByteNs{0};
+    std::atomic<uint64_t> windowNs{0};      // start of the open rate window
+    std::atomic<uint64_t> windowBytes{0};   // `done` when it opened
+    std::atomic<double>   rate{0};          // smoothed bytes/s, 0 = unknown
+
+    std::function<void(WipePhase)> phaseCb;
+};
+
+#endif
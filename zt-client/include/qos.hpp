@@ -0,0 +1,175 @@
+#ifndef QOS_HPP
+#define QOS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "overwrite.hpp"
+
+// How a global bandwidth limit is divided between the devices being wiped.
+enum class QosMode {
+    OFF,            // no throttling at all
+    FAIR_SHARE,     // equal shares
+    WEIGHTED        // shares proportional to weight; default weight is the
+                    // bytes a device still has to write, so a batch of mixed
+                    // sizes finishes together
+};
+
+struct QosOptions {
+    QosMode  mode = QosMode::OFF;
+    uint64_t globalLimit = 0;   // bytes/s across all devices; 0 = unlimited
+    uint64_t deviceLimit = 0;   // bytes/s per device; 0 = unlimited
+    bool     useCgroup = false; // enforce through cgroup v2 io.max where possible
+};
+
+// Classic token bucket that may go into debt: consume() always takes the
+// bytes and then sleeps until the bucket is back at zero. That keeps the
+// average rate exact for requests larger than the burst.
+class TokenBucket {
+public:
+    explicit TokenBucket(uint64_t rate = 0);
+
+    // 0 = unlimited.
+    void setRate(uint64_t rate);
+    uint64_t rate() const;
+
+    // True if it had to sleep.
+    bool consume(uint64_t bytes);
+
+private:
+    void refill(std::chrono::steady_clock::time_point now);
+
+    mutable std::mutex mtx;
+    uint64_t bytesPerSec;
+    double   tokens = 0;
+    double   burst = 0;
+    std::chrono::steady_clock::time_point last;
+};
+
+// What writers charge their bytes to before each write; may sleep.
+class WriteThrottle {
+public:
+    virtual ~WriteThrottle() = default;
+    virtual void consume(uint64_t bytes) = 0;
+};
+
+class BandwidthController;
+
+// One device's share of a BandwidthController for the length of a wipe.
+// Writers call consume() before each write; detaches on destruction.
+class DeviceThrottle : public WriteThrottle {
+public:
+    ~DeviceThrottle();
+    DeviceThrottle(const DeviceThrottle&) = delete;
+    DeviceThrottle& operator=(const DeviceThrottle&) = delete;
+
+    void consume(uint64_t bytes) override;
+
+    // For a wipe that paces itself in another process: records `bytes` it
+    // wrote and whether it had to wait, without sleeping here. Returns the
+    // rate it should pace at, 0 for unlimited or when io.max enforces it.
+    uint64_t account(uint64_t bytes, bool waited);
+
+    const std::string& device() const { return path; }
+    uint64_t rate() const { return allocated; }
+
+private:
+    friend class BandwidthController;
+    DeviceThrottle(BandwidthController& owner, const std::string& devicePath,
+                   uint64_t remaining, double weight);
+
+    BandwidthController& owner;
+    std::string path;
+    double      weight;         // 0 = use `remaining`
+    std::string devno;          // "MAJ:MIN" of the whole disk, for io.max
+    bool        viaCgroup = false;
+
+    TokenBucket bucket;
+    std::atomic<uint64_t> consumed{0};
+    std::atomic<uint64_t> remaining;        // bytes still to write
+    std::atomic<bool>     throttled{false}; // a writer waited since the last rebalance
+    std::atomic<uint64_t> allocated{0};     // bytes/s, 0 = unlimited
+
+    // Rebalancer state, only touched under the controller's lock.
+    uint64_t lastConsumed = 0;
+    double   demand = 0;                    // 0 = not device-bound
+};
+
+// Divides opts.globalLimit between the attached devices and re-divides it
+// twice a second. A device that cannot use its share (a slow drive, or one
+// behind a saturated link) is capped at what it actually managed and the
+// rest goes to the others, so no bandwidth is left idle while any device
+// still wants it. Limits are applied with a token bucket per device, or
+// with cgroup v2 io.max on the process's own cgroup when asked for and
+// writable.
+class BandwidthController {
+public:
+    explicit BandwidthController(const QosOptions& opts);
+    ~BandwidthController();
+    BandwidthController(const BandwidthController&) = delete;
+    BandwidthController& operator=(const BandwidthController&) = delete;
+
+    // `remaining` is the bytes the wipe still has to write. `weight` only
+    // matters in WEIGHTED mode; 0 = use `remaining`.
+    std::unique_ptr<DeviceThrottle> attach(const std::string& devicePath, uint64_t remaining,
+                                           double weight = 0);
+
+    const QosOptions& options() const { return opts; }
+
+private:
+    friend class DeviceThrottle;
+    void detach(DeviceThrottle* t);
+    void rebalanceLoop();
+    void rebalance(double intervalSeconds);
+    void apply(DeviceThrottle& t, uint64_t rate);
+
+    QosOptions opts;
+    std::string cgroupDir;      // "" when io.max cannot be used
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<DeviceThrottle*> devices;
+    bool stopping = false;
+    std::thread rebalancer;
+};
+
+// Charges every chunk handed out by `inner` to `throttle`.
+class ThrottledSource : public ChunkSource {
+public:
+    ThrottledSource(std::unique_ptr<ChunkSource> inner, WriteThrottle& throttle)
+        : inner(std::move(inner)), throttle(throttle) {}
+
+    std::vector<iovec> buffers() override { return inner->buffers(); }
+    size_t maxInFlight() const override { return inner->maxInFlight(); }
+    void begin(unsigned pass, uint64_t offset, uint64_t length) override {
+        inner->begin(pass, offset, length);
+    }
+    WriteChunk acquire(uint64_t offset, size_t len) override {
+        throttle.consume(len);
+        return inner->acquire(offset, len);
+    }
+    void release(const WriteChunk& chunk) override { inner->release(chunk); }
+    bool healthy() const override { return inner->healthy(); }
+
+private:
+    std::unique_ptr<ChunkSource> inner;
+    WriteThrottle& throttle;
+};
+
+// cgroup v2 directory of this process if it has a writable io.max, else "".
+std::string ownIoCgroup();
+
+// "MAJ:MIN" of the disk holding devicePath (the whole disk for a partition,
+// which is what io.max takes), or "" if sysfs does not know it.
+std::string diskDevNumber(const std::string& devicePath);
+
+// Writes "MAJ:MIN wbps=<rate>" (or wbps=max for 0) to <cgroupDir>/io.max.
+bool setIoMax(const std::string& cgroupDir, const std::string& devno, uint64_t wbps);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Index of the first byte in data[0, len) that is not `value`, or len if
+// every byte matches. Dispatches once at runtime to the widest kernel the
+// CPU supports (AVX-512BW, AVX2, NEON), falling back to a scalar loop.
+size_t findMismatch(const char* data, size_t len, uint8_t value);
+
+// Name of the kernel findMismatch() dispatched to, for logs.
+const char* simdKernelName();
+
+#endif
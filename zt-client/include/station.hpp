@@ -0,0 +1,110 @@
+#ifndef STATION_HPP
+#define STATION_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "dev.hpp"
+#include "hotplug.hpp"
+#include "orchestrator.hpp"
+
+// Station mode: drives inserted while it runs are wiped without operator
+// clicks. Each new drive is matched against a policy; a match is queued
+// with the rule's method and its certificate written out when the job
+// finishes. Drives that match no rule, are in use, or fail are quarantined
+// and left alone until an operator releases them.
+
+struct StationRule {
+    std::string name;
+    std::vector<std::string> types;         // Device::type values; empty = any
+    std::vector<std::string> transports;    // Device::transport values; empty = any
+    uint64_t minBytes = 0;
+    uint64_t maxBytes = UINT64_MAX;
+    std::string bay;                        // fnmatch pattern on Device::busPath; "" = any
+    // In order of preference; the first one the drive supports is used.
+    std::vector<WipeMethod> methods;
+};
+
+struct StationPolicy {
+    std::vector<StationRule> rules;         // first match wins
+    std::string certificateDir = "/var/lib/zerotrace/certificates";
+    std::string quarantineFile = "/var/lib/zerotrace/quarantine.json";
+};
+
+// Reads a policy file:
+//   { "rules": [ { "name": "front bays", "types": ["ATA/SCSI"],
+//                  "transports": ["sata"], "min_bytes": 0, "max_bytes": ...,
+//                  "bay": "*/ata[3-6]/*", "methods": ["ata", "encrypted"] } ],
+//     "certificate_dir": "...", "quarantine_file": "..." }
+bool loadStationPolicy(const std::string& file, StationPolicy& out);
+
+// The first rule `dev` satisfies, or nullptr.
+const StationRule* matchStationRule(const StationPolicy& policy, const Device& dev);
+
+struct QuarantineEntry {
+    std::string identity;
+    std::string path;
+    std::string model;
+    std::string reason;
+    uint64_t    time = 0;
+};
+
+enum class StationEventKind { QUEUED, CERTIFIED, QUARANTINED, SKIPPED };
+
+struct StationEvent {
+    StationEventKind kind;
+    Device      device;
+    std::string detail;     // rule and method, certificate file, or reason
+};
+
+const char* stationEventKindName(StationEventKind k);
+
+class StationMode {
+public:
+    using EventCallback = std::function<void(const StationEvent&)>;
+
+    StationMode(StationPolicy policy, DeviceRegistry& registry, WipeOrchestrator& orchestrator);
+    ~StationMode();
+    StationMode(const StationMode&) = delete;
+    StationMode& operator=(const StationMode&) = delete;
+
+    // Drives already present are left alone; only later insertions are
+    // considered, so starting station mode never wipes the running system.
+    void start();
+    void stop();
+
+    void onEvent(EventCallback cb);
+
+    // The orchestrator has a single update callback owned by the front
+    // end, which forwards every job update here.
+    void jobUpdated(const WipeJob& job);
+
+    std::vector<QuarantineEntry> quarantined() const;
+    // Lets a quarantined drive be wiped on its next insertion.
+    bool release(const std::string& identity);
+
+private:
+    void deviceAdded(const Device& dev);
+    void quarantine(const Device& dev, const std::string& reason);
+    bool writeCertificate(const WipeJob& job, std::string& file);
+    void loadQuarantine();
+    void saveQuarantine();
+    void emit(StationEventKind kind, const Device& dev, const std::string& detail);
+
+    StationPolicy policy;
+    DeviceRegistry& registry;
+    WipeOrchestrator& orchestrator;
+    unsigned subscription = 0;
+    EventCallback callback;
+
+    mutable std::mutex mtx;
+    std::map<std::string, QuarantineEntry> quarantineList;  // by identity
+    std::map<std::string, std::string> activeJobs;          // device path -> identity
+    std::set<std::string> certified;                        // identities done this session
+};
+
+#endif
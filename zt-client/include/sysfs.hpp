@@ -0,0 +1,41 @@
+#ifndef SYSFS_HPP
+#define SYSFS_HPP
+
+#include <string>
+#include <cstdint>
+
+// First line of a sysfs attribute with trailing whitespace trimmed,
+// or "" if the file does not exist.
+std::string readSysfsLine(const std::string& path);
+
+// Numeric sysfs attribute, or `fallback` if missing or unparsable.
+uint64_t readSysfsU64(const std::string& path, uint64_t fallback = 0);
+
+// "/dev/nvme0n1" -> "nvme0n1", the name used under /sys/block.
+std::string blockDeviceName(const std::string& devicePath);
+
+// Identity of the disk behind devName that survives renumbering (sda
+// becoming sdb): the WWID if the kernel exposes one, else model + serial.
+// Last resort is name + size, which is only stable until the next reboot;
+// `stable` is set false in that case.
+std::string deviceIdentity(const std::string& devName, bool* stable = nullptr);
+
+// Firmware revision the kernel reports for the disk, "" if none.
+std::string firmwareRevision(const std::string& devName);
+
+// Where the disk hangs in the device tree, "/devices/pci0000:00/.../block/sda";
+// stable per physical slot, so it identifies a bay. "" if unknown.
+std::string deviceBusPath(const std::string& devName);
+
+// How the disk is attached: "nvme", "sata", "sas", "usb", "mmc", "virtio"
+// or "other", judged from the bus path.
+std::string deviceTransport(const std::string& devName);
+
+// True if the disk or one of its partitions is mounted, used as swap, or
+// held by another block device (device-mapper, md).
+bool deviceInUse(const std::string& devName);
+
+// Number of blk-mq hardware queues (/sys/block/<dev>/mq/*), 1 if unknown.
+unsigned hardwareQueueCount(const std::string& devName);
+
+#endif
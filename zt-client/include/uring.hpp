@@ -0,0 +1,91 @@
+#ifndef URING_HPP
+#define URING_HPP
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "overwrite.hpp"
+
+// Minimal io_uring wrapper over the raw syscalls (no liburing dependency).
+// Single-threaded: one submitter, one reaper.
+class IoUring {
+public:
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool init(unsigned entries);
+    bool registerBuffers(const std::vector<iovec>& iovs);
+    bool registerFiles(const std::vector<int>& fds);
+
+    // Returns a zeroed SQE, or nullptr when the submission queue is full.
+    io_uring_sqe* getSqe();
+
+    // Publishes pending SQEs and waits for at least waitNr completions.
+    int submit(unsigned waitNr);
+
+    // Pops one completion if available.
+    bool popCqe(io_uring_cqe& out);
+
+    unsigned entries() const { return sqEntries; }
+
+private:
+    int ringFd = -1;
+
+    void*  sqRing = nullptr;
+    void*  cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned  sqEntries = 0;
+    unsigned  sqeTail = 0;  // local tail, published by submit()
+
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+};
+
+// True if the running kernel lets us create an io_uring instance.
+bool uringAvailable();
+
+// Keeps up to queueDepth writes in flight against one fd, using registered
+// buffers and a registered file when the kernel accepts them.
+class UringWriter {
+public:
+    bool init(int fd, ChunkSource& src, unsigned queueDepth,
+              WipeProgress* progress = nullptr);
+    bool writeRange(uint64_t offset, uint64_t length, size_t blockSize);
+
+private:
+    struct Pending {
+        WriteChunk chunk;
+        uint64_t   offset;
+    };
+
+    // Reaps the remaining completions and hands their chunks back.
+    void drain(unsigned& inflight);
+
+    IoUring ring;
+    int fd = -1;
+    ChunkSource* src = nullptr;
+    WipeProgress* progress = nullptr;
+    unsigned queueDepth = 0;
+    bool fixedBuffers = false;
+    bool fixedFile = false;
+
+    std::vector<Pending>  pending;
+    std::vector<unsigned> freeSlots;
+};
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef VERIFY_HPP
+#define VERIFY_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "arena.hpp"
+#include "progress.hpp"
+
+// Decides whether one block read back from the device holds what the wipe
+// should have left there. One instance per verifier thread.
+class BlockChecker {
+public:
+    virtual ~BlockChecker() = default;
+    virtual bool check(uint64_t offset, const char* data, size_t len) = 0;
+};
+
+using CheckerFactory = std::function<std::unique_ptr<BlockChecker>()>;
+
+// Every byte must equal `value`; uses the SIMD scan from simd.hpp.
+class ConstantChecker : public BlockChecker {
+public:
+    explicit ConstantChecker(uint8_t value) : value(value) {}
+    bool check(uint64_t offset, const char* data, size_t len) override;
+
+private:
+    uint8_t value;
+};
+
+// Every logical block must be a single repeated 0x00 or 0xFF byte: what a
+// normal ATA SECURITY ERASE UNIT or a zero-pattern NVMe overwrite sanitize
+// leaves behind. Only for erases that define their result; enhanced ATA
+// erase, block-erase sanitize and crypto erase leave vendor contents.
+class ErasedChecker : public BlockChecker {
+public:
+    explicit ErasedChecker(size_t logicalBlock = 512) : lbs(logicalBlock) {}
+    bool check(uint64_t offset, const char* data, size_t len) override;
+
+private:
+    size_t lbs;
+};
+
+struct VerifyRange {
+    uint64_t offset;
+    uint64_t length;
+};
+
+// Block counts are in the device's logical blocks, not in reads.
+struct VerifyReport {
+    uint64_t bytesChecked = 0;
+    uint64_t blocksChecked = 0;
+    uint64_t mismatchedBlocks = 0;
+    uint64_t unreadableBlocks = 0;
+
+    // Byte ranges that failed, narrowed to logical blocks, merged and
+    // sorted. Capped at MAX_RECORDED_RANGES; rangesTruncated says if more.
+    static constexpr size_t MAX_RECORDED_RANGES = 64;
+    std::vector<VerifyRange> badRanges;
+    bool rangesTruncated = false;
+
+    bool ok() const { return mismatchedBlocks == 0 && unreadableBlocks == 0; }
+};
+
+// Whole device as one range.
+std::vector<VerifyRange> fullRanges(uint64_t size);
+
+// Sampling layout after NIST SP 800-88: the device is cut into `regions`
+// equal regions, `samplesPerRegion` sub-ranges of `sampleBytes` are placed
+// at random inside each, and the first and last `edgeBytes` are always
+// read. The same plan and seed reproduce the same ranges.
+struct SamplingPlan {
+    uint64_t seed = 0;              // 0 = draw one when the plan is used
+    unsigned regions = 1000;
+    unsigned samplesPerRegion = 1;
+    uint64_t sampleBytes = 1024 * 1024;
+    uint64_t edgeBytes = 16 * 1024 * 1024;
+};
+
+// Default alignment of sampled ranges; any O_DIRECT block size divides it.
+constexpr size_t SAMPLE_ALIGN = 4096;
+
+// Ranges for `plan`, sorted and merged, aligned to `align` bytes so they can
+// be read with O_DIRECT. Each sample in a region starting at `start` with
+// `slots` aligned positions lies at
+//   start + (mt19937_64(seed)() % (slots + 1)) * align
+// drawing from one generator in region order.
+std::vector<VerifyRange> sampleRanges(uint64_t size, const SamplingPlan& plan,
+                                      size_t align = SAMPLE_ALIGN);
+
+// Fraction of a `size`-byte device the ranges cover.
+double rangeCoverage(const std::vector<VerifyRange>& ranges, uint64_t size);
+
+// Picks samplesPerRegion so the plan reads roughly `fraction` of the device.
+void setSamplingCoverage(SamplingPlan& plan, uint64_t size, double fraction);
+
+// Verifies regions as they are handed over instead of all at once, so that
+// read-back of the last pass can run behind its writer. Only the parts of
+// submitted regions that fall inside `ranges` (sorted, disjoint) are read.
+// Reading starts on construction; finish() waits for everything submitted
+// and returns the same report a standalone verifyRanges() would have.
+class PipelinedVerifier {
+public:
+    PipelinedVerifier(const std::string& devicePath, std::vector<VerifyRange> ranges,
+                      CheckerFactory makeChecker, unsigned threads, size_t blockSize);
+    ~PipelinedVerifier();
+    PipelinedVerifier(const PipelinedVerifier&) = delete;
+    PipelinedVerifier& operator=(const PipelinedVerifier&) = delete;
+
+    // [offset, offset + length) has been written and may be read back.
+    void submit(uint64_t offset, uint64_t length);
+
+    // Bytes read from here on are added to `progress`.
+    void setProgress(WipeProgress* progress) { progressOut = progress; }
+
+    // With `progress`, first restarts it as VERIFYING over what has been
+    // read plus what is still queued.
+    VerifyReport finish(WipeProgress* progress = nullptr);
+
+    uint64_t bytesChecked() const { return bytes; }
+
+private:
+    void worker(char* buf);
+    void close();
+
+    std::vector<VerifyRange> ranges;
+    CheckerFactory makeChecker;
+    size_t blockSize;
+    size_t logicalBlock = 512;
+    int fd = -1;
+    bool failed = false;
+    std::unique_ptr<BufferArena> arena;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<VerifyRange> queue;
+    bool closed = false;
+    std::vector<VerifyRange> allBad;
+    std::vector<std::thread> workers;
+
+    std::atomic<WipeProgress*> progressOut{nullptr};
+    std::atomic<uint64_t> bytes{0}, checked{0}, mismatched{0}, unreadable{0};
+    std::atomic<bool> truncated{false};
+};
+
+// Reads the ranges back with O_DIRECT on `threads` workers and runs every
+// block through a checker. Memory use is a couple of blocks per thread.
+// Bytes read are added to `progress` if given.
+VerifyReport verifyRanges(const std::string& devicePath,
+                          const std::vector<VerifyRange>& ranges,
+                          const CheckerFactory& makeChecker,
+                          unsigned threads, size_t blockSize,
+                          WipeProgress* progress = nullptr);
+
+#endif
@@ -1,10 +1,79 @@
 #ifndef WIPE_HPP
 #define WIPE_HPP
 
+#include <atomic>
 #include <string>
-#include "dev.hpp" 
+#include "dev.hpp"
 #include "cert.hpp"
+#include "verify.hpp"
+#include "progress.hpp"
+#include "qos.hpp"
 
-WipeResult wipeDisk(const std::string& devicePath, WipeMethod method);
+enum class WipeEngine {
+    AUTO,       // io_uring when the kernel supports it, else SYNC
+    SYNC,       // one blocking write() at a time
+    IO_URING,
+    OFFLOAD     // BLKZEROOUT in the kernel; zero fill only, others use AUTO
+};
+
+enum class VerifyMode {
+    NONE,
+    SAMPLED,    // random sub-ranges per region plus both ends, see SamplingPlan
+    FULL
+};
+
+// Fields here must also be passed on to wipe workers, see worker.cpp.
+struct WipeOptions {
+    WipeEngine engine = WipeEngine::AUTO;
+    unsigned   queueDepth = 0;      // writes in flight per stripe (io_uring only); 0 = planner
+    size_t     requestSize = 0;     // bytes per write; 0 = planner, see planner.hpp
+    bool       calibrate = false;   // time a few request sizes before the first pass
+    bool       directIO = true;     // O_DIRECT from aligned arena buffers, bypassing the page cache
+    unsigned   stripes = 1;         // concurrent LBA stripes; 0 = one per hardware queue
+    unsigned   keystreamThreads = 2; // generator threads per stripe (ENCRYPTED_OVERWRITE)
+    bool       secureDiscard = false; // OFFLOAD: BLKSECDISCARD each stripe before zeroing
+    bool       ataEnhanced = true;  // ATA_SECURE_ERASE: enhanced erase when the drive has it
+    std::string scheme;             // overwrite passes, see parseScheme(); "" = method default
+
+    VerifyMode verify = VerifyMode::NONE;
+    SamplingPlan sampling;          // SAMPLED layout; seed 0 = random
+    double     verifyCoverage = 0.01; // sets sampling.samplesPerRegion; 0 = leave as given
+    unsigned   verifyThreads = 0;   // 0 = one per core, up to 8
+    bool       pipelineVerify = false; // read back the last pass while it is still being written
+    unsigned   verifyLag = 2;       // pipelined: segments the reader trails each writer by
+
+    WipeProgress* progress = nullptr; // live counters for callers to poll; may be null
+    // Set from another thread to stop an overwrite at the next segment
+    // boundary; the checkpoint is kept so it can be resumed. Firmware
+    // erases cannot be interrupted once started. May be null.
+    const std::atomic<bool>* cancel = nullptr;
+
+    // Shared write bandwidth limits for wiping many disks at once; may be
+    // null. qosWeight is this disk's weight in QosMode::WEIGHTED.
+    BandwidthController* qos = nullptr;
+    double      qosWeight = 0;      // 0 = bytes left to write
+    // Charged instead of a share of `qos` when set, for a wipe whose
+    // controller lives in another process (see worker.hpp). May be null.
+    WriteThrottle* throttle = nullptr;
+
+    // Overwrites checkpoint their position to journalDir every
+    // checkpointSeconds (0 = never) and, with `resume`, continue from a
+    // checkpoint left by an interrupted wipe of the same disk. Disks with
+    // no stable identity (see deviceIdentity()) are never checkpointed.
+    unsigned    checkpointSeconds = 60;
+    std::string journalDir = "/var/lib/zerotrace/checkpoints";
+    bool        resume = false;
+};
+
+class NvmeTransport;
+
+// The firmware erase wipeDisk() runs for FIRMWARE_ERASE on an NVMe drive,
+// over any transport. `noPattern` is left empty when the erase writes a
+// defined pattern that can be verified, otherwise it says why not.
+bool nvmeFirmwareErase(NvmeTransport& nvme, std::string& noPattern, WipeProgress& progress,
+                       WipeResult& result);
+
+WipeResult wipeDisk(const std::string& devicePath, WipeMethod method,
+                    const WipeOptions& opts = {});
 
 #endif
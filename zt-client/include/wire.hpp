@@ -0,0 +1,27 @@
+#ifndef WIRE_HPP
+#define WIRE_HPP
+
+#include <cstdint>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "dev.hpp"
+#include "orchestrator.hpp"
+#include "progress.hpp"
+
+// JSON shapes shared by the CLI's --json output and the daemon protocol,
+// and the daemon's framing: a 4-byte big-endian payload length followed
+// by that many bytes of UTF-8 JSON.
+
+constexpr uint32_t MAX_FRAME_BYTES = 1 << 20;
+
+// Blocking; both retry on EINTR. readFrame() returns false on EOF, a
+// short read, an oversized frame or a payload that is not JSON.
+bool writeFrame(int fd, const nlohmann::json& msg);
+bool readFrame(int fd, nlohmann::json& msg);
+
+nlohmann::json deviceToJson(const Device& dev);
+// Without the certificate body; see WipeJob::certificate.
+nlohmann::json jobToJson(const WipeJob& job);
+nlohmann::json progressToJson(const ProgressSnapshot& snap);
+
+#endif
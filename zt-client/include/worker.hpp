@@ -0,0 +1,83 @@
+#ifndef WORKER_HPP
+#define WORKER_HPP
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include "progress.hpp"
+#include "qos.hpp"
+#include "wipe.hpp"
+
+// When the parent gives up on a wipe worker.
+struct WorkerLimits {
+    bool     isolate = true;            // false: wipe on the calling thread, no limits
+    unsigned stallSeconds = 600;        // no bytes written or verified for this long; 0 = never
+    unsigned timeoutSeconds = 0;        // the whole wipe bar firmware erasing; 0 = never
+    unsigned cancelGraceSeconds = 30;   // between asking the worker to stop and SIGKILL
+};
+
+struct WorkerChannel;
+
+// Runs one wipeDisk() in a child process, so a drive that hangs the
+// kernel in uninterruptible I/O takes only its own worker with it. The
+// worker is this executable re-run with a hidden subcommand; it publishes
+// progress samples into a ring in shared memory the parent maps, and
+// sends its WipeResult back over a pipe when it is done.
+//
+// A worker is never killed during a firmware erase: the drive carries on
+// regardless and reports nothing while it works. Stall and timeout checks
+// are suspended for the ERASING phase and a cancel waits until it ends;
+// the erase commands' own timeouts bound it.
+class WipeWorker {
+public:
+    WipeWorker() = default;
+    // Kills a worker that is still running.
+    ~WipeWorker();
+    WipeWorker(const WipeWorker&) = delete;
+    WipeWorker& operator=(const WipeWorker&) = delete;
+
+    // opts.progress and opts.cancel are ignored here; see wait(). opts.qos
+    // stays in this process and paces the worker through shared memory.
+    bool start(const std::string& devicePath, WipeMethod method, const WipeOptions& opts,
+               std::string& error);
+
+    // Follows the worker until it exits or is killed. `cancel` asks it to
+    // stop at the next segment; `onPhase` is called on this thread for
+    // each phase change. On failure `error` says why the worker died, or
+    // stays empty when the wipe itself failed.
+    WipeResult wait(const WorkerLimits& limits, const std::atomic<bool>* cancel,
+                    const std::function<void(WipePhase)>& onPhase, std::string& error);
+
+    // Latest sample from the worker; any thread. False before the first.
+    bool progress(ProgressSnapshot& out) const;
+
+private:
+    void drain(const std::function<void(WipePhase)>& onPhase);
+
+    std::string devicePath;
+    WipeMethod  method = WipeMethod::PLAIN_OVERWRITE;
+    BandwidthController* qos = nullptr;
+    double      qosWeight = 0;
+
+    pid_t pid = -1;
+    int   resultFd = -1;
+    WorkerChannel* channel = nullptr;
+
+    uint64_t tail = 0;                  // next ring sample to read
+
+    mutable std::mutex mtx;             // guards `latest`
+    ProgressSnapshot latest{};
+    bool haveLatest = false;
+};
+
+// True while a worker that could not be reaped after SIGKILL may still
+// have `devicePath` open.
+bool deviceHeldByWorker(const std::string& devicePath);
+
+// The hidden subcommand main() hands to runWipeWorker().
+bool isWorkerCommand(const char* arg);
+int runWipeWorker(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,141 @@
+#include "include/journal.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+static const int JOURNAL_VERSION = 1;
+
+// Device identities contain spaces and slashes; keep file names tame.
+static std::string fileNameFor(const std::string& deviceId) {
+    std::string out;
+    for (char c : deviceId) {
+        bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9') || c == '-' || c == '.';
+        out += safe ? c : '_';
+    }
+    return out + ".json";
+}
+
+static bool makeDirs(const std::string& path) {
+    for (size_t pos = 1; pos != std::string::npos; ) {
+        pos = path.find('/', pos + 1);
+        std::string part = path.substr(0, pos);
+        if (mkdir(part.c_str(), 0700) < 0 && errno != EEXIST) {
+            perror(("mkdir " + part).c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+CheckpointJournal::CheckpointJournal(const std::string& dir_, const std::string& deviceId)
+    : dir(dir_), file(dir_ + "/" + fileNameFor(deviceId)) {}
+
+bool CheckpointJournal::load(WipeCheckpoint& out) const {
+    std::ifstream in(file);
+    if (!in.is_open()) return false;
+
+    nlohmann::json j = nlohmann::json::parse(in, nullptr, false);
+    if (j.is_discarded() || j.value("version", 0) != JOURNAL_VERSION) {
+        std::cerr << "Ignoring unreadable checkpoint " << file << "\n";
+        return false;
+    }
+
+    try {
+        WipeCheckpoint cp;
+        cp.deviceId = j.at("device_id").get<std::string>();
+        cp.method = j.at("method").get<int>();
+        cp.scheme = j.value("scheme", std::string());
+        cp.size = j.at("size").get<uint64_t>();
+        cp.passes = j.at("passes").get<unsigned>();
+        for (const auto& s : j.at("stripes")) {
+            cp.stripes.push_back({ s.at("offset").get<uint64_t>(),
+                                   s.at("length").get<uint64_t>(),
+                                   s.at("written").get<uint64_t>() });
+        }
+        if (j.contains("key")) {
+            cp.hasKey = true;
+            cp.key.cipher = (KeystreamCipher)j["key"].at("cipher").get<int>();
+            cp.key.key = j["key"].at("key").get<std::array<uint8_t, 32>>();
+            cp.key.iv = j["key"].at("iv").get<std::array<uint8_t, 16>>();
+        }
+        cp.resumeCount = j.value("resume_count", 0u);
+        cp.startTime = j.value("start_time", (uint64_t)0);
+        out = cp;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring malformed checkpoint " << file << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+bool CheckpointJournal::save(const WipeCheckpoint& cp) {
+    if (!makeDirs(dir)) return false;
+
+    nlohmann::json j;
+    j["version"] = JOURNAL_VERSION;
+    j["device_id"] = cp.deviceId;
+    j["method"] = cp.method;
+    j["scheme"] = cp.scheme;
+    j["size"] = cp.size;
+    j["passes"] = cp.passes;
+    j["resume_count"] = cp.resumeCount;
+    j["start_time"] = cp.startTime;
+    j["stripes"] = nlohmann::json::array();
+    for (const StripeCheckpoint& s : cp.stripes) {
+        j["stripes"].push_back({ {"offset", s.offset}, {"length", s.length}, {"written", s.written} });
+    }
+    if (cp.hasKey) {
+        j["key"] = { {"cipher", (int)cp.key.cipher}, {"key", cp.key.key}, {"iv", cp.key.iv} };
+    }
+    std::string data = j.dump();
+
+    std::string tmp = file + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        perror(("open " + tmp).c_str());
+        return false;
+    }
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t w = write(fd, data.data() + done, data.size() - done);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            perror("write checkpoint");
+            close(fd);
+            unlink(tmp.c_str());
+            return false;
+        }
+        done += w;
+    }
+    if (fsync(fd) < 0) {
+        perror("fsync checkpoint");
+        close(fd);
+        unlink(tmp.c_str());
+        return false;
+    }
+    close(fd);
+
+    if (rename(tmp.c_str(), file.c_str()) < 0) {
+        perror("rename checkpoint");
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    // The rename itself is only durable once the directory is synced.
+    int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    return true;
+}
+
+void CheckpointJournal::remove() {
+    if (unlink(file.c_str()) < 0 && errno != ENOENT) perror(("unlink " + file).c_str());
+}
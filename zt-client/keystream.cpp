@@ -0,0 +1,247 @@
+#include "include/keystream.hpp"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+KeystreamCipher preferredCipher() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("aes")) return KeystreamCipher::AES_128_CTR;
+#elif defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_AES) return KeystreamCipher::AES_128_CTR;
+#endif
+    return KeystreamCipher::CHACHA20;
+}
+
+const char* cipherName(KeystreamCipher c) {
+    switch (c) {
+        case KeystreamCipher::AES_128_CTR: return "aes-128-ctr";
+        case KeystreamCipher::CHACHA20:    return "chacha20";
+    }
+    return "unknown";
+}
+
+bool newEphemeralKey(KeystreamCipher cipher, KeystreamKey& out) {
+    out.cipher = cipher;
+    if (RAND_bytes(out.key.data(), out.key.size()) != 1 ||
+        RAND_bytes(out.iv.data(), out.iv.size()) != 1) {
+        fprintf(stderr, "RAND_bytes failed\n");
+        return false;
+    }
+    return true;
+}
+
+KeystreamGenerator::KeystreamGenerator(const KeystreamKey& key_, unsigned pass)
+    : key(key_), ctx(EVP_CIPHER_CTX_new()) {
+    // Each pass gets its own stream by folding the pass number into IV
+    // bytes no counter carry can reach: the top of AES's 128-bit counter
+    // (2^64 blocks away), or the last nonce word for ChaCha20, whose
+    // counter OpenSSL carries from bytes 0-3 into 4-7.
+    int at = key.cipher == KeystreamCipher::AES_128_CTR ? 4 : 12;
+    for (int i = 0; i < 4; i++) key.iv[at + i] ^= (pass >> (8 * i)) & 0xff;
+
+    const EVP_CIPHER* c = key.cipher == KeystreamCipher::AES_128_CTR
+                              ? EVP_aes_128_ctr() : EVP_chacha20();
+    if (ctx) EVP_EncryptInit_ex(ctx, c, nullptr, key.key.data(), key.iv.data());
+}
+
+KeystreamGenerator::~KeystreamGenerator() {
+    EVP_CIPHER_CTX_free(ctx);
+    OPENSSL_cleanse(key.key.data(), key.key.size());
+}
+
+// Positions the cipher at the block containing `offset`; `skip` is how far
+// into that block the requested byte lies.
+bool KeystreamGenerator::seek(uint64_t offset, size_t& skip) {
+    std::array<uint8_t, 16> iv = key.iv;
+
+    if (key.cipher == KeystreamCipher::AES_128_CTR) {
+        // 128-bit big-endian counter block: IV + offset / 16
+        uint64_t add = offset / 16;
+        skip = offset % 16;
+        for (int i = 15; i >= 0 && add; i--) {
+            uint64_t sum = (uint64_t)iv[i] + (add & 0xff);
+            iv[i] = sum & 0xff;
+            add = (add >> 8) + (sum >> 8);
+        }
+    } else {
+        // OpenSSL's ChaCha20 IV starts with a 32-bit little-endian block
+        // counter, and when it wraps OpenSSL carries into bytes 4-7. Treating
+        // bytes 0-7 as one 64-bit counter makes a seek land exactly where a
+        // single long generate() would have got to.
+        uint64_t block = offset / 64;
+        skip = offset % 64;
+        for (int i = 0; i < 8; i++) iv[i] = (block >> (8 * i)) & 0xff;
+    }
+
+    return EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, iv.data()) == 1;
+}
+
+bool KeystreamGenerator::generate(uint64_t offset, char* out, size_t len) {
+    if (!ctx) return false;
+
+    size_t skip = 0;
+    if (!seek(offset, skip)) return false;
+
+    int outl = 0;
+    if (skip) {
+        unsigned char discard[64] = {};
+        if (EVP_EncryptUpdate(ctx, discard, &outl, discard, (int)skip) != 1) return false;
+    }
+
+    // Keystream = encryption of zeros.
+    memset(out, 0, len);
+    unsigned char* p = reinterpret_cast<unsigned char*>(out);
+    while (len > 0) {
+        int n = (int)std::min<size_t>(len, INT_MAX & ~63);
+        if (EVP_EncryptUpdate(ctx, p, &outl, p, n) != 1) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+KeystreamChecker::KeystreamChecker(const KeystreamKey& key, unsigned pass, size_t blockSize)
+    : gen(key, pass), expected(blockSize) {}
+
+bool KeystreamChecker::check(uint64_t offset, const char* data, size_t len) {
+    if (len > expected.size()) expected.resize(len);
+    if (!gen.generate(offset, expected.data(), len)) return false;
+    return memcmp(data, expected.data(), len) == 0;
+}
+
+KeystreamSource::KeystreamSource(const KeystreamKey& key_, std::vector<char*> bufs,
+                                 size_t blockSize_, unsigned threads)
+    : key(key_), blockSize(blockSize_), threadCount(std::max(1u, threads)) {
+    for (char* b : bufs) slots.push_back({ b, SlotState::FREE, 0 });
+    for (unsigned i = 0; i < threadCount; i++) {
+        generators.emplace_back(&KeystreamSource::generatorLoop, this);
+    }
+}
+
+KeystreamSource::~KeystreamSource() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : generators) t.join();
+    OPENSSL_cleanse(key.key.data(), key.key.size());
+}
+
+std::vector<iovec> KeystreamSource::buffers() {
+    std::vector<iovec> out;
+    for (const Slot& s : slots) out.push_back({ s.buf, blockSize });
+    return out;
+}
+
+bool KeystreamSource::healthy() const {
+    return !failed;
+}
+
+size_t KeystreamSource::maxInFlight() const {
+    // Leave the generators room to work ahead; if every slot could be in
+    // flight, acquire() would wait on a release that never comes.
+    return slots.size() > threadCount ? slots.size() - threadCount : 1;
+}
+
+void KeystreamSource::begin(unsigned pass_, uint64_t offset, uint64_t length) {
+    std::unique_lock<std::mutex> lock(mtx);
+    epoch++;
+    cv.wait(lock, [this] { return generating == 0; });
+
+    for (Slot& s : slots) s.state = SlotState::FREE;
+    pass = pass_;
+    rangeStart = offset;
+    rangeLength = length;
+    nextGen = 0;
+    active = true;
+    cv.notify_all();
+}
+
+WriteChunk KeystreamSource::acquire(uint64_t offset, size_t len) {
+    uint64_t seq = (offset - rangeStart) / blockSize;
+    Slot& s = slots[seq % slots.size()];
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] { return s.state == SlotState::READY && s.seq == seq; });
+    s.state = SlotState::IN_USE;
+
+    int index = (int)(seq % slots.size());
+    return { s.buf, std::min(len, blockSize), index };
+}
+
+void KeystreamSource::release(const WriteChunk& chunk) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        slots[chunk.bufIndex].state = SlotState::FREE;
+    }
+    cv.notify_all();
+}
+
+void KeystreamSource::generatorLoop() {
+    std::unique_ptr<KeystreamGenerator> gen;
+    unsigned genEpoch = 0;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    for (;;) {
+        cv.wait(lock, [&] {
+            uint64_t blocks = (rangeLength + blockSize - 1) / blockSize;
+            return stopping ||
+                   (active && nextGen < blocks &&
+                    slots[nextGen % slots.size()].state == SlotState::FREE);
+        });
+        if (stopping) return;
+
+        uint64_t seq = nextGen++;
+        Slot& s = slots[seq % slots.size()];
+        s.state = SlotState::GENERATING;
+        s.seq = seq;
+        generating++;
+
+        unsigned myEpoch = epoch;
+        unsigned myPass = pass;
+        uint64_t offset = rangeStart + seq * blockSize;
+        size_t len = std::min<uint64_t>(blockSize, rangeStart + rangeLength - offset);
+        lock.unlock();
+
+        if (!gen || genEpoch != myEpoch) {
+            gen = std::make_unique<KeystreamGenerator>(key, myPass);
+            genEpoch = myEpoch;
+        }
+        bool ok = gen->generate(offset, s.buf, len);
+
+        lock.lock();
+        generating--;
+        if (myEpoch == epoch) {
+            if (!ok) {
+                // The block still gets written, but the wipe must not be
+                // certified as a random overwrite.
+                fprintf(stderr, "keystream generation failed at %llu\n",
+                        (unsigned long long)offset);
+                failed = true;
+            }
+            s.state = SlotState::READY;
+        }
+        cv.notify_all();
+    }
+}
+
+std::unique_ptr<ChunkSource> makeKeystreamSource(BufferArena& arena, size_t blockSize,
+                                                 const KeystreamKey& key,
+                                                 unsigned slots, unsigned threads) {
+    std::vector<char*> bufs;
+    for (unsigned i = 0; i < slots; i++) {
+        char* b = arena.allocate(blockSize);
+        if (!b) return nullptr;
+        bufs.push_back(b);
+    }
+    return std::make_unique<KeystreamSource>(key, std::move(bufs), blockSize, threads);
+}
@@ -1,11 +1,18 @@
 #include <iostream>
+#include <string>
+#include "include/cli.hpp"
 #include "include/gui.hpp"
+#include "include/worker.hpp"
 
 #if defined(__linux__) || defined(__APPLE__)
 #include <unistd.h> // For geteuid
 #endif
 
 int main(int argc, char* argv[]) {
+    // Subcommands run headless and never initialize GTK.
+    if (argc > 1 && isWorkerCommand(argv[1])) return runWipeWorker(argc, argv);
+    if (argc > 1 && isCliCommand(argv[1])) return runCli(argc, argv);
+
 #if defined(__linux__) || defined(__APPLE__)
     // check for sudo permissions on Linux/Mac
     if(geteuid() != 0){
@@ -14,7 +21,20 @@ int main(int argc, char* argv[]) {
     }
 #endif
 
-    runGui();
+    // --station <policy.json>: kiosk mode for a recycling line
+    std::string stationPolicy;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--station" && i + 1 < argc) {
+            stationPolicy = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--station <policy.json>]\n"
+                      << "       " << argv[0] << " list|wipe|verify ... (see --help)\n";
+            return 2;
+        }
+    }
+
+    runGui(stationPolicy);
 
     return 0;
 }
@@ -0,0 +1,121 @@
+#include "include/numa.hpp"
+#include "include/sysfs.hpp"
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// From <numaif.h>; libnuma is not a dependency, so mbind is called raw.
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+static constexpr unsigned MAX_NODES = 1024;
+
+// "0000:02:00.0"
+static bool isPciAddress(const std::string& s) {
+    return s.size() == 12 && s[4] == ':' && s[7] == ':' && s[10] == '.';
+}
+
+// /sys/devices/... directory behind /sys/block/<devName>.
+static fs::path deviceDir(const std::string& devName) {
+    std::error_code ec;
+    fs::path p = fs::canonical("/sys/block/" + devName, ec);
+    return ec ? fs::path() : p;
+}
+
+std::string devicePciPath(const std::string& devName) {
+    std::string out;
+    for (const fs::path& part : deviceDir(devName)) {
+        std::string s = part.string();
+        if (!isPciAddress(s)) continue;
+        if (!out.empty()) out += "/";
+        out += s;
+    }
+    return out;
+}
+
+int deviceNumaNode(const std::string& devName) {
+    // The block device itself has no numa_node; the PCI function it hangs
+    // off does, a few levels up.
+    for (fs::path p = deviceDir(devName); !p.empty() && p != p.root_path(); p = p.parent_path()) {
+        std::string v = readSysfsLine((p / "numa_node").string());
+        if (v.empty()) continue;
+        int node = atoi(v.c_str());
+        return node >= 0 ? node : -1;
+    }
+    return -1;
+}
+
+unsigned numaNodeCount() {
+    unsigned n = 0;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator("/sys/devices/system/node", ec)) {
+        std::string name = e.path().filename().string();
+        if (name.rfind("node", 0) == 0 && name.size() > 4 && isdigit((unsigned char)name[4])) n++;
+    }
+    return std::max(1u, n);
+}
+
+int placementNode(const std::string& devicePath) {
+    if (numaNodeCount() < 2) return -1;
+    return deviceNumaNode(blockDeviceName(devicePath));
+}
+
+bool bindMemoryToNode(void* addr, size_t len, int node) {
+    if (node < 0 || (unsigned)node >= MAX_NODES) return false;
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask, MAX_NODES + 1, MPOL_MF_MOVE) != 0) {
+        perror("mbind");
+        return false;
+    }
+    return true;
+}
+
+// CPUs listed in /sys/devices/system/node/node<N>/cpulist ("0-7,16-23").
+static bool nodeCpus(int node, cpu_set_t& set) {
+    std::string list = readSysfsLine("/sys/devices/system/node/node" +
+                                     std::to_string(node) + "/cpulist");
+    CPU_ZERO(&set);
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        unsigned lo, hi;
+        int n = sscanf(range.c_str(), "%u-%u", &lo, &hi);
+        if (n < 1) continue;
+        if (n == 1) hi = lo;
+        for (unsigned c = lo; c <= hi && c < CPU_SETSIZE; c++) CPU_SET(c, &set);
+    }
+    return CPU_COUNT(&set) > 0;
+}
+
+NodeAffinity::NodeAffinity(int node) {
+    if (node < 0) return;
+
+    cpu_set_t cpus;
+    if (!nodeCpus(node, cpus)) return;
+    if (sched_getaffinity(0, sizeof(saved), &saved) != 0) return;
+
+    // Stay inside whatever the process was already confined to.
+    CPU_AND(&cpus, &cpus, &saved);
+    if (CPU_COUNT(&cpus) == 0) return;
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        perror("sched_setaffinity");
+        return;
+    }
+    active = true;
+}
+
+NodeAffinity::~NodeAffinity() {
+    if (active) sched_setaffinity(0, sizeof(saved), &saved);
+}
@@ -0,0 +1,358 @@
+#include "include/nvme.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/nvme_ioctl.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+static constexpr uint8_t OP_GET_LOG_PAGE = 0x02;
+static constexpr uint8_t OP_IDENTIFY = 0x06;
+static constexpr uint8_t OP_FORMAT_NVM = 0x80;
+static constexpr uint8_t OP_SANITIZE = 0x84;
+
+static constexpr uint8_t CNS_NAMESPACE = 0x00;
+static constexpr uint8_t CNS_CONTROLLER = 0x01;
+static constexpr uint8_t LOG_SANITIZE_STATUS = 0x81;
+static constexpr uint32_t NSID_ALL = 0xffffffff;
+
+static constexpr unsigned FORMAT_TIMEOUT = 12 * 3600;
+static constexpr unsigned SANITIZE_START_POLLS = 10;   // polls to wait for the log to show it
+
+const char* nvmeErrorKindName(NvmeErrorKind k) {
+    switch (k) {
+        case NvmeErrorKind::NONE:          return "ok";
+        case NvmeErrorKind::OPEN:          return "cannot open device";
+        case NvmeErrorKind::IOCTL:         return "admin ioctl failed";
+        case NvmeErrorKind::STATUS:        return "command failed";
+        case NvmeErrorKind::NOT_SUPPORTED: return "not supported";
+        case NvmeErrorKind::TIMEOUT:       return "timed out";
+        case NvmeErrorKind::FAILED:        return "sanitize failed";
+    }
+    return "unknown";
+}
+
+std::string NvmeError::describe() const {
+    std::ostringstream s;
+    s << nvmeErrorKindName(kind);
+    if (opcode) s << " (opcode 0x" << std::hex << (unsigned)opcode;
+    if (status) s << ", status 0x" << std::hex << status;
+    if (opcode) s << ")";
+    if (sysErrno) s << ": " << strerror(sysErrno);
+    if (!message.empty()) s << ": " << message;
+    return s.str();
+}
+
+static NvmeError fail(NvmeErrorKind kind, uint8_t opcode, const std::string& message = "") {
+    NvmeError e;
+    e.kind = kind;
+    e.opcode = opcode;
+    e.message = message;
+    return e;
+}
+
+const char* sanitizeActionName(SanitizeAction a) {
+    switch (a) {
+        case SanitizeAction::BLOCK_ERASE:  return "block-erase";
+        case SanitizeAction::OVERWRITE:    return "overwrite";
+        case SanitizeAction::CRYPTO_ERASE: return "crypto-erase";
+    }
+    return "unknown";
+}
+
+IoctlNvmeTransport::IoctlNvmeTransport(const std::string& devicePath) : path(devicePath) {
+    fd = open(devicePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        openErrno = errno;
+        return;
+    }
+    // Fails on a controller node (/dev/nvme0), which has no namespace.
+    int id = ioctl(fd, NVME_IOCTL_ID);
+    nsid = id > 0 ? id : 0;
+}
+
+IoctlNvmeTransport::~IoctlNvmeTransport() {
+    if (fd >= 0) close(fd);
+}
+
+NvmeError IoctlNvmeTransport::admin(const NvmeAdminCommand& cmd, uint32_t* result) {
+    NvmeError err;
+    err.opcode = cmd.opcode;
+    if (fd < 0) {
+        err.kind = NvmeErrorKind::OPEN;
+        err.sysErrno = openErrno;
+        err.message = path;
+        return err;
+    }
+
+    nvme_admin_cmd c = {};
+    c.opcode = cmd.opcode;
+    c.nsid = cmd.nsid;
+    c.addr = (uint64_t)(uintptr_t)cmd.data;
+    c.data_len = cmd.dataLen;
+    c.cdw10 = cmd.cdw10;
+    c.cdw11 = cmd.cdw11;
+    c.cdw12 = cmd.cdw12;
+    c.cdw13 = cmd.cdw13;
+    c.cdw14 = cmd.cdw14;
+    c.cdw15 = cmd.cdw15;
+    c.timeout_ms = cmd.timeoutSeconds * 1000;
+
+    int r = ioctl(fd, NVME_IOCTL_ADMIN_CMD, &c);
+    if (r < 0) {
+        err.kind = NvmeErrorKind::IOCTL;
+        err.sysErrno = errno;
+        return err;
+    }
+    // A positive return is the completion's status field.
+    if (r > 0) {
+        err.kind = NvmeErrorKind::STATUS;
+        err.status = r & 0x7ff;
+        return err;
+    }
+    if (result) *result = c.result;
+    return err;
+}
+
+static NvmeError identify(NvmeTransport& t, uint8_t cns, uint32_t nsid, uint8_t* buf) {
+    NvmeAdminCommand cmd;
+    cmd.opcode = OP_IDENTIFY;
+    cmd.nsid = nsid;
+    cmd.cdw10 = cns;
+    cmd.data = buf;
+    cmd.dataLen = 4096;
+    return t.admin(cmd);
+}
+
+static std::string idString(const uint8_t* p, size_t len) {
+    std::string s((const char*)p, len);
+    s.erase(s.find_last_not_of(" \0", std::string::npos, 2) + 1);
+    return s;
+}
+
+static uint32_t le32(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void putLe32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = v >> (8 * i);
+}
+
+NvmeError nvmeIdentifyController(NvmeTransport& t, NvmeController& out) {
+    uint8_t buf[4096] = {};
+    NvmeError err = identify(t, CNS_CONTROLLER, 0, buf);
+    if (!err.ok()) return err;
+
+    out.serial = idString(buf + 4, 20);
+    out.model = idString(buf + 24, 40);
+    out.firmware = idString(buf + 64, 8);
+    uint16_t oacs = buf[256] | buf[257] << 8;
+    out.formatSupported = oacs & (1 << 1);
+    uint8_t fna = buf[524];
+    out.formatAllNamespaces = fna & (1 << 0);
+    out.formatCryptoErase = fna & (1 << 2);
+    uint32_t sanicap = le32(buf + 328);
+    out.sanitizeCrypto = sanicap & (1 << 0);
+    out.sanitizeBlock = sanicap & (1 << 1);
+    out.sanitizeOverwrite = sanicap & (1 << 2);
+    return err;
+}
+
+NvmeError nvmeIdentifyNamespace(NvmeTransport& t, uint32_t nsid, NvmeNamespace& out) {
+    uint8_t buf[4096] = {};
+    NvmeError err = identify(t, CNS_NAMESPACE, nsid, buf);
+    if (!err.ok()) return err;
+
+    out.blocks = 0;
+    for (int i = 7; i >= 0; i--) out.blocks = out.blocks << 8 | buf[i];
+    out.formatIndex = buf[26] & 0x0f;
+    uint8_t lbads = buf[128 + 4 * out.formatIndex + 2];
+    out.blockSize = lbads ? 1u << lbads : 0;
+    return err;
+}
+
+NvmeError nvmeGetLogPage(NvmeTransport& t, uint8_t logId, uint32_t nsid,
+                         void* buf, uint32_t len) {
+    uint32_t numd = len / 4 - 1;
+    NvmeAdminCommand cmd;
+    cmd.opcode = OP_GET_LOG_PAGE;
+    cmd.nsid = nsid;
+    cmd.cdw10 = logId | (numd & 0xffff) << 16;
+    cmd.cdw11 = numd >> 16;
+    cmd.data = buf;
+    cmd.dataLen = len;
+    return t.admin(cmd);
+}
+
+NvmeError nvmeSanitizeStatus(NvmeTransport& t, SanitizeStatus& out) {
+    uint8_t buf[512] = {};
+    NvmeError err = nvmeGetLogPage(t, LOG_SANITIZE_STATUS, NSID_ALL, buf, sizeof(buf));
+    if (!err.ok()) return err;
+
+    uint16_t sstat = buf[2] | buf[3] << 8;
+    out.progress = buf[0] | buf[1] << 8;
+    out.state = sstat & 0x7;
+    out.overwritePasses = (sstat >> 3) & 0x1f;
+    out.globalDataErased = sstat & (1 << 8);
+    out.cdw10 = le32(buf + 4);
+    out.estOverwrite = le32(buf + 8);
+    out.estBlockErase = le32(buf + 12);
+    out.estCryptoErase = le32(buf + 16);
+    return err;
+}
+
+NvmeError nvmeStartSanitize(NvmeTransport& t, SanitizeAction action, uint32_t pattern) {
+    NvmeAdminCommand cmd;
+    cmd.opcode = OP_SANITIZE;
+    // SANACT bits 2:0; OWPASS bits 7:4 is one pass (0 would mean sixteen).
+    cmd.cdw10 = (uint32_t)action;
+    if (action == SanitizeAction::OVERWRITE) cmd.cdw10 |= 1 << 4;
+    cmd.cdw11 = pattern;
+    return t.admin(cmd);
+}
+
+NvmeError nvmeFormat(NvmeTransport& t, uint32_t nsid, uint8_t ses, uint8_t formatIndex) {
+    NvmeAdminCommand cmd;
+    cmd.opcode = OP_FORMAT_NVM;
+    cmd.nsid = nsid;
+    // LBAF bits 3:0, SES bits 11:9; metadata and protection settings stay 0.
+    cmd.cdw10 = (formatIndex & 0x0f) | (uint32_t)(ses & 0x7) << 9;
+    cmd.timeoutSeconds = FORMAT_TIMEOUT;
+    return t.admin(cmd);
+}
+
+NvmeError waitForSanitize(NvmeTransport& t, SanitizeAction action, WipeProgress* progress,
+                          SanitizeStatus& final, std::chrono::milliseconds interval,
+                          std::chrono::seconds timeout) {
+    if (progress) progress->start(WipePhase::ERASING, 65536);
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    for (unsigned polls = 0;; polls++) {
+        NvmeError err = nvmeSanitizeStatus(t, final);
+        if (!err.ok()) return err;
+
+        // Until the log shows our SANACT in SCDW10, a completed or failed
+        // state belongs to an earlier sanitize.
+        uint8_t state = final.state;
+        if (state != SANITIZE_IN_PROGRESS && (final.cdw10 & 0x7) != (uint32_t)action) {
+            state = SANITIZE_NEVER;
+        }
+
+        switch (state) {
+            case SANITIZE_COMPLETED:
+            case SANITIZE_COMPLETED_NO_DEALLOC:
+                if (progress) progress->set(65536);
+                return err;
+            case SANITIZE_FAILED:
+                return fail(NvmeErrorKind::FAILED, OP_SANITIZE, "sanitize status log reports failure");
+            case SANITIZE_IN_PROGRESS:
+                if (progress) progress->set(final.progress);
+                break;
+            default:
+                // The log may lag the command by a moment.
+                if (polls >= SANITIZE_START_POLLS) {
+                    return fail(NvmeErrorKind::FAILED, OP_SANITIZE, "sanitize never started");
+                }
+                break;
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return fail(NvmeErrorKind::TIMEOUT, OP_SANITIZE,
+                        "still at " + std::to_string(final.progress * 100 / 65536) + "%");
+        }
+        std::this_thread::sleep_for(interval);
+    }
+}
+
+NvmeError MockNvmeController::admin(const NvmeAdminCommand& cmd, uint32_t* result) {
+    log.push_back(cmd.opcode);
+    if (result) *result = 0;
+
+    NvmeError err;
+    err.opcode = cmd.opcode;
+    auto rejected = [&](uint16_t status) {
+        err.kind = NvmeErrorKind::STATUS;
+        err.status = status;
+        return err;
+    };
+    if (cmd.opcode == failOpcode) return rejected(failStatus);
+
+    uint8_t* buf = static_cast<uint8_t*>(cmd.data);
+    if (buf) memset(buf, 0, cmd.dataLen);
+
+    switch (cmd.opcode) {
+        case OP_IDENTIFY:
+            if (!buf || cmd.dataLen < 4096) return rejected(0x0002);
+            if ((cmd.cdw10 & 0xff) == CNS_CONTROLLER) {
+                auto put = [&](size_t off, size_t len, const std::string& s) {
+                    memset(buf + off, ' ', len);
+                    memcpy(buf + off, s.data(), std::min(len, s.size()));
+                };
+                put(4, 20, identity.serial);
+                put(24, 40, identity.model);
+                put(64, 8, identity.firmware);
+                buf[256] = identity.formatSupported ? 1 << 1 : 0;
+                buf[524] = (identity.formatAllNamespaces ? 1 << 0 : 0) |
+                           (identity.formatCryptoErase ? 1 << 2 : 0);
+                putLe32(buf + 328, (identity.sanitizeCrypto ? 1 << 0 : 0) |
+                                   (identity.sanitizeBlock ? 1 << 1 : 0) |
+                                   (identity.sanitizeOverwrite ? 1 << 2 : 0));
+            } else {
+                for (int i = 0; i < 8; i++) buf[i] = ns.blocks >> (8 * i);
+                buf[26] = ns.formatIndex;
+                uint8_t lbads = 0;
+                while (ns.blockSize >> (lbads + 1)) lbads++;
+                buf[128 + 4 * ns.formatIndex + 2] = lbads;
+            }
+            return err;
+
+        case OP_SANITIZE: {
+            auto action = (SanitizeAction)(cmd.cdw10 & 0x7);
+            bool supported = (action == SanitizeAction::CRYPTO_ERASE && identity.sanitizeCrypto) ||
+                             (action == SanitizeAction::BLOCK_ERASE && identity.sanitizeBlock) ||
+                             (action == SanitizeAction::OVERWRITE && identity.sanitizeOverwrite);
+            if (!supported) return rejected(0x0002);
+            if (status.state == SANITIZE_IN_PROGRESS) return rejected(0x011d); // Sanitize In Progress
+            status.state = SANITIZE_IN_PROGRESS;
+            status.progress = 0;
+            status.cdw10 = cmd.cdw10;
+            return err;
+        }
+
+        case OP_GET_LOG_PAGE:
+            if ((cmd.cdw10 & 0xff) != LOG_SANITIZE_STATUS || !buf || cmd.dataLen < 20) {
+                return rejected(0x0109);    // Invalid Log Page
+            }
+            if (status.state == SANITIZE_IN_PROGRESS) {
+                uint32_t next = status.progress + progressStep;
+                if (next >= 65536) {
+                    status.state = failSanitize ? SANITIZE_FAILED : SANITIZE_COMPLETED;
+                    status.progress = 0xffff;
+                    status.globalDataErased = !failSanitize;
+                } else {
+                    status.progress = next;
+                }
+            }
+            buf[0] = status.progress & 0xff;
+            buf[1] = status.progress >> 8;
+            buf[2] = status.state | (status.overwritePasses << 3);
+            buf[3] = status.globalDataErased ? 1 : 0;
+            putLe32(buf + 4, status.cdw10);
+            putLe32(buf + 8, status.estOverwrite);
+            putLe32(buf + 12, status.estBlockErase);
+            putLe32(buf + 16, status.estCryptoErase);
+            return err;
+
+        case OP_FORMAT_NVM:
+            if (!identity.formatSupported) return rejected(0x0001);   // Invalid Opcode
+            formatted = true;
+            formatSes = (cmd.cdw10 >> 9) & 0x7;
+            formatIndex = cmd.cdw10 & 0x0f;
+            formatNsid = cmd.nsid;
+            return err;
+    }
+    return rejected(0x0001);
+}
@@ -0,0 +1,58 @@
+#include "include/offload.hpp"
+#include "include/sysfs.hpp"
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+
+OffloadLimits queryOffloadLimits(const std::string& devName) {
+    std::string q = "/sys/block/" + devName + "/queue/";
+    OffloadLimits l;
+    l.writeZeroesMax = readSysfsU64(q + "write_zeroes_max_bytes");
+    l.discardMax = readSysfsU64(q + "discard_max_bytes");
+    l.discardGranularity = readSysfsU64(q + "discard_granularity");
+    return l;
+}
+
+const char* offloadOpName(OffloadOp op) {
+    return op == OffloadOp::ZEROOUT ? "BLKZEROOUT" : "BLKSECDISCARD";
+}
+
+static int issue(int fd, OffloadOp op, uint64_t offset, uint64_t len) {
+    uint64_t range[2] = { offset, len };
+    unsigned long req = op == OffloadOp::ZEROOUT ? BLKZEROOUT : BLKSECDISCARD;
+    int r;
+    do {
+        r = ioctl(fd, req, range);
+    } while (r < 0 && errno == EINTR);
+    return r < 0 ? errno : 0;
+}
+
+bool offloadRange(int fd, OffloadOp op, uint64_t offset, uint64_t length,
+                  uint64_t chunkBytes, ChunkSource* fallback, size_t blockSize,
+                  const std::function<void(uint64_t)>& onChunk) {
+    uint64_t end = offset + length;
+    bool supported = true;
+
+    for (uint64_t pos = offset; pos < end; ) {
+        uint64_t len = std::min(chunkBytes, end - pos);
+
+        int err = supported ? issue(fd, op, pos, len) : EOPNOTSUPP;
+        if (err != 0) {
+            if (supported) {
+                errno = err;
+                perror(offloadOpName(op));
+            }
+            if (err == EOPNOTSUPP || err == ENOTTY) supported = false;
+
+            if (op != OffloadOp::ZEROOUT || !fallback) return false;
+            if (!syncWriteRange(fd, pos, len, *fallback, blockSize)) return false;
+        }
+
+        if (onChunk) onChunk(len);
+        pos += len;
+    }
+    return true;
+}
@@ -0,0 +1,283 @@
+#include "include/orchestrator.hpp"
+#include <algorithm>
+#include <iostream>
+
+const char* jobStateName(JobState s) {
+    switch (s) {
+        case JobState::QUEUED:     return "queued";
+        case JobState::RUNNING:    return "running";
+        case JobState::VERIFYING:  return "verifying";
+        case JobState::CERTIFYING: return "certifying";
+        case JobState::DONE:       return "done";
+        case JobState::FAILED:     return "failed";
+    }
+    return "unknown";
+}
+
+static bool supportsMethod(const Device& dev, WipeMethod method) {
+    const auto& m = dev.supportedWipeMethods;
+    return std::find(m.begin(), m.end(), method) != m.end();
+}
+
+WipeOrchestrator::WipeOrchestrator(unsigned maxConcurrent, WipeOptions opts_, QosOptions qos,
+                                   WorkerLimits limits_)
+    : opts(opts_), limits(limits_) {
+    if (qos.mode != QosMode::OFF) {
+        bandwidth = std::make_unique<BandwidthController>(qos);
+        opts.qos = bandwidth.get();
+    }
+    maxConcurrent = std::max(1u, maxConcurrent);
+    for (unsigned i = 0; i < maxConcurrent; i++) {
+        workers.emplace_back(&WipeOrchestrator::workerLoop, this);
+    }
+}
+
+WipeOrchestrator::~WipeOrchestrator() {
+    std::vector<unsigned> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+        dropped.assign(queue.begin(), queue.end());
+        queue.clear();
+    }
+    workCv.notify_all();
+
+    for (unsigned id : dropped) setState(id, JobState::FAILED, "cancelled at shutdown");
+    for (auto& t : workers) t.join();
+}
+
+void WipeOrchestrator::onJobUpdate(JobCallback cb) {
+    std::lock_guard<std::mutex> lock(mtx);
+    callback = std::move(cb);
+}
+
+unsigned WipeOrchestrator::submit(const Device& dev, WipeMethod method) {
+    unsigned id;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping) return 0;
+
+        for (const auto& [_, j] : jobsById) {
+            bool active = j.state != JobState::DONE && j.state != JobState::FAILED;
+            if (active && j.device.path == dev.path) {
+                std::cerr << "Wipe already in progress for " << dev.path << "\n";
+                return 0;
+            }
+        }
+        if (deviceHeldByWorker(dev.path)) {
+            std::cerr << "A killed wipe worker still holds " << dev.path << "\n";
+            return 0;
+        }
+
+        id = nextId++;
+        WipeJob job = {};
+        job.id = id;
+        job.device = dev;
+        job.method = method;
+        job.state = JobState::QUEUED;
+        jobsById[id] = job;
+        progressById[id] = std::make_unique<WipeProgress>();
+        cancelById[id] = std::make_unique<std::atomic<bool>>(false);
+        queue.push_back(id);
+    }
+
+    std::cout << "[job " << id << "] " << dev.path << ": queued\n";
+    notify(id);
+    workCv.notify_one();
+    return id;
+}
+
+std::vector<unsigned> WipeOrchestrator::submit(const std::vector<Device>& devices,
+                                               WipeMethod method) {
+    std::vector<unsigned> ids;
+    for (const Device& dev : devices) {
+        unsigned id = submit(dev, method);
+        if (id) ids.push_back(id);
+    }
+    return ids;
+}
+
+std::vector<WipeJob> WipeOrchestrator::jobs() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<WipeJob> out;
+    for (const auto& [_, j] : jobsById) out.push_back(j);
+    return out;
+}
+
+bool WipeOrchestrator::job(unsigned id, WipeJob& out) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = jobsById.find(id);
+    if (it == jobsById.end()) return false;
+    out = it->second;
+    return true;
+}
+
+bool WipeOrchestrator::progress(unsigned id, ProgressSnapshot& out) const {
+    const WipeProgress* p;
+    std::shared_ptr<WipeWorker> worker;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = progressById.find(id);
+        if (it == progressById.end()) return false;
+        p = it->second.get();
+        auto w = workerById.find(id);
+        if (w != workerById.end()) worker = w->second;
+    }
+    if (worker) return worker->progress(out);
+    out = p->snapshot();
+    return true;
+}
+
+bool WipeOrchestrator::cancel(unsigned id) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = jobsById.find(id);
+        if (it == jobsById.end()) return false;
+        JobState s = it->second.state;
+        if (s == JobState::DONE || s == JobState::FAILED) return false;
+
+        cancelById[id]->store(true);
+        auto q = std::find(queue.begin(), queue.end(), id);
+        if (q == queue.end()) return true;  // running; the wipe notices
+        queue.erase(q);
+    }
+    setState(id, JobState::FAILED, "cancelled");
+    return true;
+}
+
+void WipeOrchestrator::waitIdle() {
+    std::unique_lock<std::mutex> lock(mtx);
+    idleCv.wait(lock, [this] { return queue.empty() && active == 0; });
+}
+
+void WipeOrchestrator::workerLoop() {
+    for (;;) {
+        unsigned id;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            workCv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;  // stopping
+            id = queue.front();
+            queue.pop_front();
+            active++;
+        }
+
+        runJob(id);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            active--;
+        }
+        idleCv.notify_all();
+    }
+}
+
+void WipeOrchestrator::runJob(unsigned id) {
+    WipeJob job;
+    if (!this->job(id, job)) return;
+
+    if (!supportsMethod(job.device, job.method)) {
+        setState(id, JobState::FAILED, "wipe method not supported by device");
+        return;
+    }
+
+    WipeOptions run = opts;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        run.progress = progressById[id].get();
+        run.cancel = cancelById[id].get();
+    }
+    if (run.cancel->load()) {
+        setState(id, JobState::FAILED, "cancelled");
+        return;
+    }
+    auto onPhase = [this, id](WipePhase p) {
+        if (p == WipePhase::VERIFYING) setState(id, JobState::VERIFYING);
+    };
+
+    WipeResult result;
+    std::string error;
+    if (limits.isolate) {
+        auto worker = std::make_shared<WipeWorker>();
+        if (!worker->start(job.device.path, job.method, run, error)) {
+            setState(id, JobState::FAILED, error);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            workerById[id] = worker;
+        }
+        setState(id, JobState::RUNNING);
+        result = worker->wait(limits, run.cancel, onPhase, error);
+        std::lock_guard<std::mutex> lock(mtx);
+        workerById.erase(id);
+    } else {
+        run.progress->onPhaseChange(onPhase);
+        setState(id, JobState::RUNNING);
+        result = wipeDisk(job.device.path, job.method, run);
+    }
+    result.device_model = job.device.model;
+    result.device_size = job.device.sizeBytes;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        jobsById[id].result = result;
+    }
+
+    if (result.status != WipeStatus::SUCCESS) {
+        if (error.empty()) error = result.failure;
+        if (error.empty()) error = run.cancel->load() ? "cancelled" : "wipe failed";
+        setState(id, JobState::FAILED, error);
+        return;
+    }
+
+    setState(id, JobState::CERTIFYING);
+    std::string cert = generateCertificateJSON(result);
+    std::cout << "--- WIPE CERTIFICATE ---\n" << cert << "\n------------------------" << std::endl;
+    bool recorded = false;
+    try {
+        auto payload = makeChainRequest(sha256(cert), deviceIdentityHash(result),
+                                        static_cast<uint8_t>(result.method));
+        recorded = recordWipeViaHelper(payload);
+    } catch (const std::exception& e) {
+        std::cerr << "[job " << id << "] certificate recording failed: " << e.what() << "\n";
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        jobsById[id].certificate = cert;
+        jobsById[id].certRecorded = recorded;
+    }
+    setState(id, JobState::DONE);
+}
+
+void WipeOrchestrator::setState(unsigned id, JobState s, const std::string& error) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = jobsById.find(id);
+        if (it == jobsById.end()) return;
+        it->second.state = s;
+        it->second.error = error;
+        path = it->second.device.path;
+    }
+
+    std::cout << "[job " << id << "] " << path << ": " << jobStateName(s);
+    if (!error.empty()) std::cout << " (" << error << ")";
+    std::cout << std::endl;
+    notify(id);
+}
+
+void WipeOrchestrator::notify(unsigned id) {
+    JobCallback cb;
+    WipeJob snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!callback) return;
+        auto it = jobsById.find(id);
+        if (it == jobsById.end()) return;
+        cb = callback;
+        snapshot = it->second;
+    }
+    cb(snapshot);
+}
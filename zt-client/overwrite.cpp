@@ -0,0 +1,54 @@
+#include "include/overwrite.hpp"
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+ZeroSource::ZeroSource(char* buf_, size_t size_) : buf(buf_), size(size_) {
+    memset(buf, 0, size);
+}
+
+std::vector<iovec> ZeroSource::buffers() {
+    return { iovec{ buf, size } };
+}
+
+WriteChunk ZeroSource::acquire(uint64_t offset, size_t len) {
+    (void)offset;
+    return { buf, std::min(len, size), 0 };
+}
+
+bool syncWriteRange(int fd, uint64_t offset, uint64_t length,
+                    ChunkSource& src, size_t blockSize,
+                    WipeProgress* progress) {
+    uint64_t end = offset + length;
+    uint64_t pos = offset;
+
+    while (pos < end) {
+        size_t toWrite = std::min<uint64_t>(blockSize, end - pos);
+        WriteChunk chunk = src.acquire(pos, toWrite);
+
+        size_t done = 0;
+        while (done < chunk.len) {
+            ssize_t w = pwrite(fd, chunk.data + done, chunk.len - done, pos + done);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                perror("write");
+                src.release(chunk);
+                return false;
+            }
+            if (w == 0) {
+                fprintf(stderr, "write: device stopped accepting data at %llu\n",
+                        (unsigned long long)(pos + done));
+                src.release(chunk);
+                return false;
+            }
+            done += w;
+        }
+
+        src.release(chunk);
+        pos += chunk.len;
+        if (progress) progress->add(chunk.len);
+    }
+    return true;
+}
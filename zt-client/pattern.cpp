@@ -0,0 +1,250 @@
+#include "include/pattern.hpp"
+#include "include/simd.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+bool PassPattern::isZero() const {
+    if (kind != CONSTANT) return false;
+    for (size_t i = 0; i < width; i++) {
+        if (unit[i] != 0) return false;
+    }
+    return true;
+}
+
+std::string PassPattern::describe() const {
+    if (kind == RANDOM) return "random";
+    std::string s = "0x";
+    char hex[3];
+    for (size_t i = 0; i < width; i++) {
+        snprintf(hex, sizeof(hex), "%02x", unit[i]);
+        s += hex;
+    }
+    return s;
+}
+
+bool WipeScheme::hasRandom() const {
+    return std::any_of(passes.begin(), passes.end(),
+                       [](const PassPattern& p) { return p.kind == PassPattern::RANDOM; });
+}
+
+bool WipeScheme::allZero() const {
+    return std::all_of(passes.begin(), passes.end(),
+                       [](const PassPattern& p) { return p.isZero(); });
+}
+
+static PassPattern constant(uint8_t b) {
+    PassPattern p;
+    p.unit[0] = b;
+    return p;
+}
+
+static PassPattern randomPass() {
+    PassPattern p;
+    p.kind = PassPattern::RANDOM;
+    return p;
+}
+
+static PassPattern complement(const PassPattern& p) {
+    PassPattern c = p;
+    for (size_t i = 0; i < c.width; i++) c.unit[i] = ~c.unit[i];
+    return c;
+}
+
+static bool builtinScheme(const std::string& name, WipeScheme& out) {
+    out = WipeScheme{};
+    out.name = name;
+    if (name == "zero") {
+        out.passes = { constant(0), constant(0), constant(0) };
+    } else if (name == "random") {
+        out.passes = { randomPass(), randomPass(), randomPass() };
+    } else if (name == "nist-clear") {
+        out.passes = { constant(0) };
+        out.verifyLastPass = true;
+    } else if (name == "dod-3pass") {
+        out.passes = { constant(0), complement(constant(0)), randomPass() };
+        out.verifyLastPass = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> builtinSchemeNames() {
+    return { "zero", "random", "nist-clear", "dod-3pass" };
+}
+
+static bool parseUnit(const std::string& tok, PassPattern& out) {
+    std::string hex = tok;
+    if (hex.rfind("0x", 0) == 0 || hex.rfind("0X", 0) == 0) hex = hex.substr(2);
+    size_t width = hex.size() / 2;
+    if (hex.size() % 2 || (width != 1 && width != 2 && width != 4 && width != 8)) return false;
+
+    PassPattern p;
+    p.width = width;
+    for (size_t i = 0; i < width; i++) {
+        char* end = nullptr;
+        std::string byte = hex.substr(i * 2, 2);
+        unsigned long v = strtoul(byte.c_str(), &end, 16);
+        if (*end) return false;
+        p.unit[i] = (uint8_t)v;
+    }
+    out = p;
+    return true;
+}
+
+bool parseScheme(const std::string& spec, WipeScheme& out, std::string& error) {
+    if (builtinScheme(spec, out)) return true;
+
+    WipeScheme s;
+    s.name = spec;
+    std::stringstream ss(spec);
+    std::string tok;
+    while (std::getline(ss, tok, ',')) {
+        if (tok == "verify") {
+            s.verifyLastPass = true;
+        } else if (tok == "random") {
+            s.passes.push_back(randomPass());
+        } else if (tok == "~") {
+            auto prev = std::find_if(s.passes.rbegin(), s.passes.rend(),
+                [](const PassPattern& p) { return p.kind == PassPattern::CONSTANT; });
+            if (prev == s.passes.rend()) {
+                error = "'~' needs an earlier constant pass";
+                return false;
+            }
+            s.passes.push_back(complement(*prev));
+        } else {
+            PassPattern p;
+            if (!parseUnit(tok, p)) {
+                error = "bad pass '" + tok + "': expected 1, 2, 4 or 8 hex bytes, 'random' or '~'";
+                return false;
+            }
+            s.passes.push_back(p);
+        }
+    }
+    if (s.passes.empty()) {
+        error = "scheme '" + spec + "' has no passes";
+        return false;
+    }
+    out = s;
+    return true;
+}
+
+// One kernel per unit width: the unit is widened to a 64-bit word once and
+// stored eight bytes at a time, which the compiler turns into vector stores.
+template <size_t W>
+static void fillUnit(char* dst, size_t len, uint64_t offset, const uint8_t* unit) {
+    static_assert(W == 1 || W == 2 || W == 4 || W == 8, "unit must divide 8");
+    uint8_t phased[8];
+    for (size_t i = 0; i < 8; i++) phased[i] = unit[(offset + i) % W];
+
+    if constexpr (W == 1) {
+        memset(dst, unit[0], len);
+    } else {
+        uint64_t word;
+        memcpy(&word, phased, 8);
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) memcpy(dst + i, &word, 8);
+        for (; i < len; i++) dst[i] = (char)phased[i % 8];
+    }
+}
+
+void fillPattern(char* dst, size_t len, uint64_t offset, const PassPattern& p) {
+    switch (p.width) {
+        case 1: fillUnit<1>(dst, len, offset, p.unit.data()); break;
+        case 2: fillUnit<2>(dst, len, offset, p.unit.data()); break;
+        case 4: fillUnit<4>(dst, len, offset, p.unit.data()); break;
+        case 8: fillUnit<8>(dst, len, offset, p.unit.data()); break;
+    }
+}
+
+PatternChecker::PatternChecker(const PassPattern& p, size_t blockSize)
+    : pattern(p) {
+    if (pattern.width > 1) {
+        expected.resize(blockSize + pattern.width);
+        fillPattern(expected.data(), expected.size(), 0, pattern);
+    }
+}
+
+bool PatternChecker::check(uint64_t offset, const char* data, size_t len) {
+    if (pattern.width == 1) return findMismatch(data, len, pattern.unit[0]) == len;
+    // The reference block starts at phase 0; skip into it to match offset.
+    size_t phase = offset % pattern.width;
+    const char* ref = expected.data() + phase;
+    for (size_t done = 0; done < len; ) {
+        size_t n = std::min(len - done, expected.size() - pattern.width);
+        if (memcmp(data + done, ref, n) != 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+SchemeSource::SchemeSource(const WipeScheme& scheme_, char* patternBuf_, size_t blockSize_,
+                           std::unique_ptr<KeystreamSource> random_)
+    : scheme(scheme_), patternBuf(patternBuf_), blockSize(blockSize_),
+      random(std::move(random_)) {}
+
+// Index 0 is the pattern buffer; keystream buffers follow it.
+std::vector<iovec> SchemeSource::buffers() {
+    std::vector<iovec> v = { iovec{ patternBuf, blockSize } };
+    if (random) {
+        std::vector<iovec> r = random->buffers();
+        v.insert(v.end(), r.begin(), r.end());
+    }
+    return v;
+}
+
+size_t SchemeSource::maxInFlight() const {
+    return random ? random->maxInFlight() : SIZE_MAX;
+}
+
+bool SchemeSource::healthy() const {
+    return !random || random->healthy();
+}
+
+void SchemeSource::begin(unsigned pass, uint64_t offset, uint64_t length) {
+    const PassPattern& p = scheme.passes[pass];
+    randomPass = p.kind == PassPattern::RANDOM;
+    if (randomPass) {
+        random->begin(pass, offset, length);
+    } else {
+        // Requests are aligned to at least a page, so every chunk starts at
+        // phase 0 and one buffer serves the whole pass.
+        fillPattern(patternBuf, blockSize, 0, p);
+    }
+}
+
+WriteChunk SchemeSource::acquire(uint64_t offset, size_t len) {
+    if (!randomPass) return { patternBuf, std::min(len, blockSize), 0 };
+    WriteChunk c = random->acquire(offset, len);
+    c.bufIndex += 1;
+    return c;
+}
+
+void SchemeSource::release(const WriteChunk& chunk) {
+    if (!randomPass) return;
+    WriteChunk c = chunk;
+    c.bufIndex -= 1;
+    random->release(c);
+}
+
+std::unique_ptr<ChunkSource> makeSchemeSource(BufferArena& arena, size_t blockSize,
+                                              const WipeScheme& scheme,
+                                              const KeystreamKey& key,
+                                              unsigned slots, unsigned threads) {
+    char* patternBuf = arena.allocate(blockSize);
+    if (!patternBuf) return nullptr;
+
+    std::unique_ptr<KeystreamSource> random;
+    if (scheme.hasRandom()) {
+        std::vector<char*> bufs;
+        for (unsigned i = 0; i < slots; i++) {
+            char* b = arena.allocate(blockSize);
+            if (!b) return nullptr;
+            bufs.push_back(b);
+        }
+        random = std::make_unique<KeystreamSource>(key, std::move(bufs), blockSize, threads);
+    }
+    return std::make_unique<SchemeSource>(scheme, patternBuf, blockSize, std::move(random));
+}
@@ -0,0 +1,185 @@
+#include "include/planner.hpp"
+#include "include/sysfs.hpp"
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+static constexpr size_t DEFAULT_REQUEST = 1024 * 1024;
+static constexpr size_t LARGE_REQUEST = 4 * 1024 * 1024;
+static constexpr size_t MAX_REQUEST = 16 * 1024 * 1024;
+static constexpr unsigned MAX_QUEUE_DEPTH = 64;
+
+QueueLimits readQueueLimits(int fd, const std::string& devName) {
+    QueueLimits l;
+    int lbs = 0;
+    unsigned int pbs = 0;
+    if (ioctl(fd, BLKSSZGET, &lbs) == 0 && lbs > 0) l.logicalBlock = lbs;
+    if (ioctl(fd, BLKPBSZGET, &pbs) == 0 && pbs > 0) l.physicalBlock = pbs;
+
+    std::string q = "/sys/block/" + devName + "/queue/";
+    l.minimumIo = readSysfsU64(q + "minimum_io_size");
+    l.optimalIo = readSysfsU64(q + "optimal_io_size");
+    l.maxRequest = readSysfsU64(q + "max_sectors_kb") * 1024;
+    l.dmaAlignment = (uint32_t)readSysfsU64(q + "dma_alignment", 511);
+    l.nrRequests = (unsigned)readSysfsU64(q + "nr_requests");
+    l.rotational = readSysfsU64(q + "rotational") == 1;
+    l.removable = readSysfsU64("/sys/block/" + devName + "/removable") == 1;
+    l.hwQueues = hardwareQueueCount(devName);
+    return l;
+}
+
+static size_t roundUp(size_t v, size_t to) {
+    return (v + to - 1) / to * to;
+}
+
+// Largest request worth issuing: MAX_REQUEST, or less when max_sectors_kb
+// would split it anyway. Always a whole number of `alignment` units, which
+// are themselves whole logical blocks.
+static size_t requestCeiling(const QueueLimits& l, size_t alignment) {
+    size_t ceiling = roundUp(MAX_REQUEST, alignment);
+    if (l.maxRequest) {
+        size_t limit = std::max<size_t>(l.maxRequest / alignment * alignment, alignment);
+        ceiling = std::min(ceiling, limit);
+    }
+    return ceiling;
+}
+
+IoPlan planIo(const QueueLimits& l, size_t requestSize, unsigned queueDepth) {
+    IoPlan p;
+    p.limits = l;
+    std::ostringstream why;
+
+    // Writing less than a physical block makes the drive read-modify-write.
+    p.alignment = std::max<size_t>({ l.logicalBlock, l.physicalBlock,
+                                     (size_t)l.dmaAlignment + 1, 4096 });
+
+    if (requestSize) {
+        p.requestSize = roundUp(requestSize, p.alignment);
+        why << "request size set by caller";
+    } else if (l.optimalIo >= p.alignment && l.optimalIo % p.alignment == 0) {
+        // Whole stripes of a RAID or similar, at least DEFAULT_REQUEST.
+        p.requestSize = l.optimalIo * ((DEFAULT_REQUEST + l.optimalIo - 1) / l.optimalIo);
+        why << "whole optimal_io_size units";
+    } else if (l.rotational) {
+        p.requestSize = LARGE_REQUEST;
+        why << "rotational, long sequential writes";
+    } else if (l.removable) {
+        // USB sticks and SD cards erase in multi-MiB blocks; anything
+        // smaller costs them a read-modify-write of the whole block.
+        p.requestSize = LARGE_REQUEST;
+        why << "removable flash, erase-block sized writes";
+    } else {
+        p.requestSize = DEFAULT_REQUEST;
+        why << "default request size";
+    }
+
+    // A caller's size is only aligned; a chosen one also stays within
+    // what the block layer will pass down unsplit.
+    size_t ceiling = requestSize ? roundUp(MAX_REQUEST, p.alignment) : requestCeiling(l, p.alignment);
+    p.requestSize = roundUp(p.requestSize, p.alignment);
+    if (p.requestSize > ceiling) {
+        p.requestSize = ceiling;
+        if (!requestSize) why << ", capped at " << ceiling / 1024 << " KiB";
+    }
+
+    if (queueDepth) {
+        p.queueDepth = queueDepth;
+        why << "; queue depth set by caller";
+    } else if (l.rotational || l.removable) {
+        p.queueDepth = 4;
+        why << "; shallow queue, the device works one request at a time";
+    } else if (l.hwQueues > 1) {
+        p.queueDepth = 32;
+        why << "; multi-queue device";
+    } else {
+        p.queueDepth = l.nrRequests ? std::clamp(l.nrRequests / 2, 2u, 32u) : 32;
+        why << "; single-queue device, half of nr_requests";
+    }
+    if (l.nrRequests) p.queueDepth = std::min(p.queueDepth, l.nrRequests);
+    p.queueDepth = std::clamp(p.queueDepth, 1u, MAX_QUEUE_DEPTH);
+
+    p.reason = why.str();
+    return p;
+}
+
+// Seconds to write `total` bytes in `request` pieces from offset 0, or a
+// negative value on error.
+static double timeWrites(int fd, const char* buf, size_t request, uint64_t total) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint64_t off = 0; off < total; ) {
+        size_t len = (size_t)std::min<uint64_t>(request, total - off);
+        ssize_t w = pwrite(fd, buf, len, off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        off += w;
+    }
+    if (fdatasync(fd) < 0) return -1;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void calibrateIo(int fd, uint64_t deviceSize, IoPlan& plan, uint64_t budgetBytes) {
+    size_t largest = requestCeiling(plan.limits, plan.alignment);
+    void* mem = nullptr;
+    if (posix_memalign(&mem, plan.alignment, largest) != 0) return;
+    memset(mem, 0, largest);
+    const char* buf = static_cast<const char*>(mem);
+
+    uint64_t total = std::min(budgetBytes, deviceSize / plan.alignment * plan.alignment);
+    size_t bestSize = 0;
+    double bestRate = 0;
+    struct Result { size_t size; double rate; };
+    Result results[16];
+    int n = 0;
+
+    for (size_t size = std::max<size_t>(64 * 1024, plan.alignment);
+         size <= largest && n < 16; size *= 2) {
+        if (size % plan.alignment) continue;
+        double secs = timeWrites(fd, buf, size, total);
+        if (secs <= 0) continue;
+        double rate = total / secs;
+        results[n++] = { size, rate };
+        if (rate > bestRate) {
+            bestRate = rate;
+            bestSize = size;
+        }
+    }
+    free(mem);
+    if (!bestSize) return;
+
+    for (int i = 0; i < n; i++) {
+        if (results[i].rate >= bestRate * 0.95) {
+            bestSize = results[i].size;
+            break;
+        }
+    }
+
+    std::ostringstream why;
+    why << plan.reason << "; calibrated knee at " << bestSize / 1024 << " KiB ("
+        << (unsigned)(bestRate / 1e6) << " MB/s peak)";
+    plan.requestSize = bestSize;
+    plan.calibrated = true;
+    plan.reason = why.str();
+}
+
+static std::string formatBytes(uint64_t b) {
+    std::ostringstream s;
+    if (b >= 1024 * 1024 && b % (1024 * 1024) == 0) s << b / (1024 * 1024) << " MiB";
+    else if (b >= 1024 && b % 1024 == 0) s << b / 1024 << " KiB";
+    else s << b << " B";
+    return s.str();
+}
+
+std::string describePlan(const IoPlan& p) {
+    std::ostringstream s;
+    s << "request " << formatBytes(p.requestSize)
+      << ", align " << formatBytes(p.alignment)
+      << ", qd " << p.queueDepth
+      << " (" << p.reason << ")";
+    return s.str();
+}
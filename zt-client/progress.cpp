@@ -0,0 +1,110 @@
+#include "include/progress.hpp"
+#include <time.h>
+#include <algorithm>
+
+const char* wipePhaseName(WipePhase p) {
+    switch (p) {
+        case WipePhase::IDLE:      return "idle";
+        case WipePhase::WRITING:   return "writing";
+        case WipePhase::ERASING:   return "erasing";
+        case WipePhase::FLUSHING:  return "flushing";
+        case WipePhase::VERIFYING: return "verifying";
+        case WipePhase::DONE:      return "done";
+        case WipePhase::FAILED:    return "failed";
+    }
+    return "unknown";
+}
+
+static uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void WipeProgress::start(WipePhase p, uint64_t total_, unsigned passes_,
+                         uint64_t alreadyDone) {
+    uint64_t now = nowNs();
+    done.store(alreadyDone, std::memory_order_relaxed);
+    baseline.store(alreadyDone, std::memory_order_relaxed);
+    total.store(total_, std::memory_order_relaxed);
+    passes.store(passes_, std::memory_order_relaxed);
+    pass.store(0, std::memory_order_relaxed);
+    rate.store(0, std::memory_order_relaxed);
+    windowBytes.store(alreadyDone, std::memory_order_relaxed);
+    windowNs.store(now, std::memory_order_relaxed);
+    lastByteNs.store(now, std::memory_order_relaxed);
+    startNs.store(now, std::memory_order_release);
+    setPhase(p);
+}
+
+void WipeProgress::setPhase(WipePhase p) {
+    if (phase.exchange((int)p, std::memory_order_release) != (int)p && phaseCb) phaseCb(p);
+}
+
+void WipeProgress::setPass(unsigned p) {
+    pass.store(p, std::memory_order_relaxed);
+}
+
+void WipeProgress::add(uint64_t bytes) {
+    uint64_t d = done.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    tick(nowNs(), d);
+}
+
+void WipeProgress::set(uint64_t bytes) {
+    done.store(bytes, std::memory_order_relaxed);
+    tick(nowNs(), bytes);
+}
+
+void WipeProgress::tick(uint64_t now, uint64_t d) {
+    lastByteNs.store(now, std::memory_order_relaxed);
+
+    // `now` was read before the load, so another thread may already have
+    // moved the window past it; signed, that age is negative and skipped.
+    uint64_t opened = windowNs.load(std::memory_order_relaxed);
+    if ((int64_t)(now - opened) < RATE_WINDOW_MS * 1000000) return;
+    // Only the thread that moves the window updates the rate.
+    if (!windowNs.compare_exchange_strong(opened, now, std::memory_order_acq_rel)) return;
+
+    uint64_t prev = windowBytes.exchange(d, std::memory_order_relaxed);
+    double window = (double)(d > prev ? d - prev : 0) / ((now - opened) / 1e9);
+    double old = rate.load(std::memory_order_relaxed);
+    // EWMA over roughly the last few seconds.
+    rate.store(old == 0 ? window : old * 0.7 + window * 0.3, std::memory_order_relaxed);
+}
+
+ProgressSnapshot WipeProgress::snapshot() const {
+    ProgressSnapshot s;
+    uint64_t now = nowNs();
+    uint64_t started = startNs.load(std::memory_order_acquire);
+
+    s.phase = (WipePhase)phase.load(std::memory_order_acquire);
+    s.pass = pass.load(std::memory_order_relaxed);
+    s.passes = passes.load(std::memory_order_relaxed);
+    s.bytesDone = done.load(std::memory_order_relaxed);
+    s.bytesTotal = total.load(std::memory_order_relaxed);
+    s.elapsedSeconds = started && now > started ? (now - started) / 1e9 : 0;
+    uint64_t base = baseline.load(std::memory_order_relaxed);
+    uint64_t fresh = s.bytesDone > base ? s.bytesDone - base : 0;
+    s.averageRate = s.elapsedSeconds > 0 ? fresh / s.elapsedSeconds : 0;
+
+    // With no writes completing no producer ticks, so a stalled device
+    // would keep its last rate. Measure the open window directly once it
+    // has run well past its length.
+    uint64_t opened = windowNs.load(std::memory_order_relaxed);
+    s.currentRate = rate.load(std::memory_order_relaxed);
+    if (started && (int64_t)(now - opened) > 2 * RATE_WINDOW_MS * 1000000) {
+        uint64_t since = windowBytes.load(std::memory_order_relaxed);
+        uint64_t delta = s.bytesDone > since ? s.bytesDone - since : 0;
+        s.currentRate = std::min(s.currentRate, delta / ((now - opened) / 1e9));
+    }
+
+    uint64_t last = lastByteNs.load(std::memory_order_relaxed);
+    s.idleSeconds = started && now > last ? (now - last) / 1e9 : 0;
+
+    s.etaSeconds = -1;
+    if (s.bytesTotal && s.currentRate > 0) {
+        uint64_t left = s.bytesTotal > s.bytesDone ? s.bytesTotal - s.bytesDone : 0;
+        s.etaSeconds = left / s.currentRate;
+    }
+    return s;
+}
@@ -0,0 +1,251 @@
+#include "include/qos.hpp"
+#include "include/sysfs.hpp"
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+static constexpr auto REBALANCE_INTERVAL = std::chrono::milliseconds(500);
+static constexpr double BURST_SECONDS = 0.25;
+static constexpr uint64_t MIN_BURST = 4 * 1024 * 1024;
+static constexpr uint64_t MIN_RATE = 1024 * 1024;  // never starve a device completely
+
+TokenBucket::TokenBucket(uint64_t rate) : last(std::chrono::steady_clock::now()) {
+    setRate(rate);
+}
+
+void TokenBucket::refill(std::chrono::steady_clock::time_point now) {
+    double dt = std::chrono::duration<double>(now - last).count();
+    last = now;
+    tokens = std::min(burst, tokens + dt * bytesPerSec);
+}
+
+void TokenBucket::setRate(uint64_t rate) {
+    std::lock_guard<std::mutex> lock(mtx);
+    refill(std::chrono::steady_clock::now());
+    bytesPerSec = rate;
+    burst = std::max<double>(MIN_BURST, rate * BURST_SECONDS);
+    tokens = std::min(tokens, burst);
+}
+
+uint64_t TokenBucket::rate() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return bytesPerSec;
+}
+
+bool TokenBucket::consume(uint64_t bytes) {
+    double wait = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (bytesPerSec == 0) return false;
+        refill(std::chrono::steady_clock::now());
+        tokens -= bytes;
+        if (tokens < 0) wait = -tokens / bytesPerSec;
+    }
+    if (wait <= 0) return false;
+    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    return true;
+}
+
+DeviceThrottle::DeviceThrottle(BandwidthController& owner_, const std::string& devicePath,
+                               uint64_t remaining_, double weight_)
+    : owner(owner_), path(devicePath), weight(weight_), remaining(remaining_) {}
+
+DeviceThrottle::~DeviceThrottle() {
+    owner.detach(this);
+}
+
+void DeviceThrottle::consume(uint64_t bytes) {
+    consumed += bytes;
+    uint64_t r = remaining;
+    remaining = r > bytes ? r - bytes : 0;
+    if (!viaCgroup && bucket.consume(bytes)) throttled = true;
+}
+
+uint64_t DeviceThrottle::account(uint64_t bytes, bool waited) {
+    consumed += bytes;
+    uint64_t r = remaining;
+    remaining = r > bytes ? r - bytes : 0;
+    if (waited) throttled = true;
+    return viaCgroup ? 0 : allocated.load();
+}
+
+std::string ownIoCgroup() {
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+        // cgroup v2 is the "0::<path>" entry.
+        if (line.rfind("0::", 0) != 0) continue;
+        std::string dir = "/sys/fs/cgroup" + line.substr(3);
+        if (access((dir + "/io.max").c_str(), W_OK) == 0) return dir;
+    }
+    return "";
+}
+
+std::string diskDevNumber(const std::string& devicePath) {
+    std::string base = "/sys/class/block/" + blockDeviceName(devicePath);
+    if (access((base + "/partition").c_str(), F_OK) == 0) {
+        return readSysfsLine(base + "/../dev");
+    }
+    return readSysfsLine(base + "/dev");
+}
+
+bool setIoMax(const std::string& cgroupDir, const std::string& devno, uint64_t wbps) {
+    std::ofstream out(cgroupDir + "/io.max");
+    if (!out) return false;
+    out << devno << " wbps=" << (wbps ? std::to_string(wbps) : "max") << "\n";
+    out.flush();
+    return out.good();
+}
+
+BandwidthController::BandwidthController(const QosOptions& opts_) : opts(opts_) {
+    if (opts.mode == QosMode::OFF) return;
+
+    if (opts.useCgroup) {
+        cgroupDir = ownIoCgroup();
+        if (cgroupDir.empty()) {
+            std::cerr << "cgroup v2 io.max not writable for this process, "
+                         "using token buckets\n";
+        }
+    }
+    rebalancer = std::thread(&BandwidthController::rebalanceLoop, this);
+}
+
+BandwidthController::~BandwidthController() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (rebalancer.joinable()) rebalancer.join();
+}
+
+std::unique_ptr<DeviceThrottle> BandwidthController::attach(const std::string& devicePath,
+                                                            uint64_t remaining, double weight) {
+    std::unique_ptr<DeviceThrottle> t(new DeviceThrottle(*this, devicePath, remaining, weight));
+    if (opts.mode == QosMode::OFF) return t;
+
+    if (!cgroupDir.empty()) {
+        t->devno = diskDevNumber(devicePath);
+        // Probe with "no limit" so a device io.max refuses falls back early.
+        t->viaCgroup = !t->devno.empty() && setIoMax(cgroupDir, t->devno, 0);
+        if (!t->viaCgroup) {
+            std::cerr << "io.max rejected " << devicePath << ", using a token bucket\n";
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    devices.push_back(t.get());
+    rebalance(0);
+    return t;
+}
+
+void BandwidthController::detach(DeviceThrottle* t) {
+    if (opts.mode == QosMode::OFF) return;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = std::find(devices.begin(), devices.end(), t);
+    if (it == devices.end()) return;
+    devices.erase(it);
+    if (t->viaCgroup) setIoMax(cgroupDir, t->devno, 0);
+    rebalance(0);
+}
+
+void BandwidthController::apply(DeviceThrottle& t, uint64_t rate) {
+    if (t.allocated == rate) return;
+    t.allocated = rate;
+    if (t.viaCgroup) {
+        if (!setIoMax(cgroupDir, t.devno, rate)) {
+            std::cerr << "Failed to update io.max for " << t.path << ": "
+                      << strerror(errno) << "\n";
+        }
+    } else {
+        t.bucket.setRate(rate);
+    }
+}
+
+void BandwidthController::rebalanceLoop() {
+    std::unique_lock<std::mutex> lock(mtx);
+    auto last = std::chrono::steady_clock::now();
+    while (!cv.wait_for(lock, REBALANCE_INTERVAL, [this] { return stopping; })) {
+        auto now = std::chrono::steady_clock::now();
+        rebalance(std::chrono::duration<double>(now - last).count());
+        last = now;
+    }
+}
+
+// Weighted max-min water-filling. `intervalSeconds` is the time since the
+// last measurement, 0 when rebalancing because the device set changed.
+void BandwidthController::rebalance(double intervalSeconds) {
+    const double unlimited = std::numeric_limits<double>::infinity();
+    double deviceCap = opts.deviceLimit ? (double)opts.deviceLimit : unlimited;
+
+    struct Share {
+        DeviceThrottle* t;
+        double weight;
+        double cap;
+        double rate;
+    };
+    std::vector<Share> shares;
+
+    for (DeviceThrottle* t : devices) {
+        // A device whose writers never had to wait for tokens is limited by
+        // itself; give it some headroom above what it managed so it can
+        // speed up again, and hand the rest to the others. io.max does not
+        // say whether it throttled, so there the rate is compared with the
+        // allocation instead.
+        if (intervalSeconds > 0) {
+            uint64_t now = t->consumed;
+            double measured = (now - t->lastConsumed) / intervalSeconds;
+            t->lastConsumed = now;
+            uint64_t alloc = t->allocated;
+            bool throttled = t->viaCgroup ? measured >= 0.9 * alloc : t->throttled.exchange(false);
+            t->demand = alloc && !throttled ? std::max<double>(MIN_RATE, measured * 1.25) : 0;
+        }
+
+        double w = 1;
+        if (opts.mode == QosMode::WEIGHTED) {
+            w = t->weight > 0 ? t->weight : std::max<double>(1, t->remaining);
+        }
+        double cap = t->demand > 0 ? std::min(deviceCap, t->demand) : deviceCap;
+        shares.push_back({ t, w, cap, cap });
+    }
+
+    if (opts.globalLimit) {
+        double left = opts.globalLimit;
+        std::vector<Share*> open;
+        for (Share& s : shares) open.push_back(&s);
+
+        // Devices whose cap is below their share take only the cap; repeat
+        // until everyone left can use what they are offered.
+        while (!open.empty()) {
+            double total = 0;
+            for (Share* s : open) total += s->weight;
+
+            std::vector<Share*> next;
+            double capped = 0;
+            for (Share* s : open) {
+                if (s->cap < left * s->weight / total) {
+                    s->rate = s->cap;
+                    capped += s->cap;
+                } else {
+                    next.push_back(s);
+                }
+            }
+            if (next.size() == open.size()) {
+                for (Share* s : open) s->rate = left * s->weight / total;
+                break;
+            }
+            left -= capped;
+            open.swap(next);
+        }
+    }
+
+    for (Share& s : shares) {
+        uint64_t rate = s.rate == unlimited ? 0 : std::max<uint64_t>(MIN_RATE, (uint64_t)s.rate);
+        apply(*s.t, rate);
+    }
+}
@@ -0,0 +1,121 @@
+#include "include/simd.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ZT_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ZT_NEON 1
+#endif
+
+using ScanFn = size_t (*)(const char*, size_t, uint8_t);
+
+static size_t scanScalar(const char* d, size_t len, uint8_t v) {
+    const uint64_t pat = 0x0101010101010101ULL * v;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, d + i, 8);
+        if (w != pat) break;
+    }
+    for (; i < len; i++) {
+        if ((uint8_t)d[i] != v) return i;
+    }
+    return len;
+}
+
+#ifdef ZT_X86
+__attribute__((target("avx2")))
+static size_t scanAvx2(const char* d, size_t len, uint8_t v) {
+    const __m256i pat = _mm256_set1_epi8((char)v);
+    size_t i = 0;
+
+    // Fast path: OR together four XORed vectors and test once per 128 bytes.
+    for (; i + 128 <= len; i += 128) {
+        __m256i a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(d + i)), pat);
+        __m256i b = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(d + i + 32)), pat);
+        __m256i c = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(d + i + 64)), pat);
+        __m256i e = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(d + i + 96)), pat);
+        __m256i x = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, e));
+        if (!_mm256_testz_si256(x, x)) break;
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(d + i));
+        unsigned eq = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, pat));
+        if (eq != 0xffffffffu) return i + __builtin_ctz(~eq);
+    }
+    return i + scanScalar(d + i, len - i, v);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scanAvx512(const char* d, size_t len, uint8_t v) {
+    const __m512i pat = _mm512_set1_epi8((char)v);
+    size_t i = 0;
+
+    for (; i + 256 <= len; i += 256) {
+        __m512i a = _mm512_xor_si512(_mm512_loadu_si512(d + i), pat);
+        __m512i b = _mm512_xor_si512(_mm512_loadu_si512(d + i + 64), pat);
+        __m512i c = _mm512_xor_si512(_mm512_loadu_si512(d + i + 128), pat);
+        __m512i e = _mm512_xor_si512(_mm512_loadu_si512(d + i + 192), pat);
+        __m512i x = _mm512_or_si512(_mm512_or_si512(a, b), _mm512_or_si512(c, e));
+        if (_mm512_test_epi64_mask(x, x)) break;
+    }
+    for (; i + 64 <= len; i += 64) {
+        __mmask64 ne = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(d + i), pat);
+        if (ne) return i + __builtin_ctzll(ne);
+    }
+    return i + scanScalar(d + i, len - i, v);
+}
+#endif
+
+#ifdef ZT_NEON
+static size_t scanNeon(const char* d, size_t len, uint8_t v) {
+    const uint8x16_t pat = vdupq_n_u8(v);
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(d);
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        uint8x16_t a = vceqq_u8(vld1q_u8(p + i), pat);
+        uint8x16_t b = vceqq_u8(vld1q_u8(p + i + 16), pat);
+        uint8x16_t c = vceqq_u8(vld1q_u8(p + i + 32), pat);
+        uint8x16_t e = vceqq_u8(vld1q_u8(p + i + 48), pat);
+        uint8x16_t all = vandq_u8(vandq_u8(a, b), vandq_u8(c, e));
+        if (vminvq_u8(all) != 0xff) break;
+    }
+    for (; i + 16 <= len; i += 16) {
+        if (vminvq_u8(vceqq_u8(vld1q_u8(p + i), pat)) != 0xff) break;
+    }
+    return i + scanScalar(d + i, len - i, v);
+}
+#endif
+
+struct Kernel {
+    ScanFn      fn;
+    const char* name;
+};
+
+static Kernel selectKernel() {
+#ifdef ZT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) return { scanAvx512, "avx512bw" };
+    if (__builtin_cpu_supports("avx2")) return { scanAvx2, "avx2" };
+#endif
+#ifdef ZT_NEON
+    return { scanNeon, "neon" };
+#endif
+    return { scanScalar, "scalar" };
+}
+
+static const Kernel& kernel() {
+    static const Kernel k = selectKernel();
+    return k;
+}
+
+size_t findMismatch(const char* data, size_t len, uint8_t value) {
+    return kernel().fn(data, len, value);
+}
+
+const char* simdKernelName() {
+    return kernel().name;
+}
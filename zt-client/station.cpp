@@ -0,0 +1,336 @@
+#include "include/station.hpp"
+#include "include/sysfs.hpp"
+#include <fnmatch.h>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+static bool contains(const std::vector<std::string>& list, const std::string& v) {
+    return std::find(list.begin(), list.end(), v) != list.end();
+}
+
+static bool supportsMethod(const Device& dev, WipeMethod method) {
+    const auto& m = dev.supportedWipeMethods;
+    return std::find(m.begin(), m.end(), method) != m.end();
+}
+
+// Identities contain spaces and slashes; keep file names tame.
+static std::string safeFileName(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9') || c == '-' || c == '.';
+        out += safe ? c : '_';
+    }
+    return out;
+}
+
+bool loadStationPolicy(const std::string& file, StationPolicy& out) {
+    std::ifstream in(file);
+    if (!in.is_open()) {
+        perror(("open " + file).c_str());
+        return false;
+    }
+    nlohmann::json j = nlohmann::json::parse(in, nullptr, false);
+    if (j.is_discarded()) {
+        std::cerr << "Station policy " << file << " is not valid JSON\n";
+        return false;
+    }
+
+    try {
+        StationPolicy p;
+        p.certificateDir = j.value("certificate_dir", p.certificateDir);
+        p.quarantineFile = j.value("quarantine_file", p.quarantineFile);
+        for (const auto& r : j.at("rules")) {
+            StationRule rule;
+            rule.name = r.value("name", "rule " + std::to_string(p.rules.size() + 1));
+            rule.types = r.value("types", std::vector<std::string>());
+            rule.transports = r.value("transports", std::vector<std::string>());
+            rule.minBytes = r.value("min_bytes", (uint64_t)0);
+            rule.maxBytes = r.value("max_bytes", UINT64_MAX);
+            rule.bay = r.value("bay", std::string());
+            for (const auto& m : r.at("methods")) {
+                WipeMethod method;
+                if (!parseWipeMethod(m.get<std::string>(), method)) {
+                    std::cerr << "Station policy rule '" << rule.name << "': unknown method "
+                              << m << "\n";
+                    return false;
+                }
+                rule.methods.push_back(method);
+            }
+            if (rule.methods.empty()) {
+                std::cerr << "Station policy rule '" << rule.name << "' has no methods\n";
+                return false;
+            }
+            p.rules.push_back(rule);
+        }
+        out = p;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Malformed station policy " << file << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+const StationRule* matchStationRule(const StationPolicy& policy, const Device& dev) {
+    for (const StationRule& rule : policy.rules) {
+        if (!rule.types.empty() && !contains(rule.types, dev.type)) continue;
+        if (!rule.transports.empty() && !contains(rule.transports, dev.transport)) continue;
+        if (dev.sizeBytes < rule.minBytes || dev.sizeBytes > rule.maxBytes) continue;
+        if (!rule.bay.empty() && fnmatch(rule.bay.c_str(), dev.busPath.c_str(), 0) != 0) continue;
+        return &rule;
+    }
+    return nullptr;
+}
+
+const char* stationEventKindName(StationEventKind k) {
+    switch (k) {
+        case StationEventKind::QUEUED:      return "queued";
+        case StationEventKind::CERTIFIED:   return "certified";
+        case StationEventKind::QUARANTINED: return "quarantined";
+        case StationEventKind::SKIPPED:     return "skipped";
+    }
+    return "unknown";
+}
+
+StationMode::StationMode(StationPolicy policy_, DeviceRegistry& registry_,
+                         WipeOrchestrator& orchestrator_)
+    : policy(std::move(policy_)), registry(registry_), orchestrator(orchestrator_) {
+    loadQuarantine();
+}
+
+StationMode::~StationMode() {
+    stop();
+}
+
+void StationMode::start() {
+    if (subscription) return;
+    subscription = registry.subscribe([this](DeviceChange change, const Device& dev) {
+        if (change == DeviceChange::ADDED) deviceAdded(dev);
+    });
+}
+
+void StationMode::stop() {
+    if (!subscription) return;
+    registry.unsubscribe(subscription);
+    subscription = 0;
+}
+
+void StationMode::onEvent(EventCallback cb) {
+    std::lock_guard<std::mutex> lock(mtx);
+    callback = std::move(cb);
+}
+
+void StationMode::emit(StationEventKind kind, const Device& dev, const std::string& detail) {
+    std::cout << "[station] " << dev.path << ": " << stationEventKindName(kind);
+    if (!detail.empty()) std::cout << " (" << detail << ")";
+    std::cout << std::endl;
+
+    EventCallback cb;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        cb = callback;
+    }
+    if (cb) cb({kind, dev, detail});
+}
+
+void StationMode::deviceAdded(const Device& dev) {
+    if (dev.identity.empty()) {
+        // Nothing to key a quarantine or certificate on across insertions.
+        emit(StationEventKind::QUARANTINED, dev, "no stable identity; wipe it manually");
+        return;
+    }
+
+    std::string held;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto q = quarantineList.find(dev.identity);
+        if (q != quarantineList.end()) held = q->second.reason;
+        done = certified.count(dev.identity) > 0;
+    }
+    if (!held.empty()) {
+        emit(StationEventKind::SKIPPED, dev, "quarantined: " + held);
+        return;
+    }
+    if (done) {
+        emit(StationEventKind::SKIPPED, dev, "already certified this session");
+        return;
+    }
+
+    if (dev.isReadOnly) {
+        quarantine(dev, "read-only");
+        return;
+    }
+    if (deviceInUse(dev.name)) {
+        quarantine(dev, "in use (mounted, swap or held by another device)");
+        return;
+    }
+
+    const StationRule* rule = matchStationRule(policy, dev);
+    if (!rule) {
+        quarantine(dev, "no policy rule matches");
+        return;
+    }
+    auto method = std::find_if(rule->methods.begin(), rule->methods.end(),
+                               [&](WipeMethod m) { return supportsMethod(dev, m); });
+    if (method == rule->methods.end()) {
+        quarantine(dev, "rule '" + rule->name + "' allows no method the drive supports");
+        return;
+    }
+
+    // Registered before submit: a job can finish (or fail) before submit
+    // returns, and jobUpdated() finds it by path. A path that is already
+    // registered is a re-add (a change event, or a drive swapped in the
+    // same bay) while its job runs; that entry must stay the job's.
+    bool registered;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        registered = activeJobs.emplace(dev.path, dev.identity).second;
+    }
+    if (!registered) {
+        emit(StationEventKind::SKIPPED, dev, "a wipe is already running on this device");
+        return;
+    }
+    unsigned id = orchestrator.submit(dev, *method);
+    if (!id) {
+        // Only our own entry can be here, so it is ours to remove.
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            activeJobs.erase(dev.path);
+        }
+        emit(StationEventKind::SKIPPED, dev, "a wipe is already running on this device");
+        return;
+    }
+    emit(StationEventKind::QUEUED, dev,
+         "job " + std::to_string(id) + ", rule '" + rule->name + "', " + wipeMethodName(*method));
+}
+
+void StationMode::jobUpdated(const WipeJob& job) {
+    if (job.state != JobState::DONE && job.state != JobState::FAILED) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = activeJobs.find(job.device.path);
+        if (it == activeJobs.end() || it->second != job.device.identity) return;  // not ours
+        activeJobs.erase(it);
+    }
+
+    if (job.state == JobState::FAILED) {
+        quarantine(job.device, "wipe failed: " + job.error);
+        return;
+    }
+
+    std::string file;
+    if (!writeCertificate(job, file)) {
+        quarantine(job.device, "wiped, but the certificate could not be saved");
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        certified.insert(job.device.identity);
+    }
+    emit(StationEventKind::CERTIFIED, job.device,
+         file + (job.certRecorded ? "" : " (not recorded on chain)"));
+}
+
+bool StationMode::writeCertificate(const WipeJob& job, std::string& file) {
+    std::error_code ec;
+    std::filesystem::create_directories(policy.certificateDir, ec);
+    if (ec) {
+        std::cerr << "Cannot create " << policy.certificateDir << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    file = policy.certificateDir + "/" + safeFileName(job.device.identity) + "-" +
+           std::to_string(job.result.end_time) + ".json";
+    std::ofstream out(file, std::ios::trunc);
+    if (!out.is_open()) {
+        perror(("open " + file).c_str());
+        return false;
+    }
+    out << job.certificate;     // byte-for-byte: the chain records its hash
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write " << file << "\n";
+        return false;
+    }
+    return true;
+}
+
+void StationMode::quarantine(const Device& dev, const std::string& reason) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        QuarantineEntry& e = quarantineList[dev.identity];
+        e.identity = dev.identity;
+        e.path = dev.path;
+        e.model = dev.model;
+        e.reason = reason;
+        e.time = time(nullptr);
+    }
+    saveQuarantine();
+    emit(StationEventKind::QUARANTINED, dev, reason);
+}
+
+std::vector<QuarantineEntry> StationMode::quarantined() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<QuarantineEntry> out;
+    for (const auto& [id, e] : quarantineList) out.push_back(e);
+    return out;
+}
+
+bool StationMode::release(const std::string& identity) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!quarantineList.erase(identity)) return false;
+    }
+    saveQuarantine();
+    return true;
+}
+
+void StationMode::loadQuarantine() {
+    std::ifstream in(policy.quarantineFile);
+    if (!in.is_open()) return;
+
+    nlohmann::json j = nlohmann::json::parse(in, nullptr, false);
+    if (j.is_discarded() || !j.is_array()) {
+        std::cerr << "Ignoring unreadable quarantine list " << policy.quarantineFile << "\n";
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& e : j) {
+        QuarantineEntry q;
+        q.identity = e.value("identity", std::string());
+        q.path = e.value("path", std::string());
+        q.model = e.value("model", std::string());
+        q.reason = e.value("reason", std::string());
+        q.time = e.value("time", (uint64_t)0);
+        if (!q.identity.empty()) quarantineList[q.identity] = q;
+    }
+}
+
+void StationMode::saveQuarantine() {
+    nlohmann::json j = nlohmann::json::array();
+    for (const QuarantineEntry& q : quarantined()) {
+        j.push_back({ {"identity", q.identity}, {"path", q.path}, {"model", q.model},
+                      {"reason", q.reason}, {"time", q.time} });
+    }
+
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::path(policy.quarantineFile).parent_path();
+    if (!dir.empty()) std::filesystem::create_directories(dir, ec);
+
+    std::string tmp = policy.quarantineFile + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out.is_open()) {
+            perror(("open " + tmp).c_str());
+            return;
+        }
+        out << j.dump(2) << "\n";
+    }
+    if (rename(tmp.c_str(), policy.quarantineFile.c_str()) < 0) perror("rename quarantine list");
+}
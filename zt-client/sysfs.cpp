@@ -0,0 +1,146 @@
+#include "include/sysfs.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+std::string readSysfsLine(const std::string& path) {
+    std::ifstream file(path);
+    if (file.is_open()) {
+        std::string value;
+        std::getline(file, value);
+        // Trim whitespace/newlines
+        value.erase(value.find_last_not_of(" \n\r\t") + 1);
+        return value;
+    }
+    return "";
+}
+
+uint64_t readSysfsU64(const std::string& path, uint64_t fallback) {
+    std::string s = readSysfsLine(path);
+    if (s.empty()) return fallback;
+    try {
+        return std::stoull(s);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+std::string blockDeviceName(const std::string& devicePath) {
+    return fs::path(devicePath).filename().string();
+}
+
+// The serial number from a raw Unit Serial Number VPD page (0x80): a
+// 4-byte header with the length, then ASCII padded with spaces or NULs.
+// Anything that isn't printable is dropped so the identity stays valid
+// UTF-8 wherever it is serialized.
+static std::string vpdSerial(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::string page((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (page.size() < 4 || (uint8_t)page[1] != 0x80) return "";
+
+    size_t len = std::min<size_t>(((uint8_t)page[2] << 8) | (uint8_t)page[3], page.size() - 4);
+    std::string serial;
+    for (char c : page.substr(4, len)) {
+        if (c >= 0x20 && c < 0x7f) serial += c;
+    }
+    serial.erase(serial.find_last_not_of(' ') + 1);
+    serial.erase(0, serial.find_first_not_of(' '));
+    return serial;
+}
+
+std::string deviceIdentity(const std::string& devName, bool* stable) {
+    std::string base = "/sys/block/" + devName + "/";
+    if (stable) *stable = true;
+
+    for (const char* attr : { "wwid", "device/wwid" }) {
+        std::string id = readSysfsLine(base + attr);
+        if (!id.empty()) return id;
+    }
+
+    std::string model = readSysfsLine(base + "device/model");
+    std::string serial = readSysfsLine(base + "device/serial");
+    if (serial.empty()) serial = vpdSerial(base + "device/vpd_pg80");
+    if (!serial.empty()) return model + "-" + serial;
+
+    if (stable) *stable = false;
+    return devName + "-" + readSysfsLine(base + "size");
+}
+
+std::string firmwareRevision(const std::string& devName) {
+    std::string base = "/sys/block/" + devName + "/device/";
+    // NVMe controllers use firmware_rev, SCSI/ATA disks rev.
+    std::string rev = readSysfsLine(base + "firmware_rev");
+    return rev.empty() ? readSysfsLine(base + "rev") : rev;
+}
+
+std::string deviceBusPath(const std::string& devName) {
+    std::error_code ec;
+    fs::path p = fs::canonical("/sys/block/" + devName, ec);
+    if (ec) return "";
+    std::string s = p.string();
+    return s.rfind("/sys/", 0) == 0 ? s.substr(4) : s;
+}
+
+std::string deviceTransport(const std::string& devName) {
+    std::string bus = deviceBusPath(devName);
+    if (devName.rfind("nvme", 0) == 0) return "nvme";
+    if (bus.find("/usb") != std::string::npos) return "usb";
+    if (bus.find("/end_device-") != std::string::npos) return "sas";
+    if (bus.find("/ata") != std::string::npos) return "sata";
+    if (bus.find("/mmc") != std::string::npos) return "mmc";
+    if (bus.find("/virtio") != std::string::npos) return "virtio";
+    return "other";
+}
+
+// The disk itself and every partition directory under it.
+static std::vector<std::string> diskAndPartitions(const std::string& devName) {
+    std::vector<std::string> names = { devName };
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator("/sys/block/" + devName, ec)) {
+        std::string n = e.path().filename().string();
+        if (n.rfind(devName, 0) == 0 && fs::exists(e.path() / "partition")) names.push_back(n);
+    }
+    return names;
+}
+
+bool deviceInUse(const std::string& devName) {
+    std::vector<std::string> names = diskAndPartitions(devName);
+
+    for (const std::string& n : names) {
+        fs::path holders = n == devName ? fs::path("/sys/block/" + devName + "/holders")
+                                        : fs::path("/sys/block/" + devName + "/" + n + "/holders");
+        std::error_code ec;
+        if (fs::exists(holders, ec) && !fs::is_empty(holders, ec)) return true;
+    }
+
+    // First field of /proc/mounts and /proc/swaps is the source device.
+    for (const char* table : { "/proc/mounts", "/proc/swaps" }) {
+        std::ifstream in(table);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::string source;
+            std::istringstream(line) >> source;
+            for (const std::string& n : names) {
+                if (source == "/dev/" + n) return true;
+            }
+        }
+    }
+    return false;
+}
+
+unsigned hardwareQueueCount(const std::string& devName) {
+    std::error_code ec;
+    fs::directory_iterator it("/sys/block/" + devName + "/mq", ec);
+    if (ec) return 1;
+
+    unsigned n = 0;
+    for (const auto& entry : it) {
+        if (entry.is_directory(ec)) n++;
+    }
+    return n ? n : 1;
+}
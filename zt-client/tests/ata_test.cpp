@@ -0,0 +1,113 @@
+#include "ata.hpp"
+#include "check.hpp"
+#include <algorithm>
+
+// Opcodes as the mock logs them.
+static constexpr uint8_t IDENTIFY = 0xEC;
+static constexpr uint8_t SET_PASSWORD = 0xF1;
+static constexpr uint8_t ERASE_UNIT = 0xF4;
+static constexpr uint8_t DISABLE_PASSWORD = 0xF6;
+
+static MockAtaDrive securedDrive() {
+    MockAtaDrive d;
+    d.identity.model = "MOCK SSD";
+    d.identity.serial = "S1";
+    d.identity.sectors = 1 << 20;
+    d.identity.securitySupported = true;
+    d.identity.enhancedEraseSupported = true;
+    d.identity.eraseMinutes = 2;
+    d.identity.enhancedEraseMinutes = 4;
+    return d;
+}
+
+static bool logged(const MockAtaDrive& d, uint8_t op) {
+    return std::find(d.log.begin(), d.log.end(), op) != d.log.end();
+}
+
+static void enhancedErase() {
+    MockAtaDrive d = securedDrive();
+    WipeProgress progress;
+    AtaError err = ataSecurityErase(d, true, &progress);
+    CHECK(err.ok());
+    CHECK(d.erased);
+    CHECK(d.erasedEnhanced);
+    CHECK(d.password.empty());
+    CHECK(!d.log.empty() && d.log.front() == IDENTIFY);
+    CHECK(progress.snapshot().phase == WipePhase::ERASING);
+}
+
+static void normalEraseWhenEnhancedMissing() {
+    MockAtaDrive d = securedDrive();
+    d.identity.enhancedEraseSupported = false;
+    bool enhanced = true;
+    CHECK(ataSecurityErase(d, true, nullptr, &enhanced).ok());
+    CHECK(d.erased);
+    CHECK(!d.erasedEnhanced && !enhanced);
+}
+
+static void frozenDriveIsRefused() {
+    MockAtaDrive d = securedDrive();
+    d.identity.securityFrozen = true;
+    AtaError err = ataSecurityErase(d, true);
+    CHECK(err.kind == AtaErrorKind::FROZEN);
+    CHECK(!d.erased);
+    CHECK(!logged(d, SET_PASSWORD));
+}
+
+static void unsupportedDriveIsRefused() {
+    MockAtaDrive d = securedDrive();
+    d.identity.securitySupported = false;
+    CHECK(ataSecurityErase(d, false).kind == AtaErrorKind::NOT_SUPPORTED);
+    CHECK(!logged(d, SET_PASSWORD));
+}
+
+// A rejected erase must not leave the drive locked to our password.
+static void failedEraseRemovesPassword() {
+    MockAtaDrive d = securedDrive();
+    d.failCommand = ERASE_UNIT;
+    AtaError err = ataSecurityErase(d, true);
+    CHECK(err.kind == AtaErrorKind::ABORTED);
+    CHECK(err.command == ERASE_UNIT);
+    CHECK(!d.erased);
+    CHECK(logged(d, DISABLE_PASSWORD));
+    CHECK(d.password.empty());
+}
+
+// Words 89/90 at the top of their range are lower bounds, not estimates.
+static void openEndedEraseTime() {
+    std::array<uint16_t, 256> w = {};
+    w[89] = 0xff;
+    w[90] = 0x8000 | 0x7fff;
+    AtaIdentity id = parseIdentify(w);
+    CHECK(id.eraseMinutes == 508 && id.eraseOpenEnded);
+    CHECK(id.enhancedEraseMinutes == 65532 && id.enhancedEraseOpenEnded);
+
+    w[90] = 0x8000 | 0x7ffe;
+    id = parseIdentify(w);
+    CHECK(id.enhancedEraseMinutes == 65532 && !id.enhancedEraseOpenEnded);
+}
+
+static void eraseTimeoutFollowsEstimate() {
+    MockAtaDrive d = securedDrive();
+    d.identity.enhancedEraseMinutes = 300;
+    CHECK(ataSecurityErase(d, true).ok());
+    CHECK(d.eraseTimeout == 300 * 2 * 60);
+
+    // 508+ minutes could be any length; twice 508 is not a safe bound.
+    d = securedDrive();
+    d.identity.enhancedEraseMinutes = 508;
+    d.identity.enhancedEraseOpenEnded = true;
+    CHECK(ataSecurityErase(d, true).ok());
+    CHECK(d.eraseTimeout == 508 * 4 * 60);
+}
+
+int main() {
+    enhancedErase();
+    normalEraseWhenEnhancedMissing();
+    frozenDriveIsRefused();
+    unsupportedDriveIsRefused();
+    failedEraseRemovesPassword();
+    openEndedEraseTime();
+    eraseTimeoutFollowsEstimate();
+    return TEST_RESULT;
+}
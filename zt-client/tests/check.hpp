@@ -0,0 +1,20 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <iostream>
+
+// Minimal assertions for the test executables: a failed CHECK is reported
+// and counted, and main() returns TEST_RESULT for ctest.
+static int testFailures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            testFailures++;                                                  \
+        }                                                                    \
+    } while (0)
+
+#define TEST_RESULT (testFailures ? 1 : 0)
+
+#endif
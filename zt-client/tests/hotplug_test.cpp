@@ -0,0 +1,129 @@
+#include "hotplug.hpp"
+#include "check.hpp"
+#include <sstream>
+
+// What `udevadm monitor --kernel --property` prints for a USB stick with
+// one partition being plugged in, resized, and pulled.
+static const char* TRANSCRIPT =
+    "monitor will print the received events for:\n"
+    "KERNEL - the kernel uevent\n"
+    "\n"
+    "KERNEL[100.000001] add      /devices/pci0000:00/usb1/1-1/host6/target6:0:0/6:0:0:0/block/sdb (block)\n"
+    "ACTION=add\n"
+    "DEVPATH=/devices/pci0000:00/usb1/1-1/host6/target6:0:0/6:0:0:0/block/sdb\n"
+    "SUBSYSTEM=block\n"
+    "DEVNAME=sdb\n"
+    "DEVTYPE=disk\n"
+    "\n"
+    "KERNEL[100.000002] add      /devices/pci0000:00/usb1/1-1/host6/target6:0:0/6:0:0:0/block/sdb/sdb1 (block)\n"
+    "ACTION=add\n"
+    "DEVPATH=/devices/pci0000:00/usb1/1-1/host6/target6:0:0/6:0:0:0/block/sdb/sdb1\n"
+    "SUBSYSTEM=block\n"
+    "DEVNAME=sdb1\n"
+    "DEVTYPE=partition\n"
+    "\n"
+    "KERNEL[101.000000] add      /devices/virtual/block/loop7 (block)\n"
+    "ACTION=add\n"
+    "DEVPATH=/devices/virtual/block/loop7\n"
+    "SUBSYSTEM=block\n"
+    "DEVNAME=loop7\n"
+    "DEVTYPE=disk\n"
+    "\n"
+    "KERNEL[102.000000] change   /devices/pci0000:00/usb1/1-1/host6/target6:0:0/6:0:0:0/block/sdb (block)\n"
+    "ACTION=change\n"
+    "DEVPATH=/devices/pci0000:00/usb1/1-1/host6/target6:0:0/6:0:0:0/block/sdb\n"
+    "SUBSYSTEM=block\n"
+    "DEVNAME=sdb\n"
+    "DEVTYPE=disk\n"
+    "\n"
+    "KERNEL[103.000000] remove   /devices/pci0000:00/usb1/1-1/host6/target6:0:0/6:0:0:0/block/sdb (block)\n"
+    "ACTION=remove\n"
+    "DEVPATH=/devices/pci0000:00/usb1/1-1/host6/target6:0:0/6:0:0:0/block/sdb\n"
+    "SUBSYSTEM=block\n"
+    "DEVNAME=sdb\n"
+    "DEVTYPE=disk\n";
+
+static Device stick(uint64_t size) {
+    Device d{};
+    d.name = "sdb";
+    d.path = "/dev/sdb";
+    d.sizeBytes = size;
+    d.isRemovable = true;
+    d.model = "MOCK STICK";
+    return d;
+}
+
+static void transcriptParses() {
+    std::istringstream in(TRANSCRIPT);
+    std::vector<Uevent> events = readUevents(in);
+    CHECK(events.size() == 5);
+    if (events.size() != 5) return;
+    CHECK(events[0].action == "add");
+    CHECK(events[0].devpath.size() > 4 &&
+          events[0].devpath.compare(events[0].devpath.size() - 4, 4, "/sdb") == 0);
+    CHECK(events[1].get("DEVTYPE") == "partition");
+    CHECK(events[4].action == "remove");
+}
+
+static void rawDatagramParses() {
+    const char kernel[] = "add@/devices/virtual/block/sdz\0ACTION=add\0SUBSYSTEM=block\0DEVTYPE=disk";
+    Uevent ev;
+    CHECK(parseUevent(kernel, sizeof(kernel), ev));
+    CHECK(ev.action == "add" && ev.get("SUBSYSTEM") == "block");
+
+    const char udev[] = "libudev\0\xfe\xed\xca\xfe";
+    CHECK(!parseUevent(udev, sizeof(udev), ev));
+}
+
+// The registry probes only whole candidate disks and reports each real
+// difference once.
+static void replayUpdatesRegistry() {
+    uint64_t size = 8ull << 30;
+    bool present = true;
+    unsigned probes = 0;
+    DeviceRegistry registry([&](const std::string& name, Device& out) {
+        probes++;
+        if (name != "sdb" || !present) return false;
+        out = stick(size);
+        return true;
+    });
+
+    std::vector<std::pair<DeviceChange, std::string>> seen;
+    registry.subscribe([&](DeviceChange c, const Device& d) { seen.push_back({c, d.name}); });
+
+    std::istringstream in(TRANSCRIPT);
+    std::vector<Uevent> events = readUevents(in);
+    if (events.size() != 5) return;
+    HotplugMonitor monitor(registry);
+
+    monitor.replay({ events[0], events[1], events[2] });
+    CHECK(probes == 1);                 // partition and loop device ignored
+    CHECK(seen.size() == 1 && seen[0].first == DeviceChange::ADDED && seen[0].second == "sdb");
+    Device found;
+    CHECK(registry.find("sdb", found) && found.sizeBytes == size);
+
+    // A change that leaves the device as it was is not reported.
+    monitor.replay({ events[3] });
+    CHECK(seen.size() == 1);
+
+    size = 16ull << 30;
+    monitor.replay({ events[3] });
+    CHECK(seen.size() == 2 && seen[1].first == DeviceChange::CHANGED);
+    CHECK(registry.find("sdb", found) && found.sizeBytes == size);
+
+    monitor.replay({ events[4] });
+    CHECK(seen.size() == 3 && seen[2].first == DeviceChange::REMOVED);
+    CHECK(registry.snapshot().empty());
+
+    // Gone again before it could be probed: nothing to report.
+    present = false;
+    monitor.replay({ events[0] });
+    CHECK(seen.size() == 3);
+}
+
+int main() {
+    transcriptParses();
+    rawDatagramParses();
+    replayUpdatesRegistry();
+    return TEST_RESULT;
+}
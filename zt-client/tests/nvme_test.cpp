@@ -0,0 +1,124 @@
+#include "nvme.hpp"
+#include "wipe.hpp"
+#include "check.hpp"
+#include <algorithm>
+
+static constexpr uint8_t FORMAT_NVM = 0x80;
+static constexpr auto FAST = std::chrono::milliseconds(1);
+
+static MockNvmeController controller() {
+    MockNvmeController c;
+    c.identity.model = "MOCK NVME";
+    c.identity.serial = "N1";
+    c.ns.blocks = 1 << 20;
+    c.ns.blockSize = 4096;
+    c.progressStep = 65535;
+    return c;
+}
+
+static void sanitizeReportsProgress() {
+    MockNvmeController c = controller();
+    c.identity.sanitizeBlock = true;
+    c.progressStep = 16384;
+    CHECK(nvmeStartSanitize(c, SanitizeAction::BLOCK_ERASE).ok());
+
+    WipeProgress progress;
+    SanitizeStatus final;
+    CHECK(waitForSanitize(c, SanitizeAction::BLOCK_ERASE, &progress, final, FAST).ok());
+    CHECK(final.state == SANITIZE_COMPLETED);
+    CHECK(final.globalDataErased);
+    ProgressSnapshot s = progress.snapshot();
+    CHECK(s.phase == WipePhase::ERASING && s.bytesDone == s.bytesTotal);
+}
+
+static void failedSanitizeIsAnError() {
+    MockNvmeController c = controller();
+    c.identity.sanitizeCrypto = true;
+    c.failSanitize = true;
+    CHECK(nvmeStartSanitize(c, SanitizeAction::CRYPTO_ERASE).ok());
+    SanitizeStatus final;
+    NvmeError err = waitForSanitize(c, SanitizeAction::CRYPTO_ERASE, nullptr, final, FAST);
+    CHECK(err.kind == NvmeErrorKind::FAILED);
+}
+
+// A completed log left by an earlier sanitize with a different action
+// must not be taken as this one finishing.
+static void staleCompletionIsIgnored() {
+    MockNvmeController c = controller();
+    c.status.state = SANITIZE_COMPLETED;
+    c.status.cdw10 = (uint32_t)SanitizeAction::BLOCK_ERASE;
+    SanitizeStatus final;
+    NvmeError err = waitForSanitize(c, SanitizeAction::CRYPTO_ERASE, nullptr, final, FAST);
+    CHECK(err.kind == NvmeErrorKind::FAILED);
+}
+
+static void firmwareEraseUsesCryptoSanitize() {
+    MockNvmeController c = controller();
+    c.identity.sanitizeCrypto = true;
+    c.identity.sanitizeBlock = true;
+    WipeProgress progress;
+    WipeResult result{};
+    std::string noPattern;
+    CHECK(nvmeFirmwareErase(c, noPattern, progress, result));
+    CHECK(!noPattern.empty());
+    CHECK(result.erase_action == "nvme-sanitize-crypto-erase");
+    CHECK(result.erase_status == SANITIZE_COMPLETED);
+}
+
+// Only an overwrite defines what the media reads back as afterwards.
+static void firmwareEraseVerifiesOnlyOverwrite() {
+    MockNvmeController c = controller();
+    c.identity.sanitizeBlock = true;
+    WipeProgress progress;
+    WipeResult result{};
+    std::string noPattern;
+    CHECK(nvmeFirmwareErase(c, noPattern, progress, result));
+    CHECK(result.erase_action == "nvme-sanitize-block-erase");
+    CHECK(!noPattern.empty());
+
+    c = controller();
+    c.identity.sanitizeOverwrite = true;
+    noPattern.clear();
+    CHECK(nvmeFirmwareErase(c, noPattern, progress, result));
+    CHECK(result.erase_action == "nvme-sanitize-overwrite");
+    CHECK(noPattern.empty());
+}
+
+static void firmwareEraseFormatsKeepingLbaFormat() {
+    MockNvmeController c = controller();
+    c.identity.formatSupported = true;
+    c.ns.formatIndex = 2;
+    WipeProgress progress;
+    WipeResult result{};
+    std::string noPattern;
+    CHECK(nvmeFirmwareErase(c, noPattern, progress, result));
+    CHECK(c.formatted);
+    CHECK(c.formatSes == 1);
+    CHECK(c.formatIndex == 2);
+    CHECK(c.formatNsid == 1);
+}
+
+// Through the controller device the LBA format is unknown; formatting
+// with a guessed one could change the drive's block size.
+static void firmwareEraseRefusesFormatWithoutNamespace() {
+    MockNvmeController c = controller();
+    c.identity.formatSupported = true;
+    c.nsid = 0;
+    WipeProgress progress;
+    WipeResult result{};
+    std::string noPattern;
+    CHECK(!nvmeFirmwareErase(c, noPattern, progress, result));
+    CHECK(!c.formatted);
+    CHECK(std::find(c.log.begin(), c.log.end(), FORMAT_NVM) == c.log.end());
+}
+
+int main() {
+    sanitizeReportsProgress();
+    failedSanitizeIsAnError();
+    staleCompletionIsIgnored();
+    firmwareEraseUsesCryptoSanitize();
+    firmwareEraseVerifiesOnlyOverwrite();
+    firmwareEraseFormatsKeepingLbaFormat();
+    firmwareEraseRefusesFormatWithoutNamespace();
+    return TEST_RESULT;
+}
@@ -0,0 +1,270 @@
+#include "include/uring.hpp"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static int sysSetup(unsigned entries, io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int sysRegister(int fd, unsigned opcode, const void* arg, unsigned nrArgs) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+static unsigned loadAcquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void storeRelease(unsigned* p, unsigned v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+IoUring::~IoUring() {
+    if (sqes) munmap(sqes, sqesSize);
+    if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if (sqRing) munmap(sqRing, sqRingSize);
+    if (ringFd >= 0) close(ringFd);
+}
+
+bool IoUring::init(unsigned entries) {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    ringFd = sysSetup(entries, &p);
+    if (ringFd < 0) {
+        perror("io_uring_setup");
+        return false;
+    }
+
+    sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        perror("mmap sq ring");
+        return false;
+    }
+
+    if (singleMmap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            perror("mmap cq ring");
+            return false;
+        }
+    }
+
+    sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    void* s = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (s == MAP_FAILED) {
+        perror("mmap sqes");
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(s);
+
+    char* sq = static_cast<char*>(sqRing);
+    sqHead  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqTail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqMask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    sqEntries = p.sq_entries;
+    sqeTail = *sqTail;
+
+    char* cq = static_cast<char*>(cqRing);
+    cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes   = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+    return true;
+}
+
+bool IoUring::registerBuffers(const std::vector<iovec>& iovs) {
+    return sysRegister(ringFd, IORING_REGISTER_BUFFERS, iovs.data(), iovs.size()) == 0;
+}
+
+bool IoUring::registerFiles(const std::vector<int>& fds) {
+    return sysRegister(ringFd, IORING_REGISTER_FILES, fds.data(), fds.size()) == 0;
+}
+
+io_uring_sqe* IoUring::getSqe() {
+    unsigned head = loadAcquire(sqHead);
+    if (sqeTail - head >= sqEntries) return nullptr;
+
+    io_uring_sqe* sqe = &sqes[sqeTail & *sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqeTail++;
+    return sqe;
+}
+
+int IoUring::submit(unsigned waitNr) {
+    unsigned tail = *sqTail;
+    // Count from the kernel's head, not our last tail: entries published by
+    // an earlier enter that it didn't consume still need submitting.
+    unsigned toSubmit = sqeTail - loadAcquire(sqHead);
+    for (; tail != sqeTail; tail++) {
+        sqArray[tail & *sqMask] = tail & *sqMask;
+    }
+    storeRelease(sqTail, sqeTail);
+
+    unsigned flags = waitNr ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+    do {
+        ret = sysEnter(ringFd, toSubmit, waitNr, flags);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+bool IoUring::popCqe(io_uring_cqe& out) {
+    unsigned head = *cqHead;
+    if (head == loadAcquire(cqTail)) return false;
+
+    out = cqes[head & *cqMask];
+    storeRelease(cqHead, head + 1);
+    return true;
+}
+
+bool uringAvailable() {
+    static const bool available = [] {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = sysSetup(1, &p);
+        if (fd < 0) return false;
+        close(fd);
+        return true;
+    }();
+    return available;
+}
+
+bool UringWriter::init(int fd_, ChunkSource& src_, unsigned queueDepth_,
+                       WipeProgress* progress_) {
+    fd = fd_;
+    src = &src_;
+    progress = progress_;
+    queueDepth = (unsigned)std::min<size_t>(std::max(1u, queueDepth_), src->maxInFlight());
+
+    if (!ring.init(queueDepth)) return false;
+    queueDepth = std::min(queueDepth, ring.entries());
+
+    // Both registrations are optimisations; RLIMIT_MEMLOCK or an old
+    // kernel can refuse them and plain WRITE still works.
+    fixedBuffers = ring.registerBuffers(src->buffers());
+    fixedFile = ring.registerFiles({ fd });
+
+    pending.assign(queueDepth, Pending{});
+    freeSlots.clear();
+    for (unsigned i = 0; i < queueDepth; i++) freeSlots.push_back(queueDepth - 1 - i);
+    return true;
+}
+
+bool UringWriter::writeRange(uint64_t offset, uint64_t length, size_t blockSize) {
+    uint64_t end = offset + length;
+    uint64_t next = offset;
+    unsigned inflight = 0;
+    bool ok = true;
+
+    while ((ok && next < end) || inflight > 0) {
+        while (ok && next < end && !freeSlots.empty()) {
+            io_uring_sqe* sqe = ring.getSqe();
+            if (!sqe) break;
+
+            size_t len = std::min<uint64_t>(blockSize, end - next);
+            unsigned slot = freeSlots.back();
+            freeSlots.pop_back();
+            pending[slot] = { src->acquire(next, len), next };
+            const WriteChunk& c = pending[slot].chunk;
+
+            if (fixedBuffers && c.bufIndex >= 0) {
+                sqe->opcode = IORING_OP_WRITE_FIXED;
+                sqe->buf_index = c.bufIndex;
+            } else {
+                sqe->opcode = IORING_OP_WRITE;
+            }
+            if (fixedFile) {
+                sqe->fd = 0;
+                sqe->flags |= IOSQE_FIXED_FILE;
+            } else {
+                sqe->fd = fd;
+            }
+            sqe->addr = reinterpret_cast<uint64_t>(c.data);
+            sqe->len = c.len;
+            sqe->off = next;
+            sqe->user_data = slot;
+
+            next += c.len;
+            inflight++;
+        }
+
+        if (ring.submit(inflight > 0 ? 1 : 0) < 0) {
+            perror("io_uring_enter");
+            // This round's entries stay published in the ring and a later
+            // enter may still consume them, so they are reaped like the rest.
+            drain(inflight);
+            return false;
+        }
+
+        io_uring_cqe cqe;
+        while (ring.popCqe(cqe)) {
+            Pending& p = pending[cqe.user_data];
+            if (cqe.res < 0) {
+                errno = -cqe.res;
+                perror("write");
+                ok = false;
+            } else if ((size_t)cqe.res < p.chunk.len) {
+                // Short write: finish the tail synchronously from the same buffer.
+                size_t done = cqe.res;
+                while (ok && done < p.chunk.len) {
+                    ssize_t w = pwrite(fd, p.chunk.data + done, p.chunk.len - done, p.offset + done);
+                    if (w < 0 && errno == EINTR) continue;
+                    if (w <= 0) {
+                        perror("write");
+                        ok = false;
+                        break;
+                    }
+                    done += w;
+                }
+            }
+            if (ok && progress) progress->add(p.chunk.len);
+            src->release(p.chunk);
+            freeSlots.push_back(cqe.user_data);
+            inflight--;
+        }
+    }
+    return ok;
+}
+
+void UringWriter::drain(unsigned& inflight) {
+    while (inflight > 0) {
+        io_uring_cqe cqe;
+        while (ring.popCqe(cqe)) {
+            src->release(pending[cqe.user_data].chunk);
+            freeSlots.push_back(cqe.user_data);
+            inflight--;
+        }
+        if (inflight > 0 && ring.submit(1) < 0) {
+            // The buffers may still be under DMA; leaking them is the safe choice.
+            std::cerr << "Abandoning " << inflight << " in-flight writes\n";
+            return;
+        }
+    }
+}
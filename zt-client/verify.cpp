@@ -0,0 +1,291 @@
+#include "include/verify.hpp"
+#include "include/arena.hpp"
+#include "include/simd.hpp"
+#include "include/numa.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+bool ConstantChecker::check(uint64_t offset, const char* data, size_t len) {
+    (void)offset;
+    return findMismatch(data, len, value) == len;
+}
+
+bool ErasedChecker::check(uint64_t offset, const char* data, size_t len) {
+    (void)offset;
+    for (size_t i = 0; i < len; i += lbs) {
+        size_t n = std::min(lbs, len - i);
+        uint8_t v = (uint8_t)data[i];
+        if (v != 0x00 && v != 0xff) return false;
+        if (findMismatch(data + i, n, v) != n) return false;
+    }
+    return true;
+}
+
+// Rechecks a failed read one logical block at a time. Returns how many
+// blocks failed; their ranges are appended to `out` only when `record`.
+static uint64_t narrowMismatch(BlockChecker& checker, uint64_t off, const char* buf,
+                               size_t len, size_t lbs, bool record,
+                               std::vector<VerifyRange>& out) {
+    uint64_t failed = 0;
+    for (size_t i = 0; i < len; i += lbs) {
+        size_t n = std::min(lbs, len - i);
+        if (checker.check(off + i, buf + i, n)) continue;
+        failed++;
+        if (!record) continue;
+        if (!out.empty() && out.back().offset + out.back().length == off + i) {
+            out.back().length += n;
+        } else {
+            out.push_back({ off + i, n });
+        }
+    }
+    return failed;
+}
+
+static void mergeRanges(std::vector<VerifyRange>& r) {
+    std::sort(r.begin(), r.end(), [](const VerifyRange& a, const VerifyRange& b) {
+        return a.offset < b.offset;
+    });
+    std::vector<VerifyRange> merged;
+    for (const VerifyRange& x : r) {
+        if (!merged.empty() && merged.back().offset + merged.back().length >= x.offset) {
+            uint64_t end = std::max(merged.back().offset + merged.back().length, x.offset + x.length);
+            merged.back().length = end - merged.back().offset;
+        } else {
+            merged.push_back(x);
+        }
+    }
+    r.swap(merged);
+}
+
+std::vector<VerifyRange> fullRanges(uint64_t size) {
+    return { VerifyRange{ 0, size } };
+}
+
+std::vector<VerifyRange> sampleRanges(uint64_t size, const SamplingPlan& plan,
+                                      size_t align) {
+    std::vector<VerifyRange> out;
+    if (size == 0) return out;
+
+    auto alignDown = [align](uint64_t v) { return v / align * align; };
+    uint64_t edge = std::min(size, std::max<uint64_t>(alignDown(plan.edgeBytes), align));
+    out.push_back({ 0, edge });
+    out.push_back({ alignDown(size - edge), size - alignDown(size - edge) });
+
+    unsigned regions = std::max(1u, plan.regions);
+    uint64_t regionSize = std::max<uint64_t>(alignDown(size / regions), align);
+    uint64_t sample = std::min(regionSize, std::max<uint64_t>(alignDown(plan.sampleBytes), align));
+
+    std::mt19937_64 rng(plan.seed);
+    for (uint64_t start = 0; start < size; start += regionSize) {
+        uint64_t len = std::min(regionSize, size - start);
+        uint64_t slots = len > sample ? (len - sample) / align : 0;
+        for (unsigned i = 0; i < plan.samplesPerRegion; i++) {
+            // Plain modulo rather than std::uniform_int_distribution, whose
+            // mapping differs between standard libraries. The bias is at
+            // most slots / 2^64.
+            uint64_t off = start + rng() % (slots + 1) * align;
+            out.push_back({ off, std::min(sample, size - off) });
+        }
+    }
+
+    mergeRanges(out);
+    return out;
+}
+
+double rangeCoverage(const std::vector<VerifyRange>& ranges, uint64_t size) {
+    if (size == 0) return 0;
+    uint64_t covered = 0;
+    for (const VerifyRange& r : ranges) covered += r.length;
+    return (double)covered / size;
+}
+
+void setSamplingCoverage(SamplingPlan& plan, uint64_t size, double fraction) {
+    unsigned regions = std::max(1u, plan.regions);
+    double perRegion = fraction * size / regions / std::max<uint64_t>(1, plan.sampleBytes);
+    plan.samplesPerRegion = std::max(1u, (unsigned)std::ceil(perRegion));
+}
+
+static bool readFully(int fd, char* buf, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t r = pread(fd, buf + done, len - done, offset + done);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        done += r;
+    }
+    return true;
+}
+
+PipelinedVerifier::PipelinedVerifier(const std::string& devicePath,
+                                     std::vector<VerifyRange> ranges_,
+                                     CheckerFactory makeChecker_,
+                                     unsigned threads, size_t blockSize_)
+    : ranges(std::move(ranges_)), makeChecker(std::move(makeChecker_)),
+      blockSize(blockSize_) {
+    // Reading through the page cache could return what we just wrote
+    // rather than what reached the media.
+    fd = open(devicePath.c_str(), O_RDONLY | O_DIRECT);
+    if (fd < 0 && errno == EINVAL) {
+        std::cerr << "O_DIRECT not supported on " << devicePath
+                  << ", verifying through the page cache\n";
+        fd = open(devicePath.c_str(), O_RDONLY);
+        if (fd >= 0) ioctl(fd, BLKFLSBUF, 0);
+    }
+    if (fd < 0) {
+        perror("open");
+        failed = true;
+        return;
+    }
+
+    int lbs = 0;
+    if (ioctl(fd, BLKSSZGET, &lbs) < 0) lbs = 512;
+    logicalBlock = lbs;
+
+    arena = std::make_unique<BufferArena>(logicalBlock, placementNode(devicePath));
+    std::vector<char*> bufs;
+    for (unsigned i = 0; i < std::max(1u, threads); i++) {
+        char* b = arena->allocate(blockSize);
+        if (!b) {
+            failed = true;
+            return;
+        }
+        bufs.push_back(b);
+    }
+    for (char* b : bufs) workers.emplace_back(&PipelinedVerifier::worker, this, b);
+}
+
+PipelinedVerifier::~PipelinedVerifier() {
+    // Without finish() the result is not wanted; skip what is still queued.
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.clear();
+    }
+    close();
+    if (fd >= 0) ::close(fd);
+}
+
+void PipelinedVerifier::submit(uint64_t offset, uint64_t length) {
+    uint64_t end = offset + length;
+    // First range that ends after `offset`; ranges are sorted and disjoint.
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), offset,
+                               [](uint64_t off, const VerifyRange& r) {
+                                   return off < r.offset + r.length;
+                               });
+    std::lock_guard<std::mutex> lock(mtx);
+    for (; it != ranges.end() && it->offset < end; ++it) {
+        uint64_t from = std::max(offset, it->offset);
+        uint64_t to = std::min(end, it->offset + it->length);
+        queue.push_back({ from, to - from });
+    }
+    cv.notify_all();
+}
+
+void PipelinedVerifier::close() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+    }
+    cv.notify_all();
+    for (auto& w : workers) w.join();
+    workers.clear();
+}
+
+VerifyReport PipelinedVerifier::finish(WipeProgress* progress) {
+    if (progress) {
+        uint64_t queued = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (const VerifyRange& r : queue) queued += r.length;
+        }
+        progress->start(WipePhase::VERIFYING, bytes + queued, 1, bytes);
+        progressOut = progress;
+    }
+    close();
+
+    VerifyReport report;
+    if (failed) {
+        report.unreadableBlocks = 1;
+        return report;
+    }
+
+    mergeRanges(allBad);
+    if (allBad.size() > VerifyReport::MAX_RECORDED_RANGES) {
+        allBad.resize(VerifyReport::MAX_RECORDED_RANGES);
+        truncated = true;
+    }
+    report.badRanges = std::move(allBad);
+    report.rangesTruncated = truncated;
+
+    report.bytesChecked = bytes;
+    report.blocksChecked = checked;
+    report.mismatchedBlocks = mismatched;
+    report.unreadableBlocks = unreadable;
+    return report;
+}
+
+void PipelinedVerifier::worker(char* buf) {
+    std::unique_ptr<BlockChecker> checker = makeChecker();
+    std::vector<VerifyRange> bad;
+
+    for (;;) {
+        uint64_t off;
+        size_t len;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return !queue.empty() || closed; });
+            if (queue.empty()) break;
+            VerifyRange& r = queue.front();
+            off = r.offset;
+            len = std::min<uint64_t>(blockSize, r.length);
+            r.offset += len;
+            r.length -= len;
+            if (r.length == 0) queue.pop_front();
+        }
+
+        uint64_t blocks = (len + logicalBlock - 1) / logicalBlock;
+        checked += blocks;
+        if (!readFully(fd, buf, len, off)) {
+            unreadable += blocks;
+            bad.push_back({ off, len });
+            continue;
+        }
+        bytes += len;
+        if (WipeProgress* p = progressOut.load()) p->add(len);
+        if (!checker->check(off, buf, len)) {
+            bool record = bad.size() <= VerifyReport::MAX_RECORDED_RANGES;
+            if (!record) truncated = true;
+            mismatched += narrowMismatch(*checker, off, buf, len, logicalBlock, record, bad);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    allBad.insert(allBad.end(), bad.begin(), bad.end());
+}
+
+VerifyReport verifyRanges(const std::string& devicePath,
+                          const std::vector<VerifyRange>& ranges,
+                          const CheckerFactory& makeChecker,
+                          unsigned threads, size_t blockSize,
+                          WipeProgress* progress) {
+    uint64_t totalBlocks = 0;
+    for (const VerifyRange& r : ranges) totalBlocks += (r.length + blockSize - 1) / blockSize;
+    threads = std::max(1u, (unsigned)std::min<uint64_t>(threads, std::max<uint64_t>(1, totalBlocks)));
+
+    PipelinedVerifier verifier(devicePath, ranges, makeChecker, threads, blockSize);
+    if (progress) verifier.setProgress(progress);
+    for (const VerifyRange& r : ranges) verifier.submit(r.offset, r.length);
+    return verifier.finish();
+}
@@ -1,41 +1,190 @@
 #include "include/wipe.hpp"
 #include "include/cert.hpp"
 #include "include/dev.hpp"
+#include "include/overwrite.hpp"
+#include "include/uring.hpp"
+#include "include/arena.hpp"
+#include "include/sysfs.hpp"
+#include "include/keystream.hpp"
+#include "include/verify.hpp"
+#include "include/simd.hpp"
+#include "include/offload.hpp"
+#include "include/journal.hpp"
+#include "include/planner.hpp"
+#include "include/pattern.hpp"
+#include "include/qos.hpp"
+#include "include/numa.hpp"
+#include "include/ata.hpp"
+#include "include/nvme.hpp"
+#include <openssl/crypto.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <linux/fs.h>
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <condition_variable>
+#include <cerrno>
 #include <cstring>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
 #include <vector>
 
 
-#define MP_NUM_PASSES 3
+static constexpr unsigned MAX_STRIPES = 16;
+static constexpr size_t VERIFY_BLKSIZE = 4 * 1024 * 1024; // large reads for read-back
+static constexpr uint64_t OFFLOAD_CHUNK = 256ull * 1024 * 1024; // per BLKZEROOUT call
+static constexpr uint64_t CHECKPOINT_SEGMENT = 256ull * 1024 * 1024; // resume granularity
 
-#include <sys/wait.h>
 #include <vector>
 #include <cstring>
 
-static bool runHdparm(const std::vector<const char*>& args) {
-    pid_t pid = fork();
-    if (pid == 0) {
-        execvp(args[0], const_cast<char* const*>(args.data()));
-        _exit(127);
+static bool useUringEngine(const WipeOptions& opts) {
+    if (opts.engine == WipeEngine::SYNC) return false;
+    if (uringAvailable()) return true;
+    if (opts.engine == WipeEngine::IO_URING) {
+        std::cerr << "io_uring unavailable, falling back to synchronous writes\n";
     }
+    return false;
+}
+
+// BLKZEROOUT can only write zeros, so this is only asked for zero fills.
+// AUTO takes it when the device advertises a hardware write-zeroes command;
+// without one the kernel would just write zero pages itself.
+static bool useOffloadEngine(const std::string& devicePath, const WipeOptions& opts) {
+    if (opts.engine != WipeEngine::AUTO && opts.engine != WipeEngine::OFFLOAD) return false;
 
-    int status;
-    waitpid(pid, &status, 0);
-    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    OffloadLimits limits = queryOffloadLimits(blockDeviceName(devicePath));
+    if (limits.writeZeroesMax > 0) {
+        std::cout << "Zeroing with BLKZEROOUT (write_zeroes_max_bytes "
+                  << limits.writeZeroesMax << ")\n";
+        return true;
+    }
+    if (opts.engine == WipeEngine::OFFLOAD) {
+        std::cerr << "No hardware write-zeroes on " << devicePath
+                  << ", BLKZEROOUT will be emulated by the kernel\n";
+        return true;
+    }
+    return false;
 }
 
-bool mpOverwrite(const std::string& devicePath){
-    int fd = open(devicePath.c_str(), O_WRONLY | O_SYNC);
-    if (fd < 0) {
-        perror("open");
-        return false;
+static int openForOverwrite(const std::string& devicePath, bool uring, bool& direct) {
+    // The io_uring path keeps many writes in flight and flushes once per
+    // pass; O_SYNC would serialise them again. O_DIRECT bypasses the page
+    // cache altogether, so there is nothing for O_SYNC to do there either.
+    int flags = O_WRONLY;
+    if (!direct && !uring) flags |= O_SYNC;
+
+    if (direct) {
+        int fd = open(devicePath.c_str(), flags | O_DIRECT);
+        if (fd >= 0) return fd;
+        if (errno != EINVAL) {
+            perror("open");
+            return -1;
+        }
+        std::cerr << "O_DIRECT not supported on " << devicePath
+                  << ", using buffered writes\n";
+        direct = false;
+        if (!uring) flags |= O_SYNC;
     }
 
+    int fd = open(devicePath.c_str(), flags);
+    if (fd < 0) perror("open");
+    return fd;
+}
+
+// One contiguous LBA range written by its own worker. The device is only
+// wiped once every stripe has completed every pass.
+struct Stripe {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    std::atomic<uint64_t> written{0};   // pass * length + bytes into the pass
+    std::atomic<int>  passesDone{0};
+    std::atomic<bool> failed{false};
+};
+
+static unsigned chooseStripeCount(const std::string& devicePath, uint64_t size,
+                                  size_t blockSize, const WipeOptions& opts) {
+    unsigned n = opts.stripes;
+    if (n == 0) {
+        // One writer per blk-mq hardware queue, but no more than we have cores.
+        n = hardwareQueueCount(blockDeviceName(devicePath));
+        n = std::min(n, std::max(1u, std::thread::hardware_concurrency()));
+    }
+    n = std::min(n, MAX_STRIPES);
+    // Every stripe gets at least one full block.
+    n = std::min<uint64_t>(n, std::max<uint64_t>(1, size / blockSize));
+    return std::max(1u, n);
+}
+
+// Block-aligned split of [0, size); the last stripe takes the remainder.
+static std::vector<Stripe> splitStripes(uint64_t size, unsigned n, size_t blockSize) {
+    std::vector<Stripe> stripes(n);
+    uint64_t per = size / n / blockSize * blockSize;
+    for (unsigned i = 0; i < n; i++) {
+        stripes[i].offset = i * per;
+        stripes[i].length = (i == n - 1) ? size - i * per : per;
+    }
+    return stripes;
+}
+
+// Request size, alignment and queue depth for overwriting devicePath, from
+// its queue limits and, if asked for and nothing has been written yet, a
+// short calibration run at the start of the disk.
+static IoPlan planOverwrite(const std::string& devicePath, const WipeOptions& opts,
+                            bool mayCalibrate) {
+    int fd = open(devicePath.c_str(), O_RDONLY);
+    QueueLimits limits;
+    if (fd >= 0) {
+        limits = readQueueLimits(fd, blockDeviceName(devicePath));
+        close(fd);
+    }
+    IoPlan plan = planIo(limits, opts.requestSize, opts.queueDepth);
+
+    if (opts.calibrate && mayCalibrate && opts.requestSize == 0) {
+        fd = open(devicePath.c_str(), O_WRONLY | O_DIRECT);
+        uint64_t size = 0;
+        if (fd >= 0 && ioctl(fd, BLKGETSIZE64, &size) == 0) {
+            calibrateIo(fd, size, plan);
+        } else {
+            std::cerr << "Skipping I/O calibration: cannot open " << devicePath << " with O_DIRECT\n";
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    std::cout << devicePath << ": " << describePlan(plan) << "\n";
+    return plan;
+}
+
+// Writes the factory's pattern over the whole device `passes` times,
+// optionally split into stripes that are written concurrently. With
+// `offload` the kernel zeroes each stripe and the source is only used for
+// ranges it refuses, so the source must produce zeros.
+//
+// With a journal, stripes are written in CHECKPOINT_SEGMENT pieces and a
+// background thread periodically fsyncs and records how far each got in
+// `cp`. A `cp` that already has stripes is a resume: the layout is reused
+// and every stripe continues from its recorded position.
+//
+// With a verifier, each segment of the last pass is handed to it once the
+// stripe's writer is opts.verifyLag segments further on, so read-back
+// overlaps the rest of the pass.
+static bool mpOverwrite(const std::string& devicePath, const SourceFactory& makeSource,
+                        const WipeOptions& opts, const IoPlan& plan, unsigned passes,
+                        bool offload = false,
+                        CheckpointJournal* journal = nullptr, WipeCheckpoint* cp = nullptr,
+                        PipelinedVerifier* verifier = nullptr) {
+    bool uring = !offload && useUringEngine(opts);
+    bool direct = opts.directIO;
+
+    int fd = openForOverwrite(devicePath, uring, direct);
+    if (fd < 0) return false;
+
     uint64_t size = 0;
     if (ioctl(fd, BLKGETSIZE64, &size) < 0) {
         perror("BLKGETSIZE64");
@@ -43,177 +192,688 @@ bool mpOverwrite(const std::string& devicePath){
         return false;
     }
 
-    constexpr size_t BLKSIZE = 1024 * 1024; // 1 MiB
-    std::vector<char> zeroBuf(BLKSIZE, 0);
+    const size_t blockSize = plan.requestSize;
+    // Segments stay whole requests so a resume starts on a request boundary.
+    const uint64_t segment = std::max<uint64_t>(1, CHECKPOINT_SEGMENT / blockSize) * blockSize;
+
+    std::vector<Stripe> stripes;
+    if (cp && !cp->stripes.empty()) {
+        stripes = std::vector<Stripe>(cp->stripes.size());
+        for (size_t i = 0; i < stripes.size(); i++) {
+            stripes[i].offset = cp->stripes[i].offset;
+            stripes[i].length = cp->stripes[i].length;
+            stripes[i].written = cp->stripes[i].written;
+        }
+    } else {
+        stripes = splitStripes(size, chooseStripeCount(devicePath, size, blockSize, opts), blockSize);
+        if (cp) {
+            for (const Stripe& s : stripes) cp->stripes.push_back({ s.offset, s.length, 0 });
+        }
+    }
 
+    // Stripes wait for each other at the end of every pass, so they all
+    // restart in the pass the slowest one was in.
+    unsigned startPass = passes;
+    uint64_t alreadyWritten = 0;
+    for (Stripe& s : stripes) {
+        startPass = std::min<unsigned>(startPass, s.written / s.length);
+        alreadyWritten += s.written;
+    }
+    for (Stripe& s : stripes) s.passesDone = startPass;
+
+    // Every write is charged to the device's bandwidth share before it is
+    // issued; offloaded chunks are charged as the kernel finishes them.
+    std::unique_ptr<DeviceThrottle> share;
+    WriteThrottle* throttle = opts.throttle;
+    if (!throttle && opts.qos) {
+        share = opts.qos->attach(devicePath, size * passes - alreadyWritten, opts.qosWeight);
+        throttle = share.get();
+    }
 
-    for (int pass = 0; pass < MP_NUM_PASSES; pass++) {
-        if (lseek(fd, 0, SEEK_SET) < 0) {
-            perror("lseek");
+    // Sources are built up front: the arena is not thread-safe.
+    BufferArena arena(plan.alignment, placementNode(devicePath));
+    std::vector<std::unique_ptr<ChunkSource>> sources;
+    for (size_t i = 0; i < stripes.size(); i++) {
+        std::unique_ptr<ChunkSource> src = makeSource(arena, blockSize);
+        if (!src) {
+            std::cerr << "Failed to allocate wipe buffers\n";
             close(fd);
             return false;
         }
+        if (throttle && !offload) src = std::make_unique<ThrottledSource>(std::move(src), *throttle);
+        sources.push_back(std::move(src));
+    }
 
-        uint64_t written = 0;
-        while (written < size) {
-            size_t toWrite = std::min<uint64_t>(BLKSIZE, size - written);
-            ssize_t w = write(fd, zeroBuf.data(), toWrite);
+    std::atomic<bool> aborted{false};
 
-            if (w < 0) {
-                perror("write");
-                close(fd);
-                return false;
-            }
-            written += w;
+    WipeProgress& progress = *opts.progress;
+    progress.start(WipePhase::WRITING, size * passes, passes, alreadyWritten);
+    progress.setPass(startPass + 1);
+    unsigned completedPasses = startPass;
+
+    // Only what has reached the media may be recorded as written.
+    auto saveCheckpoint = [&]() {
+        std::vector<uint64_t> written;
+        for (const Stripe& s : stripes) written.push_back(s.written);
+        if (fsync(fd) < 0) {
+            perror("fsync");
+            return;
         }
+        for (size_t i = 0; i < stripes.size(); i++) cp->stripes[i].written = written[i];
+        if (!journal->save(*cp)) std::cerr << "Failed to save checkpoint " << journal->path() << "\n";
+    };
+
+    if (journal && !journal->save(*cp)) {
+        std::cerr << "Cannot write " << journal->path() << ", continuing without checkpoints\n";
+        journal = nullptr;
+    }
 
+    std::mutex ckMtx;
+    std::condition_variable ckCv;
+    bool writersDone = false;
+    std::thread checkpointer;
+    if (journal) {
+        checkpointer = std::thread([&] {
+            std::unique_lock<std::mutex> lock(ckMtx);
+            auto interval = std::chrono::seconds(opts.checkpointSeconds);
+            while (!ckCv.wait_for(lock, interval, [&] { return writersDone; })) {
+                lock.unlock();
+                saveCheckpoint();
+                lock.lock();
+            }
+        });
+    }
+    auto reportChunk = [&](uint64_t n) {
+        progress.add(n);
+        if (throttle) throttle->consume(n);
+    };
+
+    // Every stripe finishes pass N before the device is flushed and pass N+1
+    // starts; a failed stripe drops out so the others are not left waiting.
+    std::barrier passDone((std::ptrdiff_t)stripes.size(), [&]() noexcept {
+        // Still needed with O_DIRECT: this is what flushes the drive's own
+        // volatile write cache.
+        progress.setPhase(WipePhase::FLUSHING);
         if (fsync(fd) < 0) {
             perror("fsync");
-            close(fd);
-            return false;
+            aborted = true;
+        }
+
+        ProgressSnapshot snap = progress.snapshot();
+        completedPasses++;
+        std::cout << devicePath << ": pass " << completedPasses << "/" << passes
+                  << " done, " << (unsigned)(snap.averageRate / 1e6) << " MB/s average\n";
+        if (completedPasses < passes) {
+            progress.setPass(completedPasses + 1);
+            progress.setPhase(WipePhase::WRITING);
         }
+    });
+
+    auto worker = [&](size_t i) {
+        Stripe& s = stripes[i];
+        ChunkSource& src = *sources[i];
+
+        UringWriter writer;
+        bool useRing = uring && writer.init(fd, src, plan.queueDepth, &progress);
+        if (uring && !useRing) {
+            std::cerr << "io_uring setup failed, falling back to synchronous writes\n";
+        }
+
+        auto writeSegment = [&](uint64_t offset, uint64_t length) {
+            if (offload) {
+                return offloadRange(fd, OffloadOp::ZEROOUT, offset, length,
+                                    OFFLOAD_CHUNK, &src, blockSize, reportChunk);
+            }
+            if (useRing) return writer.writeRange(offset, length, blockSize);
+            return syncWriteRange(fd, offset, length, src, blockSize, &progress);
+        };
+
+        for (unsigned pass = startPass; pass < passes; pass++) {
+            if (aborted) {
+                s.failed = true;
+                passDone.arrive_and_drop();
+                return;
+            }
+
+            uint64_t base = (uint64_t)pass * s.length;
+            uint64_t from = s.written > base ? std::min(s.length, s.written - base) : 0;
+
+            if (offload && pass == 0 && from == 0 && opts.secureDiscard &&
+                !offloadRange(fd, OffloadOp::SECURE_DISCARD, s.offset, s.length,
+                              OFFLOAD_CHUNK, nullptr, blockSize, nullptr)) {
+                std::cerr << "Secure discard failed, continuing with zeroing\n";
+            }
+
+            // Written segments of the last pass the verifier has not had yet.
+            // Whatever a resumed pass wrote before the interruption is
+            // already on the media.
+            bool verifyPass = verifier && pass + 1 == passes;
+            std::deque<VerifyRange> behind;
+            if (verifyPass && from > 0) verifier->submit(s.offset, from);
+
+            bool ok = true;
+            if (from < s.length) src.begin(pass, s.offset + from, s.length - from);
+            for (uint64_t pos = from; ok && pos < s.length; ) {
+                // Segments only matter for checkpoints, read-back and
+                // cancellation; without them the whole stripe goes to the
+                // engine in one call.
+                bool segmented = journal || verifyPass || opts.cancel;
+                uint64_t len = segmented ? std::min(segment, s.length - pos) : s.length - pos;
+                if (opts.cancel && opts.cancel->load(std::memory_order_relaxed)) {
+                    ok = false;
+                    break;
+                }
+                ok = writeSegment(s.offset + pos, len);
+                if (ok) {
+                    if (verifyPass) {
+                        behind.push_back({ s.offset + pos, len });
+                        if (behind.size() > opts.verifyLag) {
+                            verifier->submit(behind.front().offset, behind.front().length);
+                            behind.pop_front();
+                        }
+                    }
+                    pos += len;
+                    s.written = base + pos;
+                }
+            }
+            if (ok && src.healthy()) {
+                for (const VerifyRange& r : behind) verifier->submit(r.offset, r.length);
+            }
+            if (!ok || !src.healthy()) {
+                s.failed = true;
+                aborted = true;
+                passDone.arrive_and_drop();
+                return;
+            }
+
+            s.passesDone++;
+            passDone.arrive_and_wait();
+        }
+    };
+
+    if (stripes.size() == 1) {
+        worker(0);
+    } else {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < stripes.size(); i++) {
+            workers.emplace_back(worker, i);
+        }
+        for (auto& t : workers) t.join();
+    }
+
+    bool ok = !aborted;
+    for (const Stripe& s : stripes) {
+        if (s.failed || (unsigned)s.passesDone != passes) ok = false;
+    }
+
+    if (journal) {
+        {
+            std::lock_guard<std::mutex> lock(ckMtx);
+            writersDone = true;
+        }
+        ckCv.notify_all();
+        checkpointer.join();
+
+        // A finished wipe has nothing to resume; a failed one keeps its
+        // latest position for the next attempt.
+        if (ok) journal->remove();
+        else saveCheckpoint();
     }
 
     close(fd);
-    return true;
-    
-    return true;
+    return ok;
 }
 
+static uint64_t deviceSize(const std::string& devicePath, int& logicalBlock) {
+    int fd = open(devicePath.c_str(), O_RDONLY);
+    if (fd < 0) return 0;
+    uint64_t size = 0;
+    if (ioctl(fd, BLKGETSIZE64, &size) < 0) size = 0;
+    if (ioctl(fd, BLKSSZGET, &logicalBlock) < 0) logicalBlock = 512;
+    close(fd);
+    return size;
+}
 
-bool ataSecureErase(const std::string& devicePath) {
-    const char* hdparm = "hdparm";
-    const char* pass   = "wipe";
+// ErasedChecker judges each logical block on its own, so it must be given
+// the device's block size; 4Kn drives would be misjudged at 512.
+static CheckerFactory erasedCheckerFor(const std::string& devicePath) {
+    int logicalBlock = 512;
+    deviceSize(devicePath, logicalBlock);
+    return [logicalBlock] { return std::make_unique<ErasedChecker>(logicalBlock); };
+}
 
-    /* Step 1: check security state */
-    if (!runHdparm({hdparm, "-I", devicePath.c_str(), nullptr})) {
-        std::cerr << "Failed to read drive identity\n";
-        return false;
+// Checkpointing for an overwrite of `method` with `scheme`. Fills `cp` from
+// the disk's checkpoint when it belongs to the same kind of wipe, otherwise
+// starts a fresh one. Returns nullptr when checkpoints are off, the device cannot
+// be sized, or it has no stable identity to key the checkpoint by.
+static std::unique_ptr<CheckpointJournal> openJournal(const std::string& devicePath,
+                                                      WipeMethod method,
+                                                      const WipeScheme& scheme,
+                                                      const WipeOptions& opts,
+                                                      WipeCheckpoint& cp) {
+    if (opts.checkpointSeconds == 0) return nullptr;
+
+    int logicalBlock = 512;
+    uint64_t size = deviceSize(devicePath, logicalBlock);
+    if (size == 0) return nullptr;
+
+    // Without a WWID or serial the id falls back to name and size, which
+    // another disk of the same size can share; resuming its checkpoint
+    // would skip regions of this one that were never written.
+    bool stable = false;
+    std::string id = deviceIdentity(blockDeviceName(devicePath), &stable);
+    if (!stable) {
+        std::cout << devicePath << " has no stable identity, not checkpointing\n";
+        return nullptr;
     }
-
-    /* Step 2: set temporary password */
-    if (!runHdparm({
-            hdparm,
-            "--user-master", "u",
-            "--security-set-pass", pass,
-            devicePath.c_str(),
-            nullptr
-        })) {
-        std::cerr << "Failed to set ATA security password\n";
-        return false;
+    auto journal = std::make_unique<CheckpointJournal>(opts.journalDir, id);
+
+    WipeCheckpoint old;
+    if (journal->load(old)) {
+        uint64_t covered = 0, written = 0;
+        bool layoutOk = !old.stripes.empty();
+        for (const StripeCheckpoint& s : old.stripes) {
+            if (s.length == 0 || s.offset != covered) layoutOk = false;
+            covered += s.length;
+            written += s.written;
+        }
+        bool matches = old.deviceId == id && old.method == (int)method &&
+                       old.scheme == scheme.name && old.size == size &&
+                       old.passes == scheme.passes.size() &&
+                       layoutOk && covered == size &&
+                       (!scheme.hasRandom() || old.hasKey);
+
+        if (opts.resume && matches) {
+            cp = old;
+            cp.resumeCount++;
+            std::cout << "Resuming wipe of " << devicePath << " from checkpoint, "
+                      << written * 100 / (size * old.passes) << "% already written\n";
+            return journal;
+        }
+        std::cout << "Discarding checkpoint " << journal->path()
+                  << (matches ? " (resume disabled)\n" : " (different wipe)\n");
     }
 
-    /* Step 3: issue secure erase */
-    std::cout << "Starting ATA Secure Erase on " << devicePath << "\n";
+    cp = WipeCheckpoint{};
+    cp.deviceId = id;
+    cp.method = (int)method;
+    cp.size = size;
+    cp.scheme = scheme.name;
+    cp.passes = scheme.passes.size();
+    cp.startTime = time(nullptr);
+    return journal;
+}
+
+static void recordResume(const WipeCheckpoint& cp, WipeResult& result) {
+    result.resume_count = cp.resumeCount;
+    result.first_start_time = cp.resumeCount ? cp.startTime : result.start_time;
+}
 
-    if (!runHdparm({
-            hdparm,
-            "--user-master", "u",
-            "--security-erase", pass,
-            devicePath.c_str(),
-            nullptr
-        })) {
-        std::cerr << "ATA Secure Erase failed\n";
+// The ranges opts.verify asks to read back; the sampling parameters go into
+// `result` so the certificate can reproduce them.
+static bool planVerification(const std::string& devicePath, const WipeOptions& opts,
+                             WipeResult& result, std::vector<VerifyRange>& ranges) {
+    int logicalBlock = 512;
+    uint64_t size = deviceSize(devicePath, logicalBlock);
+    if (size == 0) {
+        std::cerr << "Verification: cannot size " << devicePath << "\n";
         return false;
     }
 
-    std::cout << "ATA Secure Erase completed successfully\n";
+    if (opts.verify == VerifyMode::FULL) {
+        result.verify_mode = "full";
+        ranges = fullRanges(size);
+    } else {
+        SamplingPlan plan = opts.sampling;
+        if (plan.seed == 0) {
+            std::random_device rd;
+            plan.seed = ((uint64_t)rd() << 32) | rd();
+        }
+        if (opts.verifyCoverage > 0) setSamplingCoverage(plan, size, opts.verifyCoverage);
+        ranges = sampleRanges(size, plan, SAMPLE_ALIGN);
+
+        result.verify_mode = "sampled";
+        result.verify_seed = plan.seed;
+        result.verify_regions = plan.regions;
+        result.verify_samples_per_region = plan.samplesPerRegion;
+        result.verify_sample_bytes = plan.sampleBytes;
+        result.verify_edge_bytes = plan.edgeBytes;
+        result.verify_sample_align = SAMPLE_ALIGN;
+        result.verify_coverage = rangeCoverage(ranges, size);
+        std::cout << "Sampling " << ranges.size() << " ranges, "
+                  << result.verify_coverage * 100 << "% of the device (seed "
+                  << plan.seed << ")\n";
+    }
     return true;
 }
 
-static bool runNvme(const std::vector<const char*>& args) {
-    pid_t pid = fork();
-    if (pid == 0) {
-        execvp(args[0], const_cast<char* const*>(args.data()));
-        _exit(127);
+static unsigned verifyThreadCount(const WipeOptions& opts) {
+    if (opts.verifyThreads) return opts.verifyThreads;
+    return std::min(8u, std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Records `report` in `result`. Returns false on any mismatch or read error.
+static bool recordVerification(const std::string& devicePath, const VerifyReport& report,
+                               WipeResult& result) {
+    int logicalBlock = 512;
+    deviceSize(devicePath, logicalBlock);
+
+    result.verify_bytes = report.bytesChecked;
+    result.verify_mismatched_blocks = report.mismatchedBlocks + report.unreadableBlocks;
+    for (const VerifyRange& r : report.badRanges) {
+        result.verify_bad_lbas.push_back({ r.offset / logicalBlock, r.length / logicalBlock });
     }
+    result.verify_bad_lbas_truncated = report.rangesTruncated;
+
+    std::cout << "Verification (" << result.verify_mode << "): "
+              << report.blocksChecked << " blocks, "
+              << report.mismatchedBlocks << " mismatched, "
+              << report.unreadableBlocks << " unreadable\n";
+    return report.ok();
+}
 
-    int status;
-    waitpid(pid, &status, 0);
-    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+// Reads the device back according to opts.verify and records the outcome
+// in `result`. Returns false on any mismatch or read error.
+static bool runVerification(const std::string& devicePath, const CheckerFactory& makeChecker,
+                            const WipeOptions& opts, WipeResult& result) {
+    std::vector<VerifyRange> ranges;
+    if (!planVerification(devicePath, opts, result, ranges)) return false;
+
+    uint64_t verifyTotal = 0;
+    for (const VerifyRange& r : ranges) verifyTotal += r.length;
+    opts.progress->start(WipePhase::VERIFYING, verifyTotal);
+
+    VerifyReport report = verifyRanges(devicePath, ranges, makeChecker,
+                                       verifyThreadCount(opts), VERIFY_BLKSIZE,
+                                       opts.progress);
+    return recordVerification(devicePath, report, result);
 }
 
+// Runs every pass of `scheme` over the device. RANDOM passes are keystreams
+// derived from a key that only exists for the duration of the wipe (and in
+// its checkpoint, so an interrupted wipe can continue the same stream).
+// Verification checks the last pass, regenerating a keystream rather than
+// remembering it.
+static bool schemeOverwrite(const std::string& devicePath, WipeMethod method,
+                            const WipeScheme& scheme, const WipeOptions& opts,
+                            WipeResult& result) {
+    WipeCheckpoint cp;
+    std::unique_ptr<CheckpointJournal> journal =
+        openJournal(devicePath, method, scheme, opts, cp);
+
+    KeystreamKey key{};
+    if (scheme.hasRandom()) {
+        if (journal && cp.hasKey) {
+            key = cp.key;
+        } else {
+            if (!newEphemeralKey(preferredCipher(), key)) return false;
+            cp.key = key;
+            cp.hasKey = true;
+        }
+        std::cout << "Random passes use " << cipherName(key.cipher) << " keystream\n";
+    }
+
+    // Enough buffers to keep the whole queue in flight plus one being
+    // generated per thread.
+    unsigned threads = std::max(1u, opts.keystreamThreads);
+    IoPlan plan = planOverwrite(devicePath, opts, cp.stripes.empty());
+    unsigned slots = std::max(8u, std::min(plan.queueDepth, 32u)) + threads;
+
+    WipeOptions verifyOpts = opts;
+    if (verifyOpts.verify == VerifyMode::NONE && scheme.verifyLastPass) {
+        verifyOpts.verify = VerifyMode::SAMPLED;
+    }
+    unsigned last = scheme.passes.size() - 1;
+    const PassPattern& lastPattern = scheme.passes[last];
+    CheckerFactory makeChecker = [&]() -> std::unique_ptr<BlockChecker> {
+        if (lastPattern.kind == PassPattern::RANDOM) {
+            return std::make_unique<KeystreamChecker>(key, last, VERIFY_BLKSIZE);
+        }
+        return std::make_unique<PatternChecker>(lastPattern, VERIFY_BLKSIZE);
+    };
+
+    // Pipelined read-back starts with the last pass rather than after it.
+    std::unique_ptr<PipelinedVerifier> verifier;
+    if (verifyOpts.verify != VerifyMode::NONE && opts.pipelineVerify) {
+        std::vector<VerifyRange> ranges;
+        if (!planVerification(devicePath, verifyOpts, result, ranges)) return false;
+        std::cout << "Verifying last pass (" << lastPattern.describe() << ", "
+                  << simdKernelName() << " kernel) " << opts.verifyLag
+                  << " segments behind the writer\n";
+        verifier = std::make_unique<PipelinedVerifier>(devicePath, std::move(ranges), makeChecker,
+                                                        verifyThreadCount(opts), VERIFY_BLKSIZE);
+    }
+
+    bool offload = scheme.allZero() && useOffloadEngine(devicePath, opts);
+    bool ok = mpOverwrite(devicePath, [&](BufferArena& arena, size_t blockSize) {
+        return makeSchemeSource(arena, blockSize, scheme, key, slots, threads);
+    }, opts, plan, scheme.passes.size(), offload, journal.get(), &cp, verifier.get());
+    recordResume(cp, result);
+
+    if (ok && verifier) {
+        ok = recordVerification(devicePath, verifier->finish(opts.progress), result);
+    } else if (ok && verifyOpts.verify != VerifyMode::NONE) {
+        std::cout << "Verifying last pass (" << lastPattern.describe() << ", "
+                  << simdKernelName() << " kernel)\n";
+        ok = runVerification(devicePath, makeChecker, verifyOpts, result);
+    }
+    verifier.reset();
+
+    OPENSSL_cleanse(key.key.data(), key.key.size());
+    OPENSSL_cleanse(cp.key.key.data(), cp.key.key.size());
+    return ok;
+}
 
-bool nvmeSanitize(const std::string& devicePath) {
-    const char* nvme = "nvme";
+// The scheme named in opts, or the method's own: three zero passes for
+// PLAIN_OVERWRITE, three keystream passes for ENCRYPTED_OVERWRITE.
+static bool resolveScheme(WipeMethod method, const WipeOptions& opts, WipeScheme& scheme) {
+    std::string spec = opts.scheme;
+    if (spec.empty()) spec = method == WipeMethod::ENCRYPTED_OVERWRITE ? "random" : "zero";
 
-    /* Step 1: sanity check – identify controller */
-    if (!runNvme({nvme, "id-ctrl", devicePath.c_str(), nullptr})) {
-        std::cerr << "Failed to identify NVMe controller\n";
+    std::string error;
+    if (!parseScheme(spec, scheme, error)) {
+        std::cerr << "Invalid wipe scheme: " << error << "\n";
         return false;
     }
+    return true;
+}
+
+
+// Security erase through the native ATA layer. The drive decides what an
+// erase covers; enhanced also reaches reallocated and spare sectors.
+// `enhanced` is set to whether the drive was asked for the enhanced erase.
+bool ataSecureErase(const std::string& devicePath, bool preferEnhanced, bool& enhanced,
+                    WipeProgress& progress) {
+    SgIoTransport transport(devicePath);
+    std::cout << "Starting ATA Secure Erase on " << devicePath << "\n";
+    AtaError err = ataSecurityErase(transport, preferEnhanced, &progress, &enhanced);
+    if (!err.ok()) {
+        std::cerr << "ATA Secure Erase failed: " << err.describe() << "\n";
+        return false;
+    }
+
+    std::cout << "ATA Secure Erase completed successfully\n";
+    return true;
+}
+
+// Firmware erase through the native NVMe admin layer: sanitize with the
+// strongest action the controller offers (crypto, then block erase, then
+// overwrite), or Format NVM with secure erase where there is no sanitize.
+// Sanitize runs in the background after the command returns; its status
+// log is polled for progress and for the final state.
+bool nvmeFirmwareErase(NvmeTransport& nvme, std::string& noPattern, WipeProgress& progress,
+                       WipeResult& result) {
+    NvmeController ctrl;
+    NvmeError err = nvmeIdentifyController(nvme, ctrl);
+    if (!err.ok()) {
+        std::cerr << "Failed to identify NVMe controller: " << err.describe() << "\n";
+        return false;
+    }
+
+    time_t start = time(nullptr);
+    std::vector<SanitizeAction> actions;
+    if (ctrl.sanitizeCrypto) actions.push_back(SanitizeAction::CRYPTO_ERASE);
+    if (ctrl.sanitizeBlock) actions.push_back(SanitizeAction::BLOCK_ERASE);
+    if (ctrl.sanitizeOverwrite) actions.push_back(SanitizeAction::OVERWRITE);
+
+    for (SanitizeAction action : actions) {
+        std::cout << "Starting NVMe " << sanitizeActionName(action) << " sanitize on "
+                  << ctrl.model << "\n";
+        err = nvmeStartSanitize(nvme, action);
+        if (!err.ok()) {
+            std::cerr << "Sanitize " << sanitizeActionName(action) << " rejected: "
+                      << err.describe() << "\n";
+            continue;
+        }
 
-    /*
-     * Step 2: attempt crypto erase first
-     * -a 4 = crypto erase
-     * --force required by nvme-cli for destructive ops
-     */
-    std::cout << "Attempting NVMe crypto sanitize...\n";
-
-    if (runNvme({
-            nvme,
-            "sanitize",
-            devicePath.c_str(),
-            "-a", "4",
-            "--force",
-            nullptr
-        })) {
-        std::cout << "NVMe crypto sanitize completed\n";
+        SanitizeStatus status;
+        err = waitForSanitize(nvme, action, &progress, status);
+        result.erase_status = status.state;
+        result.erase_seconds = time(nullptr) - start;
+        if (!err.ok()) {
+            std::cerr << "NVMe sanitize failed: " << err.describe() << "\n";
+            return false;
+        }
+        result.erase_action = std::string("nvme-sanitize-") + sanitizeActionName(action);
+        // Only overwrite writes a pattern of our choosing; block erase
+        // contents are vendor-specific and crypto erase leaves ciphertext.
+        if (action == SanitizeAction::CRYPTO_ERASE) {
+            noPattern = "Crypto erase leaves no readable pattern";
+        } else if (action == SanitizeAction::BLOCK_ERASE) {
+            noPattern = "Block erase leaves vendor-specific contents";
+        }
+        std::cout << "NVMe " << sanitizeActionName(action) << " sanitize completed in "
+                  << result.erase_seconds << "s\n";
         return true;
     }
 
-    /*
-     * Step 3: fallback to block erase
-     * -a 2 = block erase
-     */
-    std::cout << "Crypto sanitize unsupported, falling back to block erase...\n";
-
-    if (!runNvme({
-            nvme,
-            "sanitize",
-            devicePath.c_str(),
-            "-a", "2",
-            "--force",
-            nullptr
-        })) {
-        std::cerr << "NVMe sanitize failed\n";
+    if (!ctrl.formatSupported) {
+        std::cerr << "NVMe controller offers neither sanitize nor format\n";
         return false;
     }
 
-    std::cout << "NVMe block sanitize completed\n";
+    // SES 2 destroys the media encryption key; SES 1 erases user data.
+    uint8_t ses = ctrl.formatCryptoErase ? 2 : 1;
+    // Format NVM also sets the LBA format, so the current one has to be
+    // known; through the controller device there is no namespace to ask.
+    uint32_t nsid = nvme.namespaceId();
+    if (nsid == 0) {
+        std::cerr << "NVMe format needs a namespace device to read its LBA format from\n";
+        return false;
+    }
+    NvmeNamespace ns;
+    if (!(err = nvmeIdentifyNamespace(nvme, nsid, ns)).ok()) {
+        std::cerr << "Failed to identify namespace: " << err.describe() << "\n";
+        return false;
+    }
+    if (ctrl.formatAllNamespaces) nsid = 0xffffffff;
+
+    std::cout << "Formatting NVMe namespace with secure erase (SES " << (unsigned)ses << ")\n";
+    progress.start(WipePhase::ERASING, 0);
+    err = nvmeFormat(nvme, nsid, ses, ns.formatIndex);
+    result.erase_seconds = time(nullptr) - start;
+    if (!err.ok()) {
+        std::cerr << "NVMe format failed: " << err.describe() << "\n";
+        return false;
+    }
+    result.erase_action = ses == 2 ? "nvme-format-crypto-erase" : "nvme-format-user-data-erase";
+    // Neither secure erase setting defines what the media reads back as.
+    noPattern = ses == 2 ? "Crypto erase leaves no readable pattern"
+                         : "User data erase leaves indeterminate contents";
     return true;
 }
 
 WipeResult wipeDisk(const std::string& devicePath, WipeMethod
-        method){
+        method, const WipeOptions& opts_){
+
+    // Every backend reports into a progress object, the caller's or our own.
+    WipeOptions opts = opts_;
+    WipeProgress localProgress;
+    if (!opts.progress) opts.progress = &localProgress;
 
     WipeResult result = {};
     result.device_path = devicePath;
     result.method = method;
     result.start_time = time(nullptr);
     result.tool_version = "zt-wipe 1.0";
+    result.verify_mode = "none";
+
+    // Writers, keystream generators and verifiers all start from this thread
+    // and inherit its CPU mask, so pinning here keeps the whole wipe on the
+    // controller's socket. Buffers follow through BufferArena.
+    int node = placementNode(devicePath);
+    NodeAffinity affinity(node);
+    if (affinity.pinned()) std::cout << devicePath << ": running on NUMA node " << node << "\n";
+
+    // An exclusive open fails while the disk is mounted or claimed by md,
+    // dm or swap, and for as long as it is held, a desktop auto-mounting
+    // the disk mid-wipe gets EBUSY instead. The writers open their own
+    // non-exclusive fds; the kernel only refuses other exclusive claims.
+    int claim = open(devicePath.c_str(), O_RDONLY | O_EXCL | O_CLOEXEC);
+    if (claim < 0) {
+        result.failure = errno == EBUSY ? "device is in use (mounted or held by another device)"
+                                        : std::string("cannot open device: ") + strerror(errno);
+        std::cerr << devicePath << ": " << result.failure << "\n";
+        result.end_time = time(nullptr);
+        result.status = WipeStatus::FAILURE;
+        opts.progress->setPhase(WipePhase::FAILED);
+        return result;
+    }
 
     bool ok = false;
 
     switch(method){
-        case WipeMethod::ATA_SECURE_ERASE:
-            ok = ataSecureErase(devicePath);
+        case WipeMethod::ATA_SECURE_ERASE: {
+            bool enhanced = false;
+            ok = ataSecureErase(devicePath, opts.ataEnhanced, enhanced, *opts.progress);
+            result.erase_action = enhanced ? "ata-enhanced-security-erase" : "ata-security-erase";
+            result.erase_seconds = time(nullptr) - result.start_time;
+            if (ok && opts.verify != VerifyMode::NONE) {
+                if (enhanced) {
+                    // The normal erase writes zeros or ones; the enhanced one
+                    // writes whatever pattern the vendor chose, maybe random.
+                    std::cout << "Enhanced erase leaves a vendor pattern, skipping verification\n";
+                    result.verify_mode = "skipped";
+                } else {
+                    ok = runVerification(devicePath, erasedCheckerFor(devicePath), opts, result);
+                }
+            }
             break;
-        case WipeMethod::FIRMWARE_ERASE:
-            ok = nvmeSanitize(devicePath);
+        }
+        case WipeMethod::FIRMWARE_ERASE: {
+            std::string noPattern;
+            IoctlNvmeTransport nvme(devicePath);
+            ok = nvmeFirmwareErase(nvme, noPattern, *opts.progress, result);
+            if (ok && opts.verify != VerifyMode::NONE) {
+                if (!noPattern.empty()) {
+                    std::cout << noPattern << ", skipping verification\n";
+                    result.verify_mode = "skipped";
+                } else {
+                    ok = runVerification(devicePath, erasedCheckerFor(devicePath),
+                                         opts, result);
+                }
+            }
             break;
+        }
         case WipeMethod::PLAIN_OVERWRITE:
-            ok = mpOverwrite(devicePath);
-            break;
-        case WipeMethod::ENCRYPTED_OVERWRITE:
+        case WipeMethod::ENCRYPTED_OVERWRITE: {
+            WipeScheme scheme;
+            if (!resolveScheme(method, opts, scheme)) break;
+            result.scheme = scheme.name;
+            for (const PassPattern& p : scheme.passes) result.scheme_passes.push_back(p.describe());
+            std::cout << "Wipe scheme " << scheme.name << ": " << scheme.passes.size() << " passes\n";
+            ok = schemeOverwrite(devicePath, method, scheme, opts, result);
             break;
+        }
         default:
             std::cout << "Unsupported Wipe Method\n";
 
     }
 
 
+    close(claim);
     result.end_time = time(nullptr);
     result.status = ok ? WipeStatus::SUCCESS : WipeStatus::FAILURE;
+    opts.progress->setPhase(ok ? WipePhase::DONE : WipePhase::FAILED);
     return result;
 }
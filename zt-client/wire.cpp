@@ -0,0 +1,89 @@
+#include "include/wire.hpp"
+#include <unistd.h>
+#include <cerrno>
+
+static bool writeAll(int fd, const uint8_t* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        p += w;
+        n -= w;
+    }
+    return true;
+}
+
+static bool readAll(int fd, uint8_t* p, size_t n) {
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+bool writeFrame(int fd, const nlohmann::json& msg) {
+    std::string body = msg.dump();
+    if (body.size() > MAX_FRAME_BYTES) return false;
+    uint32_t len = body.size();
+    uint8_t header[4] = { (uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t)len };
+    return writeAll(fd, header, 4) && writeAll(fd, (const uint8_t*)body.data(), body.size());
+}
+
+bool readFrame(int fd, nlohmann::json& msg) {
+    uint8_t header[4];
+    if (!readAll(fd, header, 4)) return false;
+    uint32_t len = (uint32_t)header[0] << 24 | (uint32_t)header[1] << 16 |
+                   (uint32_t)header[2] << 8 | header[3];
+    if (len > MAX_FRAME_BYTES) return false;
+
+    std::string body(len, '\0');
+    if (!readAll(fd, (uint8_t*)body.data(), len)) return false;
+    msg = nlohmann::json::parse(body, nullptr, false);
+    return !msg.is_discarded();
+}
+
+nlohmann::json deviceToJson(const Device& dev) {
+    nlohmann::json methods = nlohmann::json::array();
+    for (WipeMethod m : dev.supportedWipeMethods) methods.push_back(wipeMethodName(m));
+    return {
+        {"name", dev.name},
+        {"path", dev.path},
+        {"type", dev.type},
+        {"transport", dev.transport},
+        {"model", dev.model},
+        {"identity", dev.identity},
+        {"firmware", dev.firmware},
+        {"size_bytes", dev.sizeBytes},
+        {"removable", dev.isRemovable},
+        {"read_only", dev.isReadOnly},
+        {"methods", methods},
+        {"capabilities_unknown", dev.capabilitiesUnknown}
+    };
+}
+
+nlohmann::json jobToJson(const WipeJob& job) {
+    nlohmann::json j = {
+        {"job", job.id},
+        {"device", job.device.path},
+        {"method", wipeMethodName(job.method)},
+        {"state", jobStateName(job.state)}
+    };
+    if (!job.error.empty()) j["error"] = job.error;
+    if (job.state == JobState::DONE) j["certificate_recorded"] = job.certRecorded;
+    return j;
+}
+
+nlohmann::json progressToJson(const ProgressSnapshot& snap) {
+    return {
+        {"phase", wipePhaseName(snap.phase)},
+        {"pass", snap.pass},
+        {"passes", snap.passes},
+        {"bytes_done", snap.bytesDone},
+        {"bytes_total", snap.bytesTotal},
+        {"rate", snap.currentRate},
+        {"eta_seconds", snap.etaSeconds}
+    };
+}
@@ -0,0 +1,564 @@
+#include "include/worker.hpp"
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+extern char** environ;
+
+static constexpr size_t RING_SIZE = 64;
+static constexpr size_t SNAPSHOT_WORDS = (sizeof(ProgressSnapshot) + 7) / 8;
+static constexpr auto TICK = std::chrono::milliseconds(100);
+// After SIGKILL; a process stuck in the kernel does not die until its I/O returns.
+static constexpr auto REAP_TIMEOUT = std::chrono::seconds(5);
+// Where the worker finds its shared channel and result pipe.
+static constexpr int CHANNEL_FD = 3;
+static constexpr int RESULT_FD = 4;
+static const char* WORKER_COMMAND = "__wipe-worker";
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<bool>::is_always_lock_free,
+              "atomics shared between processes must be lock-free");
+
+// Seqlock slot: `seq` is 2n+1 while sample n is being written and 2n+2
+// once it is complete.
+struct WorkerSample {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> words[SNAPSHOT_WORDS];
+};
+
+// Mapped by both processes. The worker is the only writer of the ring and
+// of the throttle counters; the parent only writes `cancel` and `rate`.
+struct WorkerChannel {
+    std::atomic<uint64_t> head{0};      // samples ever published
+    WorkerSample ring[RING_SIZE];
+    std::atomic<bool>     cancel{false};
+
+    std::atomic<uint64_t> rate{0};      // bytes/s to pace at, 0 = unlimited
+    std::atomic<uint64_t> consumed{0};  // bytes charged so far
+    std::atomic<bool>     waited{false};
+};
+
+static void publish(WorkerChannel& ch, const ProgressSnapshot& snap) {
+    uint64_t words[SNAPSHOT_WORDS] = {};
+    memcpy(words, &snap, sizeof(snap));
+
+    uint64_t n = ch.head.load(std::memory_order_relaxed);
+    WorkerSample& s = ch.ring[n % RING_SIZE];
+    s.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < SNAPSHOT_WORDS; i++) s.words[i].store(words[i], std::memory_order_relaxed);
+    s.seq.store(2 * n + 2, std::memory_order_release);
+    ch.head.store(n + 1, std::memory_order_release);
+}
+
+// False if sample n is not complete or was overwritten while copying.
+static bool readSample(const WorkerChannel& ch, uint64_t n, ProgressSnapshot& out) {
+    const WorkerSample& s = ch.ring[n % RING_SIZE];
+    uint64_t before = s.seq.load(std::memory_order_acquire);
+    if (before != 2 * n + 2) return false;
+    uint64_t words[SNAPSHOT_WORDS];
+    for (size_t i = 0; i < SNAPSHOT_WORDS; i++) words[i] = s.words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s.seq.load(std::memory_order_relaxed) != before) return false;
+    memcpy(&out, words, sizeof(out));
+    return true;
+}
+
+// The worker's side of the parent's DeviceThrottle: paces at whatever
+// rate the parent last published and reports what it wrote.
+class SharedThrottle : public WriteThrottle {
+public:
+    explicit SharedThrottle(WorkerChannel& ch_) : ch(ch_) {}
+
+    void consume(uint64_t bytes) override {
+        uint64_t r = ch.rate.load(std::memory_order_relaxed);
+        if (applied.exchange(r) != r) bucket.setRate(r);
+        ch.consumed.fetch_add(bytes, std::memory_order_relaxed);
+        if (bucket.consume(bytes)) ch.waited.store(true, std::memory_order_relaxed);
+    }
+
+private:
+    WorkerChannel& ch;
+    TokenBucket bucket;
+    std::atomic<uint64_t> applied{0};
+};
+
+// Devices still open in workers that outlived SIGKILL; see abandon().
+static std::mutex heldMtx;
+static std::multiset<std::string> heldDevices;
+
+bool deviceHeldByWorker(const std::string& devicePath) {
+    std::lock_guard<std::mutex> lock(heldMtx);
+    return heldDevices.count(devicePath) > 0;
+}
+
+// Leaves `pid` to a thread that reaps it whenever the kernel lets go.
+static void abandon(pid_t pid, const std::string& devicePath) {
+    {
+        std::lock_guard<std::mutex> lock(heldMtx);
+        heldDevices.insert(devicePath);
+    }
+    std::thread([pid, devicePath] {
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        std::cerr << "Wipe worker " << pid << " for " << devicePath << " finally exited\n";
+        std::lock_guard<std::mutex> lock(heldMtx);
+        heldDevices.erase(heldDevices.find(devicePath));
+    }).detach();
+}
+
+// SIGKILLs `pid` and waits a little for it. False if it did not exit, in
+// which case it has been abandoned.
+static bool killWorker(pid_t pid, const std::string& devicePath, int& status) {
+    ::kill(pid, SIGKILL);
+    auto deadline = std::chrono::steady_clock::now() + REAP_TIMEOUT;
+    while (std::chrono::steady_clock::now() < deadline) {
+        pid_t r = waitpid(pid, &status, WNOHANG);
+        if (r == pid || (r < 0 && errno != EINTR)) return true;
+        std::this_thread::sleep_for(TICK);
+    }
+    abandon(pid, devicePath);
+    return false;
+}
+
+// Both sides are this executable, so the encoding only has to round-trip.
+// New WipeOptions and WipeResult fields must be added here too.
+static nlohmann::json optionsToJson(const WipeOptions& o) {
+    return {
+        {"engine", (int)o.engine}, {"queue_depth", o.queueDepth},
+        {"request_size", o.requestSize}, {"calibrate", o.calibrate},
+        {"direct_io", o.directIO}, {"stripes", o.stripes},
+        {"keystream_threads", o.keystreamThreads}, {"secure_discard", o.secureDiscard},
+        {"ata_enhanced", o.ataEnhanced}, {"scheme", o.scheme},
+        {"verify", (int)o.verify},
+        {"sampling", { {"seed", o.sampling.seed}, {"regions", o.sampling.regions},
+                       {"samples_per_region", o.sampling.samplesPerRegion},
+                       {"sample_bytes", o.sampling.sampleBytes},
+                       {"edge_bytes", o.sampling.edgeBytes} }},
+        {"verify_coverage", o.verifyCoverage}, {"verify_threads", o.verifyThreads},
+        {"pipeline_verify", o.pipelineVerify}, {"verify_lag", o.verifyLag},
+        {"qos_weight", o.qosWeight}, {"checkpoint_seconds", o.checkpointSeconds},
+        {"journal_dir", o.journalDir}, {"resume", o.resume}
+    };
+}
+
+static WipeOptions optionsFromJson(const nlohmann::json& j) {
+    WipeOptions o;
+    o.engine = (WipeEngine)j.at("engine").get<int>();
+    o.queueDepth = j.at("queue_depth");
+    o.requestSize = j.at("request_size");
+    o.calibrate = j.at("calibrate");
+    o.directIO = j.at("direct_io");
+    o.stripes = j.at("stripes");
+    o.keystreamThreads = j.at("keystream_threads");
+    o.secureDiscard = j.at("secure_discard");
+    o.ataEnhanced = j.at("ata_enhanced");
+    o.scheme = j.at("scheme");
+    o.verify = (VerifyMode)j.at("verify").get<int>();
+    const auto& s = j.at("sampling");
+    o.sampling.seed = s.at("seed");
+    o.sampling.regions = s.at("regions");
+    o.sampling.samplesPerRegion = s.at("samples_per_region");
+    o.sampling.sampleBytes = s.at("sample_bytes");
+    o.sampling.edgeBytes = s.at("edge_bytes");
+    o.verifyCoverage = j.at("verify_coverage");
+    o.verifyThreads = j.at("verify_threads");
+    o.pipelineVerify = j.at("pipeline_verify");
+    o.verifyLag = j.at("verify_lag");
+    o.qosWeight = j.at("qos_weight");
+    o.checkpointSeconds = j.at("checkpoint_seconds");
+    o.journalDir = j.at("journal_dir");
+    o.resume = j.at("resume");
+    return o;
+}
+
+static nlohmann::json resultToJson(const WipeResult& r) {
+    nlohmann::json bad = nlohmann::json::array();
+    for (const LbaRange& l : r.verify_bad_lbas) bad.push_back({l.first, l.count});
+    return {
+        {"device_path", r.device_path}, {"device_model", r.device_model},
+        {"device_serial", r.device_serial}, {"device_size", r.device_size},
+        {"method", (int)r.method}, {"status", (int)r.status},
+        {"start_time", r.start_time}, {"end_time", r.end_time},
+        {"tool_version", r.tool_version}, {"failure", r.failure},
+        {"erase_action", r.erase_action}, {"erase_seconds", r.erase_seconds},
+        {"erase_status", r.erase_status},
+        {"scheme", r.scheme}, {"scheme_passes", r.scheme_passes},
+        {"verify_mode", r.verify_mode}, {"verify_bytes", r.verify_bytes},
+        {"verify_mismatched_blocks", r.verify_mismatched_blocks},
+        {"verify_bad_lbas", bad}, {"verify_bad_lbas_truncated", r.verify_bad_lbas_truncated},
+        {"verify_seed", r.verify_seed}, {"verify_regions", r.verify_regions},
+        {"verify_samples_per_region", r.verify_samples_per_region},
+        {"verify_sample_bytes", r.verify_sample_bytes},
+        {"verify_edge_bytes", r.verify_edge_bytes}, {"verify_coverage", r.verify_coverage},
+        {"verify_sample_align", r.verify_sample_align},
+        {"resume_count", r.resume_count}, {"first_start_time", r.first_start_time}
+    };
+}
+
+static WipeResult resultFromJson(const nlohmann::json& j) {
+    WipeResult r{};
+    r.device_path = j.at("device_path");
+    r.device_model = j.at("device_model");
+    r.device_serial = j.at("device_serial");
+    r.device_size = j.at("device_size");
+    r.method = (WipeMethod)j.at("method").get<int>();
+    r.status = (WipeStatus)j.at("status").get<int>();
+    r.start_time = j.at("start_time");
+    r.end_time = j.at("end_time");
+    r.tool_version = j.at("tool_version");
+    r.failure = j.at("failure");
+    r.erase_action = j.at("erase_action");
+    r.erase_seconds = j.at("erase_seconds");
+    r.erase_status = j.at("erase_status");
+    r.scheme = j.at("scheme");
+    r.scheme_passes = j.at("scheme_passes").get<std::vector<std::string>>();
+    r.verify_mode = j.at("verify_mode");
+    r.verify_bytes = j.at("verify_bytes");
+    r.verify_mismatched_blocks = j.at("verify_mismatched_blocks");
+    for (const auto& l : j.at("verify_bad_lbas")) r.verify_bad_lbas.push_back({l.at(0), l.at(1)});
+    r.verify_bad_lbas_truncated = j.at("verify_bad_lbas_truncated");
+    r.verify_seed = j.at("verify_seed");
+    r.verify_regions = j.at("verify_regions");
+    r.verify_samples_per_region = j.at("verify_samples_per_region");
+    r.verify_sample_bytes = j.at("verify_sample_bytes");
+    r.verify_edge_bytes = j.at("verify_edge_bytes");
+    r.verify_sample_align = j.at("verify_sample_align");
+    r.verify_coverage = j.at("verify_coverage");
+    r.resume_count = j.at("resume_count");
+    r.first_start_time = j.at("first_start_time");
+    return r;
+}
+
+// Moves `fd` clear of CHANNEL_FD and RESULT_FD, so the child's dup2s
+// cannot overwrite one source with the other.
+static int raiseFd(int fd) {
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    close(fd);
+    return high;
+}
+
+WipeWorker::~WipeWorker() {
+    if (pid > 0) {
+        int status;
+        killWorker(pid, devicePath, status);
+    }
+    if (resultFd >= 0) close(resultFd);
+    if (channel) munmap(channel, sizeof(WorkerChannel));
+}
+
+bool WipeWorker::start(const std::string& devicePath_, WipeMethod method_,
+                       const WipeOptions& opts, std::string& error) {
+    devicePath = devicePath_;
+    method = method_;
+    qos = opts.qos;
+    qosWeight = opts.qosWeight;
+
+    int mem = memfd_create("zt-wipe-worker", MFD_CLOEXEC);
+    if (mem < 0 || ftruncate(mem, sizeof(WorkerChannel)) < 0) {
+        error = std::string("cannot create worker channel: ") + strerror(errno);
+        if (mem >= 0) close(mem);
+        return false;
+    }
+    void* p = mmap(nullptr, sizeof(WorkerChannel), PROT_READ | PROT_WRITE, MAP_SHARED, mem, 0);
+    int fds[2];
+    if (p == MAP_FAILED || pipe2(fds, O_CLOEXEC) < 0) {
+        error = std::string("cannot create worker channel: ") + strerror(errno);
+        if (p != MAP_FAILED) munmap(p, sizeof(WorkerChannel));
+        close(mem);
+        return false;
+    }
+    channel = new (p) WorkerChannel();
+    mem = raiseFd(mem);
+    resultFd = raiseFd(fds[0]);
+    int resultWrite = raiseFd(fds[1]);
+    fcntl(resultFd, F_SETFL, O_NONBLOCK);
+
+    nlohmann::json config = {
+        {"device", devicePath},
+        {"method", wipeMethodName(method)},
+        {"parent", getpid()},
+        {"throttled", qos != nullptr},
+        {"options", optionsToJson(opts)}
+    };
+    std::string arg = config.dump();
+
+    // The worker logs to stderr: stdout may be a --json event stream.
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, mem, CHANNEL_FD);
+    posix_spawn_file_actions_adddup2(&actions, resultWrite, RESULT_FD);
+    posix_spawn_file_actions_adddup2(&actions, STDERR_FILENO, STDOUT_FILENO);
+    posix_spawn_file_actions_addclosefrom_np(&actions, RESULT_FD + 1);
+
+    // Its own process group, so a terminal's Ctrl-C reaches only the
+    // parent, which decides what happens to running wipes.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t none, defaults;
+    sigemptyset(&none);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGTERM);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF |
+                                    POSIX_SPAWN_SETPGROUP);
+
+    char* argv[] = { (char*)"zt-client", (char*)WORKER_COMMAND, arg.data(), nullptr };
+    int rc = posix_spawn(&pid, "/proc/self/exe", &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(mem);
+    close(resultWrite);
+    if (rc != 0) {
+        pid = -1;
+        error = std::string("cannot start wipe worker: ") + strerror(rc);
+        return false;
+    }
+    return true;
+}
+
+void WipeWorker::drain(const std::function<void(WipePhase)>& onPhase) {
+    uint64_t head = channel->head.load(std::memory_order_acquire);
+    if (head - tail > RING_SIZE) tail = head - RING_SIZE;  // the oldest are gone
+    for (; tail < head; tail++) {
+        ProgressSnapshot snap;
+        if (!readSample(*channel, tail, snap)) continue;  // overwritten meanwhile
+        bool changed;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            changed = !haveLatest || latest.phase != snap.phase;
+            latest = snap;
+            haveLatest = true;
+        }
+        if (changed && onPhase) onPhase(snap.phase);
+    }
+}
+
+bool WipeWorker::progress(ProgressSnapshot& out) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    out = latest;
+    return haveLatest;
+}
+
+WipeResult WipeWorker::wait(const WorkerLimits& limits, const std::atomic<bool>* cancel,
+                            const std::function<void(WipePhase)>& onPhase, std::string& error) {
+    using Clock = std::chrono::steady_clock;
+    auto started = Clock::now();
+    auto lastMove = started;
+    auto lastTick = started;
+    Clock::time_point cancelled;
+    bool cancelSent = false;
+    bool cancelDeferred = false;
+    WipePhase lastPhase = WipePhase::IDLE;
+    uint64_t lastBytes = 0;
+
+    std::unique_ptr<DeviceThrottle> share;
+    uint64_t charged = 0;
+
+    std::string output;
+    auto readOutput = [&] {
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(resultFd, buf, sizeof(buf))) > 0) output.append(buf, n);
+    };
+
+    int status = 0;
+    bool exited = false;
+    std::string why;
+    while (!exited) {
+        readOutput();
+        pid_t r = waitpid(pid, &status, WNOHANG);
+        if (r == pid || (r < 0 && errno != EINTR)) {
+            exited = true;
+            break;
+        }
+
+        drain(onPhase);
+        ProgressSnapshot snap;
+        auto now = Clock::now();
+        if (progress(snap) && (snap.bytesDone != lastBytes || snap.phase != lastPhase)) {
+            lastBytes = snap.bytesDone;
+            lastPhase = snap.phase;
+            lastMove = now;
+        }
+
+        // The controller sees this wipe like one in-process: attached for
+        // the writing phase, charged what the worker wrote.
+        if (qos && !share && lastPhase == WipePhase::WRITING && snap.bytesTotal) {
+            share = qos->attach(devicePath, snap.bytesTotal - snap.bytesDone, qosWeight);
+        }
+        if (share) {
+            uint64_t c = channel->consumed.load(std::memory_order_relaxed);
+            channel->rate.store(share->account(c - charged, channel->waited.exchange(false)),
+                                std::memory_order_relaxed);
+            charged = c;
+        }
+
+        // A firmware erase keeps running on the drive whatever happens to
+        // the worker, so killing it mid-erase would only lose the result
+        // and leave the device busy. Cancel waits until the erase is over.
+        bool erasing = lastPhase == WipePhase::ERASING;
+        if (erasing) {
+            // Erase time counts toward none of the limits below; the erase
+            // commands' own timeouts bound it instead.
+            started += now - lastTick;
+            cancelled += now - lastTick;
+            lastMove = now;
+        }
+        lastTick = now;
+        if (cancel && cancel->load() && !cancelSent) {
+            if (!erasing) {
+                channel->cancel.store(true);
+                cancelSent = true;
+                cancelled = now;
+            } else if (!cancelDeferred) {
+                std::cerr << "Wipe worker " << pid << " for " << devicePath
+                          << ": cancel requested, but the erase continues on the device\n";
+                cancelDeferred = true;
+            }
+        }
+
+        auto secs = [](unsigned s) { return std::chrono::seconds(s); };
+        if (cancelSent && now - cancelled > secs(limits.cancelGraceSeconds)) {
+            why = "cancelled; worker killed after not stopping";
+        } else if (limits.timeoutSeconds && now - started > secs(limits.timeoutSeconds)) {
+            why = "timed out after " + std::to_string(limits.timeoutSeconds) + "s; worker killed";
+        } else if (limits.stallSeconds && now - lastMove > secs(limits.stallSeconds)) {
+            why = "no progress for " + std::to_string(limits.stallSeconds) + "s; worker killed";
+        }
+        if (!why.empty()) break;
+        std::this_thread::sleep_for(TICK);
+    }
+
+    if (!why.empty()) {
+        std::cerr << "Wipe worker " << pid << " for " << devicePath << ": " << why << "\n";
+        if (!killWorker(pid, devicePath, status)) {
+            why += ", but it is stuck in the kernel; the device stays busy until it exits";
+        }
+    }
+    pid = -1;
+    drain(onPhase);
+    readOutput();
+    close(resultFd);
+    resultFd = -1;
+
+    WipeResult result{};
+    result.device_path = devicePath;
+    result.method = method;
+    result.status = WipeStatus::FAILURE;
+    error = why;
+    if (!why.empty()) return result;
+
+    nlohmann::json j = nlohmann::json::parse(output, nullptr, false);
+    if (exited && !j.is_discarded()) {
+        try {
+            return resultFromJson(j);
+        } catch (const std::exception& e) {
+            std::cerr << "Malformed result from wipe worker: " << e.what() << "\n";
+        }
+    }
+    if (WIFSIGNALED(status)) error = "worker died from signal " + std::to_string(WTERMSIG(status));
+    else error = "worker exited without a result";
+    return result;
+}
+
+bool isWorkerCommand(const char* arg) {
+    return !strcmp(arg, WORKER_COMMAND);
+}
+
+int runWipeWorker(int argc, char* argv[]) {
+    if (argc < 3) return 2;
+    nlohmann::json config = nlohmann::json::parse(argv[2], nullptr, false);
+    if (config.is_discarded()) return 2;
+
+    // Nobody is left to report to once the parent is gone; the checkpoint
+    // lets a later run resume.
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    prctl(PR_SET_NAME, "zt-wipe-worker");
+    if (getppid() != config.value("parent", (pid_t)0)) return 2;
+
+    void* p = mmap(nullptr, sizeof(WorkerChannel), PROT_READ | PROT_WRITE, MAP_SHARED, CHANNEL_FD, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap worker channel");
+        return 2;
+    }
+    close(CHANNEL_FD);
+    WorkerChannel& ch = *static_cast<WorkerChannel*>(p);
+
+    WipeOptions opts;
+    std::string device;
+    WipeMethod method;
+    try {
+        opts = optionsFromJson(config.at("options"));
+        device = config.at("device");
+        if (!parseWipeMethod(config.at("method"), method)) return 2;
+    } catch (const std::exception& e) {
+        std::cerr << "Bad wipe worker configuration: " << e.what() << "\n";
+        return 2;
+    }
+
+    WipeProgress progress;
+    std::mutex publishMtx;
+    auto publishNow = [&] {
+        std::lock_guard<std::mutex> lock(publishMtx);
+        publish(ch, progress.snapshot());
+    };
+    // Phase changes go out at once so the parent never misses one.
+    progress.onPhaseChange([&](WipePhase) { publishNow(); });
+
+    SharedThrottle throttle(ch);
+    opts.progress = &progress;
+    opts.cancel = &ch.cancel;
+    opts.qos = nullptr;
+    if (config.value("throttled", false)) opts.throttle = &throttle;
+
+    std::mutex stopMtx;
+    std::condition_variable stopCv;
+    bool finished = false;
+    std::thread publisher([&] {
+        std::unique_lock<std::mutex> lock(stopMtx);
+        while (!stopCv.wait_for(lock, TICK, [&] { return finished; })) {
+            lock.unlock();
+            publishNow();
+            lock.lock();
+        }
+    });
+
+    WipeResult result = wipeDisk(device, method, opts);
+    {
+        std::lock_guard<std::mutex> lock(stopMtx);
+        finished = true;
+    }
+    stopCv.notify_all();
+    publisher.join();
+    publishNow();
+
+    std::string out = resultToJson(result).dump();
+    for (size_t off = 0; off < out.size(); ) {
+        ssize_t n = write(RESULT_FD, out.data() + off, out.size() - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("write wipe result");
+            return 1;
+        }
+        off += n;
+    }
+    close(RESULT_FD);
+    return result.status == WipeStatus::SUCCESS ? 0 : 1;
+}